@@ -18,37 +18,37 @@ int main(int, char **) {
       // ._address = "tcp://test.mosquitto.org:1883",
       ._clientID = "ExampleClientPub",
       ._connectLostCallback =
-          [](const std::string &msg) {
+          [](std::string_view msg) {
             DSG_LOG("connect lost, " << msg);
           },
       ._messageArrivedCallback =
-          [](const Mqtt ::Topic &topic, std::span<uint8_t> msg) {
+          [](Mqtt::TopicView topic, std::span<uint8_t> msg) {
             DSG_LOG("message arrived " << topic.to_string() << " "
                                        << std::string(msg.begin(), msg.end()));
           },
       ._deliveryCompleteCallback =
-          [](const std::string &) {
+          [](std::string_view) {
 
           },
       ._connectCallback =
-          [](bool connected, const std::string &msg) {
+          [](bool connected, std::string_view msg) {
             DSG_LOG("connect " << std::boolalpha << connected << " " << msg);
           },
       ._disconnectCallback =
-          [&disconnect](bool disconnected, const std::string &msg) {
+          [&disconnect](bool disconnected, std::string_view msg) {
             DSG_LOG("disconnect " << std::boolalpha << disconnected << " " << msg);
             disconnect.store(disconnected);
           },
       ._sendCallback =
-          [](bool success, const Mqtt::Topic &topic, const std::string &msg) {
+          [](bool success, Mqtt::TopicView topic, std::string_view msg) {
             DSG_LOG("send " << topic.to_string() << " " << std::boolalpha << success << " " << msg);
           },
       ._subscribeCallback =
-          [](bool success, const Mqtt::Topic &, const std::string &msg) {
+          [](bool success, Mqtt::TopicView, std::string_view msg) {
             DSG_LOG("subscribe " << std::boolalpha << success << " " << msg);
           },
       ._unsubscribeCallback =
-          [](bool success, const Mqtt::Topic &, const std::string &msg) {
+          [](bool success, Mqtt::TopicView, std::string_view msg) {
             DSG_LOG("unsubscribe " << std::boolalpha << success << " " << msg);
           }});
   DSG_LOG("Usage:\n"
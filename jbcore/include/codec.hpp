@@ -0,0 +1,340 @@
+/**
+ * @file codec.hpp
+ * @brief 按 schema 描述的紧凑二进制编码，用于 mqtt 负载
+ *
+ * 特化 codec::schema<T> 在编译期列出字段，按列出的顺序编码，不带字段名和标签：
+ * - 无符号整数、bool、枚举：varint（LEB128），小于 128 只占 1 字节
+ * - 有符号整数：zigzag 后 varint
+ * - 浮点数和 fixed() 声明的整数：定长小端
+ * - std::string_view、std::string、std::span<const uint8_t>、std::vector<uint8_t>：
+ *   varint 长度 + 字节
+ * - 带 schema 的结构体：依次内嵌其字段
+ * 解码要求字段齐全，允许末尾有多余字节，新版本只在末尾追加字段即可被旧版本读取。
+ * string_view 和 span 字段解码后指向输入缓冲区，整个过程不分配内存。
+ *
+ * @code
+ * struct Sample {
+ *   uint32_t _id;
+ *   int64_t _ts;
+ *   double _value;
+ *   std::string_view _unit;
+ * };
+ * template <> struct dsg::codec::schema<Sample> {
+ *   static constexpr auto fields = std::tuple{field(&Sample::_id), field(&Sample::_ts),
+ *                                             field(&Sample::_value), field(&Sample::_unit)};
+ * };
+ *
+ * codec::Encode(sample, buf); // buf 为复用的 std::vector<uint8_t>
+ * mqtt->Send(topic, buf, {});
+ * ...
+ * Sample s;
+ * if (codec::Decode(payload, s)) { ... }
+ * @endcode
+ */
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+namespace dsg::codec {
+/// @brief 由使用方特化，提供 static constexpr 的字段元组 fields
+template <typename T> struct schema;
+
+template <typename T>
+concept Described =
+    requires { std::tuple_size<std::remove_cv_t<decltype(schema<T>::fields)>>::value; };
+
+enum class Kind : uint8_t { eVarint, eZigzag, eFixed, eBytes, eNested };
+
+template <typename C, typename M, Kind K> struct Field {
+  using member_type = M;
+  static constexpr Kind kind = K;
+  M C::*_member;
+};
+
+namespace detail {
+template <typename M> inline constexpr bool is_bytes_v =
+    std::is_same_v<M, std::string_view> || std::is_same_v<M, std::string> ||
+    std::is_same_v<M, std::span<const uint8_t>> || std::is_same_v<M, std::vector<uint8_t>>;
+
+template <typename M> constexpr auto DefaultKind() -> Kind {
+  if constexpr (std::is_same_v<M, bool> || std::is_enum_v<M> ||
+                (std::is_integral_v<M> && std::is_unsigned_v<M>)) {
+    return Kind::eVarint;
+  } else if constexpr (std::is_integral_v<M>) {
+    return Kind::eZigzag;
+  } else if constexpr (std::is_floating_point_v<M>) {
+    return Kind::eFixed;
+  } else if constexpr (is_bytes_v<M>) {
+    return Kind::eBytes;
+  } else {
+    static_assert(Described<M>, "field type is not supported, add a codec::schema for it");
+    return Kind::eNested;
+  }
+}
+
+template <typename M> auto ToUnsigned(M v) -> uint64_t {
+  if constexpr (std::is_enum_v<M>) {
+    return static_cast<uint64_t>(static_cast<std::underlying_type_t<M>>(v));
+  } else {
+    return static_cast<uint64_t>(v);
+  }
+}
+
+constexpr auto VarintSize(uint64_t v) -> std::size_t {
+  std::size_t n = 1;
+  while (v >= 0x80) {
+    v >>= 7;
+    ++n;
+  }
+  return n;
+}
+
+inline auto ZigZag(int64_t v) -> uint64_t {
+  return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+}
+
+inline auto UnZigZag(uint64_t v) -> int64_t {
+  return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+}
+
+template <typename M> inline auto BytesOf(const M &v) -> std::span<const uint8_t> {
+  return {reinterpret_cast<const uint8_t *>(v.data()), v.size()};
+}
+
+/// @brief 写入预先按 Size 分配好的缓冲区，不做边界检查
+struct Writer {
+  uint8_t *_p;
+
+  auto Varint(uint64_t v) -> void {
+    while (v >= 0x80) {
+      *_p++ = static_cast<uint8_t>(v | 0x80);
+      v >>= 7;
+    }
+    *_p++ = static_cast<uint8_t>(v);
+  }
+
+  template <typename M> auto Fixed(M v) -> void {
+    std::memcpy(_p, &v, sizeof(M));
+    if constexpr (std::endian::native == std::endian::big) {
+      std::reverse(_p, _p + sizeof(M));
+    }
+    _p += sizeof(M);
+  }
+
+  auto Bytes(std::span<const uint8_t> v) -> void {
+    Varint(v.size());
+    if (!v.empty()) {
+      std::memcpy(_p, v.data(), v.size());
+    }
+    _p += v.size();
+  }
+};
+
+struct Reader {
+  const uint8_t *_p;
+  const uint8_t *_end;
+
+  auto Varint(uint64_t &v) -> bool {
+    v = 0;
+    for (int shift = 0; shift < 64 && _p < _end; shift += 7) {
+      auto b = *_p++;
+      v |= static_cast<uint64_t>(b & 0x7f) << shift;
+      if (!(b & 0x80)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  template <typename M> auto Fixed(M &v) -> bool {
+    if (static_cast<std::size_t>(_end - _p) < sizeof(M)) {
+      return false;
+    }
+    uint8_t buf[sizeof(M)];
+    std::memcpy(buf, _p, sizeof(M));
+    if constexpr (std::endian::native == std::endian::big) {
+      std::reverse(buf, buf + sizeof(M));
+    }
+    std::memcpy(&v, buf, sizeof(M));
+    _p += sizeof(M);
+    return true;
+  }
+
+  auto Bytes(std::span<const uint8_t> &v) -> bool {
+    uint64_t size = 0;
+    if (!Varint(size) || size > static_cast<uint64_t>(_end - _p)) {
+      return false;
+    }
+    v = {_p, static_cast<std::size_t>(size)};
+    _p += size;
+    return true;
+  }
+};
+
+template <typename T> auto Size(const T &v) -> std::size_t;
+template <typename T> auto Write(Writer &w, const T &v) -> void;
+template <typename T> auto Read(Reader &r, T &v) -> bool;
+
+template <typename F, typename M> auto FieldSize(const M &v) -> std::size_t {
+  if constexpr (F::kind == Kind::eVarint) {
+    return VarintSize(ToUnsigned(v));
+  } else if constexpr (F::kind == Kind::eZigzag) {
+    return VarintSize(ZigZag(static_cast<int64_t>(v)));
+  } else if constexpr (F::kind == Kind::eFixed) {
+    return sizeof(M);
+  } else if constexpr (F::kind == Kind::eBytes) {
+    return VarintSize(v.size()) + v.size();
+  } else {
+    return Size(v);
+  }
+}
+
+template <typename F, typename M> auto FieldWrite(Writer &w, const M &v) -> void {
+  if constexpr (F::kind == Kind::eVarint) {
+    w.Varint(ToUnsigned(v));
+  } else if constexpr (F::kind == Kind::eZigzag) {
+    w.Varint(ZigZag(static_cast<int64_t>(v)));
+  } else if constexpr (F::kind == Kind::eFixed) {
+    w.Fixed(v);
+  } else if constexpr (F::kind == Kind::eBytes) {
+    w.Bytes(BytesOf(v));
+  } else {
+    Write(w, v);
+  }
+}
+
+template <typename F, typename M> auto FieldRead(Reader &r, M &v) -> bool {
+  if constexpr (F::kind == Kind::eVarint || F::kind == Kind::eZigzag) {
+    uint64_t u = 0;
+    if (!r.Varint(u)) {
+      return false;
+    }
+    if constexpr (std::is_same_v<M, bool>) {
+      v = u != 0;
+    } else if constexpr (std::is_enum_v<M>) {
+      using U = std::underlying_type_t<M>;
+      if (static_cast<uint64_t>(static_cast<U>(u)) != u) {
+        return false;
+      }
+      v = static_cast<M>(static_cast<U>(u));
+    } else if constexpr (F::kind == Kind::eVarint) {
+      if (u > static_cast<uint64_t>(std::numeric_limits<M>::max())) {
+        return false; // 超出字段范围
+      }
+      v = static_cast<M>(u);
+    } else {
+      auto s = UnZigZag(u);
+      if (s < static_cast<int64_t>(std::numeric_limits<M>::min()) ||
+          s > static_cast<int64_t>(std::numeric_limits<M>::max())) {
+        return false;
+      }
+      v = static_cast<M>(s);
+    }
+    return true;
+  } else if constexpr (F::kind == Kind::eFixed) {
+    return r.Fixed(v);
+  } else if constexpr (F::kind == Kind::eBytes) {
+    std::span<const uint8_t> bytes;
+    if (!r.Bytes(bytes)) {
+      return false;
+    }
+    if constexpr (std::is_same_v<M, std::span<const uint8_t>>) {
+      v = bytes;
+    } else {
+      v = M(reinterpret_cast<const typename M::value_type *>(bytes.data()),
+            reinterpret_cast<const typename M::value_type *>(bytes.data()) + bytes.size());
+    }
+    return true;
+  } else {
+    return Read(r, v);
+  }
+}
+
+template <typename T> auto Size(const T &v) -> std::size_t {
+  return std::apply(
+      [&](const auto &...f) {
+        return (std::size_t{0} + ... +
+                FieldSize<std::remove_cvref_t<decltype(f)>>(v.*(f._member)));
+      },
+      schema<T>::fields);
+}
+
+template <typename T> auto Write(Writer &w, const T &v) -> void {
+  std::apply(
+      [&](const auto &...f) {
+        (FieldWrite<std::remove_cvref_t<decltype(f)>>(w, v.*(f._member)), ...);
+      },
+      schema<T>::fields);
+}
+
+template <typename T> auto Read(Reader &r, T &v) -> bool {
+  return std::apply(
+      [&](const auto &...f) {
+        return (FieldRead<std::remove_cvref_t<decltype(f)>>(r, v.*(f._member)) && ...);
+      },
+      schema<T>::fields);
+}
+} // namespace detail
+
+/// @brief 按成员类型选择编码方式
+template <typename C, typename M> constexpr auto field(M C::*member) {
+  return Field<C, M, detail::DefaultKind<M>()>{member};
+}
+
+/// @brief 定长小端编码，用于取值分布均匀的整数（哈希、随机 id 等），varint 反而更长
+template <typename C, typename M>
+requires std::is_arithmetic_v<M>
+constexpr auto fixed(M C::*member) {
+  return Field<C, M, Kind::eFixed>{member};
+}
+
+/// @brief 编码后的字节数
+template <Described T> auto Size(const T &v) -> std::size_t {
+  return detail::Size(v);
+}
+
+/// @brief 编码到调用方提供的缓冲区
+/// @param v
+/// @param out
+/// @return 写入的字节数，缓冲区不足返回 0
+template <Described T> auto Encode(const T &v, std::span<uint8_t> out) -> std::size_t {
+  auto size = detail::Size(v);
+  if (size > out.size()) {
+    return 0;
+  }
+  detail::Writer w{out.data()};
+  detail::Write(w, v);
+  return size;
+}
+
+/// @brief 编码到 out，out 的容量复用，稳态下不分配内存
+/// @param v
+/// @param out
+/// @return 编码后的字节数
+template <Described T> auto Encode(const T &v, std::vector<uint8_t> &out) -> std::size_t {
+  out.resize(detail::Size(v));
+  detail::Writer w{out.data()};
+  detail::Write(w, v);
+  return out.size();
+}
+
+/// @brief 解码，string_view 和 span 字段指向 in，使用期间 in 须保持有效
+/// @param in
+/// @param v
+/// @return 数据不完整或取值超出字段范围返回 false
+template <Described T> auto Decode(std::span<const uint8_t> in, T &v) -> bool {
+  detail::Reader r{in.data(), in.data() + in.size()};
+  return detail::Read(r, v);
+}
+} // namespace dsg::codec
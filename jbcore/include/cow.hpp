@@ -0,0 +1,196 @@
+/**
+ * @file cow.hpp
+ * @brief 基于 ptr::unique() 的写时复制容器
+ *
+ * 1. 拷贝 cow_vector / cow_map 只增加引用计数，读者持有的是一份不会再变的快照
+ * 2. 写操作前检查引用是否唯一，被共享时先复制一份再改，否则就地修改
+ * 3. 同一个实例不能被多个线程同时读写；跨线程传递时在锁内拷贝（O(1)），锁外读写各自的副本
+ *
+ * @code
+ * cow_map<std::string, std::string> config;       // 写线程持有
+ * config.set("qos", "1");
+ * {
+ *   std::lock_guard<std::mutex> lock{mutex};
+ *   published = config;                           // 只增加计数
+ * }
+ * config.set("qos", "2");                         // published 仍被共享，此时复制
+ * @endcode
+ */
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "ptr.hpp"
+
+namespace dsg::sp {
+/// @brief 写时复制的容器，C 需可拷贝
+template <typename C> class cow {
+public:
+  using container_type = C;
+
+  cow() noexcept = default;
+
+  explicit cow(C c) : _node{make_ptr<node>(std::move(c))} {
+  }
+
+  /// @brief 只读访问，不会复制
+  auto read() const noexcept -> const C & {
+    return _node ? _node->_c : empty_container();
+  }
+
+  /// @brief 可写访问，被共享时先复制；返回的引用在下一次拷贝本对象前有效
+  auto write() -> C & {
+    if (!_node) {
+      _node = make_ptr<node>();
+    } else if (!_node.unique()) {
+      _node = make_ptr<node>(std::as_const(_node->_c));
+    }
+    return _node->_c;
+  }
+
+  /// @brief 共享同一份数据的实例数，空容器未分配时为 0
+  auto use_count() const -> detail::val_t {
+    return _node.use_count();
+  }
+
+  auto unique() const -> bool {
+    return _node.unique();
+  }
+
+  /// @brief 是否与 other 共享同一份数据
+  auto shares_with(const cow &other) const noexcept -> bool {
+    return _node && _node == other._node;
+  }
+
+  auto size() const noexcept -> std::size_t {
+    return read().size();
+  }
+
+  auto empty() const noexcept -> bool {
+    return read().empty();
+  }
+
+  auto begin() const noexcept {
+    return read().begin();
+  }
+
+  auto end() const noexcept {
+    return read().end();
+  }
+
+  /// @brief 清空时不复制，直接放弃共享的数据
+  auto clear() -> void {
+    _node.reset();
+  }
+
+private:
+  struct node final : public ref_policy {
+    template <typename... Args> explicit node(Args &&...args) : _c(std::forward<Args>(args)...) {
+    }
+    C _c;
+  };
+
+  static auto empty_container() noexcept -> const C & {
+    static const C c{};
+    return c;
+  }
+
+  ptr<node> _node;
+};
+
+template <typename T> class cow_vector : public cow<std::vector<T>> {
+  using base = cow<std::vector<T>>;
+
+public:
+  using base::base;
+
+  cow_vector(std::initializer_list<T> init) : base{std::vector<T>(init)} {
+  }
+
+  auto operator[](std::size_t i) const -> const T & {
+    return this->read()[i];
+  }
+
+  auto at(std::size_t i) const -> const T & {
+    return this->read().at(i);
+  }
+
+  auto data() const noexcept -> const T * {
+    return this->read().data();
+  }
+
+  auto push_back(T v) -> void {
+    this->write().push_back(std::move(v));
+  }
+
+  template <typename... Args> auto emplace_back(Args &&...args) -> T & {
+    return this->write().emplace_back(std::forward<Args>(args)...);
+  }
+
+  auto pop_back() -> void {
+    this->write().pop_back();
+  }
+
+  /// @brief 修改第 i 个元素
+  auto set(std::size_t i, T v) -> void {
+    this->write()[i] = std::move(v);
+  }
+
+  auto erase(std::size_t i) -> void {
+    auto &v = this->write();
+    v.erase(v.begin() + static_cast<std::ptrdiff_t>(i));
+  }
+};
+
+template <typename K, typename V, typename Compare = std::less<K>>
+class cow_map : public cow<std::map<K, V, Compare>> {
+  using base = cow<std::map<K, V, Compare>>;
+
+public:
+  using base::base;
+
+  cow_map(std::initializer_list<std::pair<const K, V>> init)
+      : base{std::map<K, V, Compare>(init)} {
+  }
+
+  template <typename Key> auto find(const Key &key) const {
+    return this->read().find(key);
+  }
+
+  template <typename Key> auto contains(const Key &key) const -> bool {
+    return this->read().contains(key);
+  }
+
+  template <typename Key> auto at(const Key &key) const -> const V & {
+    return this->read().at(key);
+  }
+
+  /// @brief 不存在时返回 nullptr
+  template <typename Key> auto get(const Key &key) const -> const V * {
+    auto &m = this->read();
+    auto it = m.find(key);
+    return it == m.end() ? nullptr : &it->second;
+  }
+
+  auto set(K key, V value) -> void {
+    this->write().insert_or_assign(std::move(key), std::move(value));
+  }
+
+  template <typename... Args> auto emplace(Args &&...args) -> bool {
+    return this->write().emplace(std::forward<Args>(args)...).second;
+  }
+
+  /// @brief 键不存在时不复制
+  template <typename Key> auto erase(const Key &key) -> bool {
+    if (!contains(key)) {
+      return false;
+    }
+    return this->write().erase(key) > 0;
+  }
+};
+} // namespace dsg::sp
@@ -26,6 +26,8 @@
 #include <queue>
 #include <utility>
 #include <chrono>
+#include <memory>
+#include <mutex>
 
 namespace dsg {
 inline std::string_view ParseFileNameFromPath(std::string_view path) {
@@ -65,6 +67,14 @@ inline std::string_view trim(std::string_view str) {
   return str.substr(start);
 }
 
+/// @brief 透明哈希，unordered 容器可直接用 string_view 查找，不构造 std::string
+struct StrHash {
+  using is_transparent = void;
+  auto operator()(std::string_view s) const noexcept -> std::size_t {
+    return std::hash<std::string_view>{}(s);
+  }
+};
+
 #define DSG_STR(_in_stream) ((std::stringstream() << _in_stream).str())
 
 #define LOG_INFO                                                                                   \
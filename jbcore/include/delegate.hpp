@@ -0,0 +1,125 @@
+/**
+ * @file delegate.hpp
+ * @brief 不分配堆内存的可调用对象封装
+ *
+ * 用法与 std::function 相同，可调用对象直接存放在对象内的固定缓冲区（默认 6 个指针大小），
+ * 构造、拷贝、调用都不分配内存。可调用对象超过缓冲区时编译报错，捕获较多状态时改为捕获指针。
+ */
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace dsg {
+template <typename Signature, std::size_t Capacity = 6 * sizeof(void *)> class delegate;
+
+template <typename R, typename... Args, std::size_t Capacity>
+class delegate<R(Args...), Capacity> final {
+public:
+  delegate() noexcept = default;
+  delegate(std::nullptr_t) noexcept {
+  }
+
+  template <typename F>
+  requires(!std::is_same_v<std::decay_t<F>, delegate> &&
+           std::is_invocable_r_v<R, std::decay_t<F> &, Args...>)
+  delegate(F &&f) {
+    using T = std::decay_t<F>;
+    static_assert(sizeof(T) <= Capacity, "callable too large for delegate, capture a pointer");
+    static_assert(alignof(T) <= alignof(std::max_align_t), "over-aligned callable");
+    static_assert(std::is_copy_constructible_v<T>, "callable must be copyable");
+    if constexpr (std::is_pointer_v<T> || std::is_member_pointer_v<T>) {
+      if (f == nullptr) {
+        return;
+      }
+    }
+    ::new (static_cast<void *>(_storage)) T(std::forward<F>(f));
+    _ops = &ops_for<T>;
+  }
+
+  delegate(const delegate &r) : _ops{r._ops} {
+    if (_ops) {
+      _ops->_copy(_storage, r._storage);
+    }
+  }
+
+  delegate(delegate &&r) noexcept : _ops{r._ops} {
+    if (_ops) {
+      _ops->_move(_storage, r._storage);
+      r.reset();
+    }
+  }
+
+  delegate &operator=(const delegate &r) {
+    if (this != &r) {
+      reset();
+      if (r._ops) {
+        r._ops->_copy(_storage, r._storage);
+        _ops = r._ops;
+      }
+    }
+    return *this;
+  }
+
+  delegate &operator=(delegate &&r) noexcept {
+    if (this != &r) {
+      reset();
+      if (r._ops) {
+        r._ops->_move(_storage, r._storage);
+        _ops = r._ops;
+        r.reset();
+      }
+    }
+    return *this;
+  }
+
+  delegate &operator=(std::nullptr_t) noexcept {
+    reset();
+    return *this;
+  }
+
+  ~delegate() {
+    reset();
+  }
+
+  /// @brief 与 std::function 一致，const 对象也可调用非 const 的 operator()
+  auto operator()(Args... args) const -> R {
+    return _ops->_invoke(const_cast<unsigned char *>(_storage), std::forward<Args>(args)...);
+  }
+
+  explicit operator bool() const noexcept {
+    return _ops != nullptr;
+  }
+
+  auto reset() noexcept -> void {
+    if (_ops) {
+      _ops->_destroy(_storage);
+      _ops = nullptr;
+    }
+  }
+
+private:
+  struct ops {
+    R (*_invoke)(void *, Args &&...);
+    void (*_copy)(void *, const void *);
+    void (*_move)(void *, void *);
+    void (*_destroy)(void *);
+  };
+
+  template <typename T>
+  static constexpr ops ops_for{
+      [](void *p, Args &&...args) -> R {
+        return std::invoke(*static_cast<T *>(p), std::forward<Args>(args)...);
+      },
+      [](void *dst, const void *src) { ::new (dst) T(*static_cast<const T *>(src)); },
+      [](void *dst, void *src) { ::new (dst) T(std::move(*static_cast<T *>(src))); },
+      [](void *p) { static_cast<T *>(p)->~T(); },
+  };
+
+  alignas(std::max_align_t) unsigned char _storage[Capacity];
+  const ops *_ops{nullptr};
+};
+} // namespace dsg
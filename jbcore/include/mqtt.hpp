@@ -1,8 +1,13 @@
 #pragma once
 
+#include <array>
 #include <functional>
 #include <string>
+#include <string_view>
 #include <span>
+#include <utility>
+#include <vector>
+#include "delegate.hpp"
 #include "ptr.hpp"
 #include "result.hpp"
 
@@ -10,6 +15,10 @@ namespace dsg {
 struct Mqtt {
   enum class Qos : int { e0 = 0, e1 = 1, e2 = 2 };
 
+  /// @brief 发送优先级，启用发送调度时高优先级消息先于低优先级发出
+  enum class Priority : uint8_t { eHigh = 0, eNormal = 1, eLow = 2 };
+  static constexpr std::size_t kPriorityCount = 3;
+
   struct Topic {
     std::string _name{};
     Qos _qos{Qos::e0};
@@ -17,8 +26,55 @@ struct Mqtt {
     auto to_string() const -> std::string;
   };
 
+  /// @brief 回调中使用的 topic，不持有名字，只在回调内有效，需要保留时转为 Topic
+  struct TopicView {
+    std::string_view _name{};
+    Qos _qos{Qos::e0};
+
+    TopicView() = default;
+    TopicView(std::string_view name, Qos qos) : _name{name}, _qos{qos} {
+    }
+    TopicView(const Topic &topic) : _name{topic._name}, _qos{topic._qos} {
+    }
+    explicit operator Topic() const {
+      return {std::string(_name), _qos};
+    }
+
+    auto to_string() const -> std::string;
+  };
+
+  /// @brief 接收到的消息，引用计数持有 paho 分配的消息体和 topic，
+  /// 最后一个引用释放时归还给 paho，可跨线程传递，无需拷贝负载
+  struct Message {
+    virtual ~Message() = default;
+    virtual auto topic() const -> std::string_view = 0;
+    virtual auto qos() const -> Qos = 0;
+    virtual auto retained() const -> bool = 0;
+    virtual auto payload() const -> std::span<uint8_t> = 0;
+    /// @brief mqtt 5 用户属性，不存在返回空
+    virtual auto userProperty(std::string_view name) const -> std::string_view = 0;
+  };
+
+  /// @brief 发送选项，除 _retained 外仅 mqtt 5 有效
+  struct SendOptions {
+    bool _retained{false};
+    uint32_t _messageExpiry{0}; // seconds，0 不过期
+    std::vector<std::pair<std::string, std::string>> _userProperties{};
+    Priority _priority{Priority::eNormal}; // 仅启用发送调度时有效
+  };
+
+  /// @brief 令牌桶限速
+  struct RateLimit {
+    double _rate{0};  // 每秒消息数，0 不限速
+    double _burst{0}; // 桶容量即允许的突发消息数，0 时取 max(1, _rate)
+  };
+
+  using MessagePtr = interface_ptr<Message>;
+  // 回调使用 delegate，注册和调用都不分配内存，捕获超过 6 个指针大小时编译报错
+  using MessageHandler = delegate<void(TopicView, std::span<uint8_t>)>;
+
   static auto ToQos(int v) -> Mqtt::Qos {
-    assert(v == 0 || v == 1 || v == 3);
+    assert(v == 0 || v == 1 || v == 2);
     return v == 0 ? Mqtt::Qos::e0 : (v == 1 ? Mqtt::Qos::e1 : Mqtt::Qos::e2);
   }
 
@@ -29,6 +85,7 @@ struct Mqtt {
   struct Config {
     std::string _address;
     std::string _clientID;
+    int _mqttVersion{4}; // 4: 3.1.1, 5: 5.0
 
     // connect
     std::string _username{};
@@ -41,17 +98,121 @@ struct Mqtt {
     int _minRetryInterval{1};  // seconds
     int _maxRetryInterval{60}; // seconds
 
-    std::function<void(const std::string &)> _connectLostCallback{};
-    std::function<void(const Topic &, std::span<uint8_t>)> _messageArrivedCallback{};
-    std::function<void(const std::string &)> _deliveryCompleteCallback{};
+    // callback dispatch
+    // 0: 回调直接在 paho 网络线程执行；多线程时同一 topic 的消息按序回调，不同 topic 之间不保证，
+    // 连接、发送等其余事件在同一线程按序回调
+    int _dispatchThreads{0};
+    std::size_t _dispatchQueueSize{4096}; // 每个分发线程的队列容量，向上取整到 2 的幂
+
+    // subscribe
+    int _maxTopicsPerSubscribe{100}; // 批量订阅时单个 SUBSCRIBE 报文的 topic 上限，按 broker 限制设置
+    bool _restoreSubscriptions{true}; // 重连且 broker 无会话时自动恢复已订阅的 topic
+
+    // last value cache
+    // 按 topic 缓存收到的最近一条消息，LastValue 直接读本地缓存，不经过 broker
+    std::size_t _lastValueTopics{0};      // 缓存的 topic 数上限，0 关闭
+    std::size_t _lastValueBytes{1 << 20}; // topic 名和负载占用的内存上限，启用时一次分配
+
+    // publish
+    // mqtt 5 下 qos0 topic 发送次数达到阈值后自动分配 topic alias，之后只发 alias 不发 topic 名
+    // 0 关闭，可用 alias 数量由 broker 的 Topic Alias Maximum 决定
+    int _topicAliasThreshold{2};
+
+    // compression，收发两端配置需一致
+    bool _compress{false};                     // 发送时压缩，接收时自动识别解压
+    std::size_t _compressThreshold{1024};      // 负载不小于该长度才压缩
+    std::vector<std::string> _compressDicts{}; // 预置字典，编号为下标 + 1，可用典型消息作为字典
+    int _compressDict{0};                      // 发送使用的字典编号，0 不使用字典
+    std::size_t _compressMaxSize{16 << 20};    // 解压后长度上限，超过时不解压，按原负载交付
+
+    // send schedule
+    // 发送先按优先级入队，由调度线程按优先级和限速交给 paho，同一优先级内保持顺序
+    bool _schedule{false};
+    std::size_t _scheduleQueueSize{4096}; // 每个优先级的队列容量，满时 Send 失败
+    // 已交给 paho 尚未应答的消息数上限，窗口满时消息留在优先级队列中，
+    // 新到的高优先级消息不必排在 paho 队列里的大量低优先级消息之后
+    std::size_t _scheduleInflight{32};
+    std::array<RateLimit, kPriorityCount> _priorityRateLimits{}; // 按优先级限速
+    // 按 topic 过滤器限速（支持 + #），匹配同一过滤器的 topic 共享令牌桶，取第一个匹配项
+    std::vector<std::pair<std::string, RateLimit>> _topicRateLimits{};
+
+    // 回调参数中的 topic 和 msg 只在回调内有效
+    delegate<void(std::string_view)> _connectLostCallback{};
+    // 未被订阅处理函数（Subscribe(topic, handler)）接收的消息
+    delegate<void(TopicView, std::span<uint8_t>)> _messageArrivedCallback{};
+    delegate<void(const MessagePtr &)> _messageCallback{}; // 持有消息，可异步处理
+    delegate<void(std::string_view)> _deliveryCompleteCallback{};
+
+    delegate<void(bool, std::string_view)> _connectCallback{};
+    delegate<void(bool, std::string_view)> _disconnectCallback{};
+
+    delegate<void(bool, TopicView, std::string_view)> _sendCallback{};
+    delegate<void(bool, TopicView, std::string_view)> _subscribeCallback{};
+    delegate<void(bool, TopicView, std::string_view)> _unsubscribeCallback{};
+    // 批量订阅结果，成功时 Topic::_qos 为 broker 授予的 qos，被拒绝的 topic 以 false 单独回调
+    delegate<void(bool, std::span<const Topic>, std::string_view)> _subscribeManyCallback{};
+    delegate<void(bool, std::span<const Topic>, std::string_view)> _unsubscribeManyCallback{};
+
+    auto to_string() const -> std::string;
+  };
+
+  /// @brief 回调分发统计
+  struct DispatchStats {
+    std::size_t _depth{0};    // 当前排队事件数
+    std::size_t _capacity{0}; // 队列容量
+    uint64_t _posted{0};      // 入队事件数
+    uint64_t _dispatched{0};  // 已执行回调数
+    uint64_t _rejected{0};    // 队列满被拒绝次数
+    uint64_t _overflowed{0};  // 队列满转入溢出列表的事件数
+    int64_t _avgLatencyUs{0}; // 入队到执行的平均延迟
+    int64_t _maxLatencyUs{0}; // 入队到执行的最大延迟
+
+    auto to_string() const -> std::string;
+  };
+
+  /// @brief 发送调度统计，按优先级
+  struct ScheduleStats {
+    struct Lane {
+      std::size_t _depth{0};    // 当前排队消息数
+      std::size_t _capacity{0}; // 队列容量
+      uint64_t _queued{0};      // 入队消息数
+      uint64_t _sent{0};        // 已交给 paho 的消息数
+      uint64_t _failed{0};      // 交给 paho 失败的消息数
+      uint64_t _retried{0};     // 断线等暂时失败后重试的次数
+      uint64_t _rejected{0};    // 队列满被拒绝次数
+      int64_t _avgDelayUs{0};   // 入队到发出的平均延迟
+      int64_t _maxDelayUs{0};   // 入队到发出的最大延迟
+    };
+    std::array<Lane, kPriorityCount> _lanes{};
+    std::size_t _inflight{0}; // 已交给 paho 尚未应答的消息数
+    std::size_t _window{0};   // _inflight 上限
+
+    auto to_string() const -> std::string;
+  };
 
-    std::function<void(bool, const std::string &)> _connectCallback{};
-    std::function<void(bool, const std::string &)> _disconnectCallback{};
+  /// @brief 连接和收发指标，计数为创建以来的累计值
+  struct Metrics {
+    static constexpr std::size_t kRttBuckets = 24;
 
-    std::function<void(bool, const Topic &, const std::string &)> _sendCallback{};
-    std::function<void(bool, const Topic &, const std::string &)> _subscribeCallback{};
-    std::function<void(bool, const Topic &, const std::string &)> _unsubscribeCallback{};
+    bool _connected{false};
+    uint64_t _sent{0};             // 交给 paho 的发布数
+    uint64_t _acked{0};            // 发送完成数，qos0 为已写出，qos1/2 为收到 broker 应答
+    uint64_t _failed{0};           // 发送失败数，含交给 paho 失败和异步失败
+    int64_t _inflight{0};          // 已交给 paho 尚未完成的发布数
+    uint64_t _received{0};         // 收到的消息数
+    uint64_t _bytesOut{0};         // 发出的负载字节数，压缩后
+    uint64_t _bytesIn{0};          // 收到的负载字节数，解压前
+    uint64_t _reconnects{0};       // 首次连接之后再次建立连接的次数
+    uint64_t _connectionLost{0};   // 连接断开次数
+    int64_t _connectLatencyUs{-1}; // 最近一次建立连接的耗时，自动重连从断线开始计，-1 未连接过
+    int64_t _sinceLastInboundMs{-1}; // 距最近一条收到的消息，-1 未收到过
+    // 发送应答往返时间直方图，_ackRtt[i] 为 [2^(i-1), 2^i) us 内的次数，最后一档含更长的
+    std::array<uint64_t, kRttBuckets> _ackRtt{};
 
+    /// @brief 由直方图估算往返时间分位数
+    /// @param p 0 ~ 100
+    /// @return 所在档位的上界 us，没有样本返回 0
+    auto AckRttPercentile(double p) const -> int64_t;
     auto to_string() const -> std::string;
   };
 
@@ -62,10 +223,30 @@ struct Mqtt {
   virtual auto IsConnected() -> bool = 0;
   virtual auto Send(const Topic &topic, const std::string &textMsg) -> Result = 0;
   virtual auto Send(const Topic &topic, const std::vector<uint8_t> &payload) -> Result = 0;
+  virtual auto Send(const Topic &topic, std::span<const uint8_t> payload,
+                    const SendOptions &options) -> Result = 0;
   virtual auto Subscribe(const Topic &topic) -> Result = 0;
+  /// @brief 订阅并注册该订阅的处理函数，topic 支持 + # 通配符
+  virtual auto Subscribe(const Topic &topic, MessageHandler handler) -> Result = 0;
   virtual auto Unsubscribe(const Topic &topic) -> Result = 0;
+  /// @brief 批量订阅，按 _maxTopicsPerSubscribe 分包后流水线发送
+  virtual auto Subscribe(std::span<const Topic> topics) -> Result = 0;
+  virtual auto Unsubscribe(std::span<const Topic> topics) -> Result = 0;
+  /// @brief 读取 topic 最近收到的一条消息，需设置 _lastValueTopics
+  /// 无锁读取本地缓存，不阻塞网络线程；取消订阅后不再匹配任何订阅的 topic 从缓存移除
+  /// @param topic 具体的 topic 名，不支持通配符
+  /// @param payload 输出，复用调用方缓冲区
+  /// @return 未启用或没有缓存时返回 false
+  virtual auto LastValue(std::string_view topic, std::vector<uint8_t> &payload) -> bool = 0;
+  virtual auto GetDispatchStats() -> DispatchStats = 0;
+  virtual auto GetScheduleStats() -> ScheduleStats = 0;
+  /// @brief 读取运行指标，计数使用 relaxed 原子操作，可周期性采集
+  virtual auto GetMetrics() -> Metrics = 0;
 
   static auto Request(const Config &) -> interface_ptr<Mqtt>;
+  /// @brief 建立 clients 个连接，clientID 依次加后缀 -0、-1 ...
+  /// 发送按 topic 哈希分到固定连接，同一 topic 保持顺序；订阅只使用第一个连接
+  static auto RequestPool(const Config &, int clients) -> interface_ptr<Mqtt>;
   static auto DumpVersion() -> void;
 };
 
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include "ptr.hpp"
+#include "result.hpp"
+
+namespace dsg {
+/// @brief 进程内 mqtt 3.1.1 broker，用于没有外部 broker 时的测试和压测
+///
+/// 单线程 epoll 事件循环，监听 tcp 或 unix socket。
+/// 支持 qos 0/1/2、保留消息、+ # 通配符、持久会话（cleansession = false）和遗嘱；
+/// 不支持 mqtt 5、TLS 和认证（用户名密码忽略）。
+struct MqttBroker {
+  struct Config {
+    // tcp://<ip>:<port>（端口 0 由系统分配）或 unix://<path>
+    std::string _address{"tcp://127.0.0.1:0"};
+    std::size_t _maxQueuedMessages{10000}; // 离线持久会话缓存的 qos1/2 消息上限，超出丢弃最旧的
+    std::size_t _maxOutputBytes{64 << 20}; // 单个连接待写出数据上限，超出后丢弃 qos0 消息
+
+    auto to_string() const -> std::string;
+  };
+
+  struct Stats {
+    std::size_t _clients{0}; // 当前连接数
+    uint64_t _received{0};   // 收到的 PUBLISH 数
+    uint64_t _sent{0};       // 发出的 PUBLISH 数
+    uint64_t _dropped{0};    // 丢弃的消息数
+
+    auto to_string() const -> std::string;
+  };
+
+  virtual ~MqttBroker() = default;
+  /// @brief 开始监听并启动事件线程
+  virtual auto Start() -> Result = 0;
+  /// @brief 关闭所有连接并停止，会话和保留消息保留到下次 Start
+  virtual auto Stop() -> void = 0;
+  /// @brief 客户端连接用的地址，tcp 端口为 0 时返回系统分配的端口
+  virtual auto Address() const -> std::string = 0;
+  virtual auto GetStats() -> Stats = 0;
+
+  static auto Request(const Config &) -> interface_ptr<MqttBroker>;
+};
+
+} // namespace dsg
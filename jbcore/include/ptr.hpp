@@ -11,6 +11,20 @@
  * 1. 继承 ref_policy ，然后使用 ptr 引用对象
  * 2. 继承 interface_wrapper<Interface> 封装接口，使用 ptr 和 interface_ptr<I>
  * 3. 非线程安全版本 unsafe_ref_policy、unsafe_interface_wrapper, unsafe_interface_ptr
+ * 4. 弱引用 weak_ptr、weak_interface_ptr，计数同样嵌在对象内，不额外分配控制块
+ * 5. atomic_ptr 供多个线程同时 load/store 同一个 ptr，无锁
+ * 6. 线程设置了 detail::tls_reclaimer 时（见 ptr_reclaim.hpp），最后一个引用释放不就地析构，
+ *    交给回收器批量处理
+ * 7. 偏置计数 biased_ref_policy，见 ref_counter_biased
+ * 8. ptr_policy<Counter, Layout> 可选计数宽度（basic_ref_counter_safe<uint32_t> 等）和布局，
+ *    常用组合见 compact_ref_policy、isolated_ref_policy
+ * 9. 定义 DSG_SP_TRACK_OBJECTS 时按类型统计存活对象，见 ptr_track.hpp
+ *
+ * 弱引用：强引用共同持有 1 个弱计数。最后一个强引用释放时，没有弱引用则直接 delete；
+ * 否则只析构对象，内存留到弱计数归零时回收，lock() 对强计数做 CAS，为 0 时失败。
+ * 回收内存按 ptr 接管对象时（make_ptr<T> 即 T）的类型选择 operator delete：
+ * 类自定义 operator delete 或超对齐的类型在首次创建时登记回收函数，对象记录其编号，
+ * 经基类的 weak_ptr 回收时同样按实际类型和大小释放。
  */
 #pragma once
 
@@ -18,12 +32,20 @@
 #include <atomic>
 #include <type_traits>
 #include <concepts>
+#include <cstdint>
 #include <functional>
+#include <mutex>
+#include <new>
+#include <vector>
 
 #ifdef DSG_SP_SUPPORT_UNIQUE_PTR
 #include <memory>
 #endif
 
+#ifdef DSG_SP_TRACK_OBJECTS
+#include "ptr_track.hpp"
+#endif
+
 #include <cassert>
 #define DSG_SP_PTR_ASSERT(e) assert(e)
 
@@ -33,11 +55,19 @@ namespace detail {
 using val_t = std::size_t;
 using mo_t = std::memory_order;
 
-struct ref_counter_unsafe {
-  using type = val_t;
+inline constexpr std::size_t cache_line_size = 64;
+
+/// @tparam V 计数宽度，uint32_t 或 uint64_t；32 位计数超过 2^32 - 1 个引用时回绕
+/// uint16_t 只用于 32 位策略的弱计数
+template <typename V>
+concept CCounterWidth =
+    std::unsigned_integral<V> && (sizeof(V) == 2 || sizeof(V) == 4 || sizeof(V) == 8);
+
+template <CCounterWidth V> struct basic_ref_counter_unsafe {
+  using type = V;
 
   static auto store(type &c, val_t v, mo_t mo) -> void {
-    c = v;
+    c = static_cast<V>(v);
   }
 
   static auto load(const type &c, mo_t mo) noexcept -> val_t {
@@ -45,19 +75,29 @@ struct ref_counter_unsafe {
   }
 
   static auto inc(type &c, mo_t mo) noexcept -> val_t {
+    DSG_SP_PTR_ASSERT(c != static_cast<V>(-1));
     return ++c;
   }
 
   static auto dec(type &c, mo_t mo) noexcept -> val_t {
     return --c;
   }
+
+  static auto cas(type &c, val_t &expected, val_t desired, mo_t mo) noexcept -> bool {
+    if (c != expected) {
+      expected = c;
+      return false;
+    }
+    c = static_cast<V>(desired);
+    return true;
+  }
 };
 
-struct ref_counter_safe {
-  using type = std::atomic<val_t>;
+template <CCounterWidth V> struct basic_ref_counter_safe {
+  using type = std::atomic<V>;
 
   static auto store(type &c, val_t v, mo_t mo) -> void {
-    c.store(v, mo);
+    c.store(static_cast<V>(v), mo);
   }
 
   static auto load(const type &c, mo_t mo) -> val_t {
@@ -65,12 +105,386 @@ struct ref_counter_safe {
   }
 
   static auto inc(type &c, mo_t mo) -> val_t {
-    return c.fetch_add(1, mo) + 1;
+    auto n = c.fetch_add(1, mo);
+    DSG_SP_PTR_ASSERT(n != static_cast<V>(-1));
+    return static_cast<val_t>(n) + 1;
   }
 
   static auto dec(type &c, mo_t mo) -> val_t {
-    return c.fetch_sub(1, mo) - 1;
+    return static_cast<V>(c.fetch_sub(1, mo) - 1);
   }
+
+  static auto cas(type &c, val_t &expected, val_t desired, mo_t mo) -> bool {
+    auto e = static_cast<V>(expected);
+    if (c.compare_exchange_weak(e, static_cast<V>(desired), mo, std::memory_order_relaxed)) {
+      return true;
+    }
+    expected = e;
+    return false;
+  }
+};
+
+using ref_counter_unsafe = basic_ref_counter_unsafe<val_t>;
+using ref_counter_safe = basic_ref_counter_safe<val_t>;
+
+template <typename Counter> inline constexpr bool is_atomic_counter_v = false;
+template <typename V> inline constexpr bool is_atomic_counter_v<basic_ref_counter_safe<V>> = true;
+
+using reclaim_fn = void (*)(void *);
+
+/// @brief 延迟回收入口，按线程设置
+class reclaimer {
+public:
+  /// @brief 对象引用已归零，之后调用 fn(p) 完成析构
+  virtual auto retire(void *p, reclaim_fn fn) -> void = 0;
+
+protected:
+  ~reclaimer() = default;
+};
+
+/// @brief 为空时就地析构
+inline thread_local reclaimer *tls_reclaimer = nullptr;
+
+/// @brief 偏置计数：创建对象的线程（属主）用非原子的读写增减偏置计数，
+/// 其他线程原子地增减共享计数，两者之和为引用数。
+///
+/// - 属主的偏置计数减到 0 时合并：共享计数置 merged，之后所有线程都走共享计数
+/// - 其他线程把共享计数减成负数时（对象由属主创建、在别的线程释放），
+///   偏置计数可能已经抵消，它无法判断，于是置 queued 并把对象放进属主的收件箱；
+///   属主在下次合并、collect() 或线程退出时处理收件箱，属主已退出时由该线程直接合并
+/// - 收件箱中的对象在处理前不会析构，属主长期不释放对象时需定期调用 collect()
+///
+/// 属主线程的状态在线程退出后不释放（对象上仍可能指向它），适用于长期存在的线程。
+/// weak_ptr、atomic_ptr 不支持偏置计数。
+struct ref_counter_biased {
+  struct type;
+
+  struct pending {
+    type *_counter;
+    void *_obj;
+    reclaim_fn _fn;
+  };
+
+  struct thread_state {
+    std::mutex _mutex;
+    bool _alive{true};
+    std::atomic<bool> _hasInbox{false};
+    std::vector<pending> _inbox;
+  };
+
+  struct type {
+    std::atomic<thread_state *> _owner{nullptr};
+    std::atomic<val_t> _biased{0};          // 只由属主写
+    std::atomic<std::intptr_t> _shared{0}; // 计数 << 2 | queued | merged
+
+    type(val_t v = 0) noexcept {
+      store(*this, v, std::memory_order_relaxed);
+    }
+  };
+
+  static constexpr std::intptr_t kMerged = 1;
+  static constexpr std::intptr_t kQueued = 2;
+  static constexpr std::intptr_t kOne = 4;
+
+  static inline thread_local thread_state *tls_state = nullptr;
+
+  static auto count_of(std::intptr_t w) -> std::intptr_t {
+    return w >> 2;
+  }
+
+  static auto current() -> thread_state * {
+    if (!tls_state) {
+      struct exit_guard {
+        ~exit_guard() {
+          retire_thread();
+        }
+      };
+      tls_state = new thread_state;
+      static thread_local exit_guard guard;
+    }
+    return tls_state;
+  }
+
+  static auto is_owner(const type &c) -> bool {
+    auto *me = tls_state;
+    return me && c._owner.load(std::memory_order_relaxed) == me;
+  }
+
+  static auto store(type &c, val_t v, mo_t mo) -> void {
+    c._owner.store(v ? current() : nullptr, std::memory_order_relaxed);
+    c._biased.store(v, std::memory_order_relaxed);
+    c._shared.store(0, mo);
+  }
+
+  static auto load(const type &c, mo_t mo) -> val_t {
+    auto n = static_cast<std::intptr_t>(c._biased.load(std::memory_order_relaxed)) +
+             count_of(c._shared.load(mo));
+    return n > 0 ? static_cast<val_t>(n) : 0;
+  }
+
+  static auto inc(type &c, mo_t mo) -> val_t {
+    if (is_owner(c)) {
+      auto b = c._biased.load(std::memory_order_relaxed) + 1;
+      c._biased.store(b, std::memory_order_relaxed);
+      auto n = count_of(c._shared.load(std::memory_order_relaxed));
+      return b + static_cast<val_t>(n > 0 ? n : 0);
+    }
+    c._shared.fetch_add(kOne, mo);
+    return std::max<val_t>(load(c, std::memory_order_relaxed), 2); // 调用方已持有引用
+  }
+
+  static auto dec(type &c, mo_t mo) -> val_t {
+    return dec(c, mo, nullptr, nullptr);
+  }
+
+  /// @param obj 对象，引用在收件箱中归零时用 fn(obj) 析构
+  /// @return 0 表示调用方应立即析构
+  static auto dec(type &c, mo_t mo, void *obj, reclaim_fn fn) -> val_t {
+    if (is_owner(c)) {
+      auto b = c._biased.load(std::memory_order_relaxed) - 1;
+      c._biased.store(b, std::memory_order_relaxed);
+      // 其他线程的释放已把对象排进收件箱时，顺带合并，不必等下一次 collect
+      if (b > 0 && !(c._shared.load(std::memory_order_relaxed) & kQueued)) {
+        return b;
+      }
+      return owner_release(c);
+    }
+    return shared_release(c, mo, obj, fn);
+  }
+
+  /// @brief 仅为满足计数接口，weak_ptr、atomic_ptr 不使用偏置计数
+  static auto cas(type &c, val_t &expected, val_t desired, mo_t mo) -> bool {
+    auto n = load(c, mo);
+    if (n != expected) {
+      expected = n;
+      return false;
+    }
+    if (desired > expected) {
+      inc(c, mo);
+    } else if (desired < expected) {
+      dec(c, mo);
+    }
+    return true;
+  }
+
+  /// @brief 在属主线程处理收件箱
+  static auto collect() -> void {
+    auto *me = tls_state;
+    if (!me || !me->_hasInbox.load(std::memory_order_acquire)) {
+      return;
+    }
+    std::vector<pending> inbox;
+    {
+      std::lock_guard<std::mutex> lock{me->_mutex};
+      inbox.swap(me->_inbox);
+      me->_hasInbox.store(false, std::memory_order_relaxed);
+    }
+    drain(inbox);
+  }
+
+private:
+  /// @brief 偏置计数归零或对象已排队，由属主调用
+  static auto owner_release(type &c) -> val_t {
+    auto w = c._shared.load(std::memory_order_relaxed);
+    do {
+      if (w & kQueued) {
+        // 已在收件箱中，交由收件箱合并，对象此后可能已析构
+        collect();
+        return 1;
+      }
+    } while (!c._shared.compare_exchange_weak(w, w | kMerged, std::memory_order_acq_rel,
+                                              std::memory_order_relaxed));
+    c._owner.store(nullptr, std::memory_order_relaxed);
+    collect();
+    auto n = count_of(w);
+    return n > 0 ? static_cast<val_t>(n) : 0;
+  }
+
+  static auto shared_release(type &c, mo_t mo, void *obj, reclaim_fn fn) -> val_t {
+    auto w = c._shared.load(std::memory_order_relaxed);
+    std::intptr_t n = 0;
+    do {
+      n = w - kOne;
+      if (!(n & (kMerged | kQueued)) && count_of(n) < 0) {
+        n |= kQueued;
+      }
+    } while (!c._shared.compare_exchange_weak(w, n, mo, std::memory_order_relaxed));
+
+    if (n & kMerged) {
+      return count_of(n) == 0 ? 0 : 1;
+    }
+    if ((n & kQueued) && !(w & kQueued)) {
+      return request_merge(c, obj, fn);
+    }
+    return 1; // 属主的偏置计数仍持有引用
+  }
+
+  static auto request_merge(type &c, void *obj, reclaim_fn fn) -> val_t {
+    auto *owner = c._owner.load(std::memory_order_acquire);
+    {
+      std::lock_guard<std::mutex> lock{owner->_mutex};
+      if (owner->_alive) {
+        owner->_inbox.push_back({&c, obj, fn});
+        owner->_hasInbox.store(true, std::memory_order_release);
+        return 1;
+      }
+    }
+    // 属主已退出，偏置计数不会再变
+    return merge(c) == 0 ? 0 : 1;
+  }
+
+  /// @brief 偏置计数并入共享计数
+  /// @return 合并后的引用数
+  static auto merge(type &c) -> std::intptr_t {
+    auto b = static_cast<std::intptr_t>(c._biased.load(std::memory_order_relaxed));
+    c._biased.store(0, std::memory_order_relaxed);
+    c._owner.store(nullptr, std::memory_order_relaxed);
+    auto w = c._shared.fetch_add(b * kOne + kMerged, std::memory_order_acq_rel);
+    return count_of(w) + b;
+  }
+
+  static auto drain(std::vector<pending> &inbox) -> void {
+    for (auto &p : inbox) {
+      if (merge(*p._counter) == 0) {
+        if (auto *r = tls_reclaimer) {
+          r->retire(p._obj, p._fn);
+        } else {
+          p._fn(p._obj);
+        }
+      }
+    }
+  }
+
+  static auto retire_thread() -> void {
+    auto *me = tls_state;
+    std::vector<pending> inbox;
+    {
+      std::lock_guard<std::mutex> lock{me->_mutex};
+      me->_alive = false;
+      inbox.swap(me->_inbox);
+    }
+    drain(inbox);
+    // 对象上仍可能指向已退出线程的状态，留存不释放
+    static std::mutex mutex;
+    static auto *retired = new std::vector<thread_state *>;
+    std::lock_guard<std::mutex> lock{mutex};
+    retired->push_back(me);
+  }
+};
+
+/// @brief 对象最外层（完整对象）的地址，即 new 返回的地址
+template <typename T> auto storage_of(T *t) -> void * {
+  if constexpr (std::is_polymorphic_v<T>) {
+    return const_cast<void *>(dynamic_cast<const volatile void *>(t));
+  } else {
+    return const_cast<void *>(static_cast<const volatile void *>(t));
+  }
+}
+
+/// @brief 回收已析构对象的内存
+/// @param p 完整对象地址
+using dealloc_fn = void (*)(void *);
+
+/// @brief 只回收内存，对象已析构
+template <typename T> auto deallocate(void *p) -> void {
+  using U = std::remove_cv_t<T>;
+  if constexpr (requires { U::operator delete(p, sizeof(U)); }) {
+    U::operator delete(p, sizeof(U));
+  } else if constexpr (requires { U::operator delete(p); }) {
+    U::operator delete(p);
+  } else if constexpr (alignof(U) > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+    ::operator delete(p, std::align_val_t{alignof(U)});
+  } else {
+    ::operator delete(p);
+  }
+}
+
+/// @brief 回收内存不能用全局 operator delete(void *) 的类型
+template <typename T>
+concept CCustomDealloc = requires(void *p) { std::remove_cv_t<T>::operator delete(p); } ||
+                         requires(void *p) {
+                           std::remove_cv_t<T>::operator delete(p, sizeof(T));
+                         } || alignof(T) > __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+
+/// @brief 类型的回收函数表，编号存进对象，最后一个弱引用释放时按编号回收内存
+/// 只登记 CCustomDealloc 的类型，编号 0 为全局 operator delete；只增不减，查找无锁
+class dealloc_registry final {
+public:
+  using id_t = uint16_t;
+
+  template <typename T> static auto id_of() -> id_t {
+    if constexpr (CCustomDealloc<T>) {
+      static const id_t id = add(&deallocate<T>);
+      return id;
+    } else {
+      return 0;
+    }
+  }
+
+  static auto get(id_t id) -> dealloc_fn {
+    if (id == 0) {
+      return [](void *p) { ::operator delete(p); };
+    }
+    return chunks()[id / kChunk].load(std::memory_order_acquire)[id % kChunk];
+  }
+
+private:
+  static constexpr std::size_t kChunk = 256;
+  static constexpr std::size_t kChunks = (std::size_t{1} << (8 * sizeof(id_t))) / kChunk;
+
+  static auto chunks() -> std::atomic<dealloc_fn *> * {
+    static std::atomic<dealloc_fn *> table[kChunks];
+    return table;
+  }
+
+  static auto add(dealloc_fn fn) -> id_t {
+    static std::mutex mutex;
+    static std::size_t next = 1;
+    std::lock_guard<std::mutex> lock{mutex};
+    DSG_SP_PTR_ASSERT(next < kChunk * kChunks);
+    auto id = next++;
+    auto &chunk = chunks()[id / kChunk];
+    auto *entries = chunk.load(std::memory_order_relaxed);
+    if (!entries) {
+      entries = new dealloc_fn[kChunk]{};
+    }
+    entries[id % kChunk] = fn;
+    chunk.store(entries, std::memory_order_release);
+    return static_cast<id_t>(id);
+  }
+};
+
+/// @brief 嵌在 ptr_policy 中，对象拷贝、赋值时不跟随
+struct dealloc_slot {
+  dealloc_registry::id_t _id{0};
+
+  dealloc_slot() noexcept = default;
+  dealloc_slot(const dealloc_slot &) noexcept {
+  }
+  dealloc_slot &operator=(const dealloc_slot &) noexcept {
+    return *this;
+  }
+};
+
+/// @brief 弱计数取强计数一半的宽度，余下空间放回收函数编号，对象大小不变
+template <typename Counter> struct weak_counter_of {
+  using type = Counter;
+};
+template <> struct weak_counter_of<basic_ref_counter_safe<uint64_t>> {
+  using type = basic_ref_counter_safe<uint32_t>;
+};
+template <> struct weak_counter_of<basic_ref_counter_safe<uint32_t>> {
+  using type = basic_ref_counter_safe<uint16_t>;
+};
+template <> struct weak_counter_of<basic_ref_counter_unsafe<uint64_t>> {
+  using type = basic_ref_counter_unsafe<uint32_t>;
+};
+template <> struct weak_counter_of<basic_ref_counter_unsafe<uint32_t>> {
+  using type = basic_ref_counter_unsafe<uint16_t>;
+};
+/// 偏置计数不支持弱引用，弱计数只在创建和释放时访问
+template <> struct weak_counter_of<ref_counter_biased> {
+  using type = basic_ref_counter_unsafe<uint32_t>;
 };
 } // namespace detail
 
@@ -84,6 +498,7 @@ concept CCounter = requires(T t, U u, detail::val_t v, detail::mo_t mo) {
   T::load(u, mo);
   T::inc(u, mo);
   T::dec(u, mo);
+  T::cas(u, v, v, mo);
 };
 } // namespace traits
 
@@ -114,6 +529,20 @@ public:
     return T::dec(_counter, mo);
   }
 
+  /// @brief 计数可能推迟归零时（偏置计数），之后用 fn(obj) 析构
+  auto dec(void *obj, detail::reclaim_fn fn, mo_t mo = std::memory_order_acq_rel) -> val_t {
+    if constexpr (requires { T::dec(_counter, mo, obj, fn); }) {
+      return T::dec(_counter, mo, obj, fn);
+    } else {
+      return T::dec(_counter, mo);
+    }
+  }
+
+  /// @brief 失败时 expected 更新为当前值，可能伪失败，需在循环中使用
+  auto cas(val_t &expected, val_t desired, mo_t mo = std::memory_order_acq_rel) -> bool {
+    return T::cas(_counter, expected, desired, mo);
+  }
+
   ref_counter(const ref_counter &r) {
     store(r.load());
   }
@@ -135,24 +564,68 @@ public:
   }
 };
 
-template <traits::CCounter Counter> class ptr_policy;
+/// @brief 计数在对象中的布局
+enum class counter_layout {
+  packed,     ///< 紧凑，计数与对象成员相邻
+  cache_line, ///< 计数独占一个缓存行，频繁拷贝时不与相邻成员、相邻对象伪共享
+};
+
+template <traits::CCounter Counter, counter_layout Layout = counter_layout::packed>
+class ptr_policy;
+
+namespace detail {
+/// @brief 计数之后的填充；派生类成员会复用基类尾部的对齐空隙，只靠 alignas 不能独占缓存行
+template <counter_layout Layout, std::size_t Used> struct counter_padding {};
+template <std::size_t Used> struct counter_padding<counter_layout::cache_line, Used> {
+  std::byte _pad[cache_line_size - Used];
+};
+
+template <typename P> inline constexpr bool is_ptr_policy_v = false;
+template <typename C, counter_layout L> inline constexpr bool is_ptr_policy_v<ptr_policy<C, L>> = true;
+} // namespace detail
 
 namespace traits {
 template <typename T>
-concept CPtrT = std::derived_from<T, ptr_policy<detail::ref_counter_safe>> ||
-                std::derived_from<T, ptr_policy<detail::ref_counter_unsafe>>;
+concept CPtrT = requires { typename T::ptr_policy_type; } &&
+                detail::is_ptr_policy_v<typename T::ptr_policy_type> &&
+                std::derived_from<T, typename T::ptr_policy_type>;
 
 struct RawPtrConstructNoRef {};
 struct RawPtrConstructRef {};
 
 } // namespace traits
 
-template <traits::CCounter Counter> class ptr_policy {
+template <traits::CCounter Counter, counter_layout Layout>
+class alignas(Layout == counter_layout::cache_line ? detail::cache_line_size
+                                                   : alignof(typename Counter::type)) ptr_policy {
+public:
+  using ptr_policy_type = ptr_policy;
+  using counter_type = Counter;
+
 private:
   /// @brief object ref
   mutable ref_counter<Counter> _ref_counter;
+#ifdef DSG_SP_TRACK_OBJECTS
+  mutable detail::track::slot _track;
+#endif
+  /// @brief weak_ptr 个数，强引用存在时另加 1；偏置计数不支持弱引用，只在创建和释放时访问
+  mutable ref_counter<typename detail::weak_counter_of<Counter>::type> _weak_counter;
+  /// @brief 回收内存用的函数编号，与弱计数共用强计数宽度的空间
+  mutable detail::dealloc_slot _dealloc;
+#ifdef DSG_SP_TRACK_OBJECTS
+  [[no_unique_address]] detail::counter_padding<Layout, sizeof(_ref_counter) + sizeof(_track) +
+                                                            sizeof(_weak_counter) +
+                                                            sizeof(_dealloc)>
+      _padding;
+#else
+  [[no_unique_address]] detail::counter_padding<
+      Layout, sizeof(_ref_counter) + sizeof(_weak_counter) + sizeof(_dealloc)>
+      _padding;
+#endif
 
   template <traits::CPtrT U> friend class ptr;
+  template <traits::CPtrT U> friend class weak_ptr;
+  template <traits::CPtrT U> friend class atomic_ptr;
 
 protected:
   ~ptr_policy() noexcept = default;
@@ -171,11 +644,31 @@ protected:
 /// 直接继承
 using ref_policy = ptr_policy<detail::ref_counter_safe>;
 using unsafe_ref_policy = ptr_policy<detail::ref_counter_unsafe>;
+using biased_ref_policy = ptr_policy<detail::ref_counter_biased>;
+
+/// 32 位计数，小对象省去 8 字节（弱计数 16 位，同一对象的 weak_ptr 不超过 65535 个）
+using compact_ref_policy = ptr_policy<detail::basic_ref_counter_safe<uint32_t>>;
+using unsafe_compact_ref_policy = ptr_policy<detail::basic_ref_counter_unsafe<uint32_t>>;
+/// 计数独占缓存行，被多个线程频繁拷贝的共享对象使用
+using isolated_ref_policy = ptr_policy<detail::ref_counter_safe, counter_layout::cache_line>;
+
+#ifndef DSG_SP_TRACK_OBJECTS
+static_assert(sizeof(ref_policy) == 2 * sizeof(detail::val_t));
+static_assert(sizeof(compact_ref_policy) == 2 * sizeof(uint32_t));
+static_assert(sizeof(unsafe_compact_ref_policy) == 2 * sizeof(uint32_t));
+#endif
+static_assert(sizeof(isolated_ref_policy) == detail::cache_line_size &&
+              alignof(isolated_ref_policy) == detail::cache_line_size);
 ///////////////////////////////////////////////////////////
 
+/// @brief 在偏置计数对象的属主线程上处理其他线程释放的对象，静止点调用
+inline auto collect_biased() -> void {
+  detail::ref_counter_biased::collect();
+}
+
 namespace traits {
 template <typename T>
-concept CPrtPolicyT = std::is_same_v<T, ref_policy> || std::is_same_v<T, unsafe_ref_policy>;
+concept CPrtPolicyT = detail::is_ptr_policy_v<T>;
 }
 
 namespace detail {
@@ -193,14 +686,16 @@ using interface_wrapper = detail::__interface_wrapper<Interface, ref_policy>;
 
 template <typename Interface>
 using unsafe_interface_wrapper = detail::__interface_wrapper<Interface, unsafe_ref_policy>;
+
+template <typename Interface>
+using biased_interface_wrapper = detail::__interface_wrapper<Interface, biased_ref_policy>;
 ///////////////////////////////////////////////////////////
 
 /// @brief ptr
 template <traits::CPtrT T> class ptr final {
 public:
   using element_type = T;
-  using ptr_policy_type =
-      std::conditional_t<std::derived_from<T, ref_policy>, ref_policy, unsafe_ref_policy>;
+  using ptr_policy_type = typename T::ptr_policy_type;
 
   ptr() noexcept : ptr{nullptr, traits::RawPtrConstructNoRef{}} {
   }
@@ -327,6 +822,11 @@ private:
     DSG_SP_PTR_ASSERT(!_t || (_t->_ref_counter.load() == 0));
     if (_t) {
       _t->_ref_counter.store(1);
+      _t->_weak_counter.store(1);
+      _t->_dealloc._id = detail::dealloc_registry::id_of<std::remove_cv_t<T>>();
+#ifdef DSG_SP_TRACK_OBJECTS
+      detail::track::on_create(_t->_track, detail::track::record_of<std::remove_cv_t<T>>());
+#endif
     }
   }
 
@@ -338,11 +838,39 @@ private:
   }
 
   auto dec_ref() -> void {
-    if (_t && _t->_ref_counter.dec() == 0) {
-      delete _t;
+    if (_t && _t->_ref_counter.dec(const_cast<void *>(static_cast<const volatile void *>(_t)),
+                                   &ptr::reclaim) == 0) {
+      if (auto *r = detail::tls_reclaimer) {
+        r->retire(const_cast<void *>(static_cast<const volatile void *>(_t)), &ptr::reclaim);
+      } else {
+        release(_t);
+      }
       _t = nullptr;
     }
   }
+
+  static auto reclaim(void *p) -> void {
+    release(static_cast<T *>(p));
+  }
+
+  static auto release(T *t) -> void {
+#ifdef DSG_SP_TRACK_OBJECTS
+    detail::track::on_destroy(t->_track);
+#endif
+    // 只剩强引用持有的 1：没有弱引用，强计数已为 0 也不会再产生
+    if (t->_weak_counter.load() == 1) {
+      delete t;
+      return;
+    }
+    // 计数和回收编号都是平凡析构的成员，对象析构后留在原处，由最后一个弱引用回收内存
+    auto storage = detail::storage_of(t);
+    auto dealloc = detail::dealloc_registry::get(t->_dealloc._id);
+    auto &weak = t->_weak_counter;
+    t->~T();
+    if (weak.dec() == 0) {
+      dealloc(storage);
+    }
+  }
 };
 
 template <traits::CPtrT T, typename... Args> inline ptr<T> make_ptr(Args &&...args) {
@@ -438,6 +966,294 @@ template <traits::CPtrT T, traits::CPtrT U> ptr<T> reinterpret_pointer_cast(ptr<
   return r;
 }
 
+/// @brief 弱引用，不延长对象生命周期，lock() 成功时返回强引用
+template <traits::CPtrT T> class weak_ptr final {
+  static_assert(!std::is_same_v<typename T::counter_type, detail::ref_counter_biased>,
+                "weak_ptr does not support biased_ref_policy");
+
+public:
+  using element_type = T;
+
+  weak_ptr() noexcept = default;
+  weak_ptr(std::nullptr_t) noexcept {
+  }
+
+  template <traits::CPtrT U>
+  requires std::is_convertible_v<U *, T *>
+  weak_ptr(const ptr<U> &p) : _t{p.get()}, _storage{_t ? detail::storage_of(p.get()) : nullptr} {
+    add_ref();
+  }
+
+  /// copy
+  template <traits::CPtrT U>
+  requires std::is_convertible_v<U *, T *>
+  weak_ptr(const weak_ptr<U> &wp) : _t{wp._t}, _storage{wp._storage} {
+    add_ref();
+  }
+
+  weak_ptr(const weak_ptr &wp) : _t{wp._t}, _storage{wp._storage} {
+    add_ref();
+  }
+
+  template <traits::CPtrT U>
+  requires std::is_convertible_v<U *, T *>
+  weak_ptr &operator=(const ptr<U> &p) {
+    weak_ptr(p).swap(*this);
+    return *this;
+  }
+
+  template <traits::CPtrT U>
+  requires std::is_convertible_v<U *, T *>
+  weak_ptr &operator=(const weak_ptr<U> &wp) {
+    weak_ptr(wp).swap(*this);
+    return *this;
+  }
+
+  weak_ptr &operator=(const weak_ptr &wp) {
+    weak_ptr(wp).swap(*this);
+    return *this;
+  }
+
+  /// move
+  template <traits::CPtrT U>
+  requires std::is_convertible_v<U *, T *>
+  weak_ptr(weak_ptr<U> &&wp) noexcept : _t{wp._t}, _storage{wp._storage} {
+    wp._t = nullptr;
+    wp._storage = nullptr;
+  }
+
+  weak_ptr(weak_ptr &&wp) noexcept : _t{wp._t}, _storage{wp._storage} {
+    wp._t = nullptr;
+    wp._storage = nullptr;
+  }
+
+  template <traits::CPtrT U>
+  requires std::is_convertible_v<U *, T *>
+  weak_ptr &operator=(weak_ptr<U> &&wp) noexcept {
+    weak_ptr(std::move(wp)).swap(*this);
+    return *this;
+  }
+
+  weak_ptr &operator=(weak_ptr &&wp) noexcept {
+    weak_ptr(std::move(wp)).swap(*this);
+    return *this;
+  }
+
+  ~weak_ptr() {
+    dec_ref();
+  }
+
+  auto swap(weak_ptr &wp) noexcept -> void {
+    std::swap(_t, wp._t);
+    std::swap(_storage, wp._storage);
+  }
+
+  auto reset() -> void {
+    weak_ptr().swap(*this);
+  }
+
+  /// @brief 强引用个数
+  auto use_count() const -> detail::val_t {
+    return _t ? _t->_ref_counter.load() : 0;
+  }
+
+  auto expired() const -> bool {
+    return use_count() == 0;
+  }
+
+  /// @brief 强计数不为 0 时加 1，无锁
+  /// @return 对象已析构返回空指针
+  auto lock() const -> ptr<T> {
+    if (!_t) {
+      return nullptr;
+    }
+    auto &strong = _t->_ref_counter;
+    auto n = strong.load(std::memory_order_relaxed);
+    do {
+      if (n == 0) {
+        return nullptr;
+      }
+    } while (!strong.cas(n, n + 1));
+    return ptr<T>{_t, traits::RawPtrConstructNoRef{}};
+  }
+
+private:
+  T *_t{nullptr};
+  void *_storage{nullptr}; // 完整对象地址，对象析构后用于回收内存
+
+  template <traits::CPtrT U> friend class weak_ptr;
+
+  auto add_ref() -> void {
+    if (_t) {
+      auto new_weak_count = _t->_weak_counter.inc();
+      DSG_SP_PTR_ASSERT(new_weak_count > 1);
+    }
+  }
+
+  auto dec_ref() -> void {
+    if (_t && _t->_weak_counter.dec() == 0) {
+      detail::dealloc_registry::get(_t->_dealloc._id)(_storage);
+      _t = nullptr;
+    }
+  }
+};
+
+template <traits::CPtrT T> inline auto swap(weak_ptr<T> &lp, weak_ptr<T> &rp) noexcept -> void {
+  lp.swap(rp);
+}
+
+/// @brief 可被多个线程同时读写的 ptr，用于热替换配置、路由表等，读写都不加锁
+///
+/// 对象指针和已取走的引用数打包在一个 64 位原子字里。存入时预先给对象加 kBatch 个强引用，
+/// load() 只对原子字做一次 fetch_add 取走其中一个，不修改对象计数；取走过半时由读者补充，
+/// 换出时把未取走的引用还给对象。取走的引用本身就是强引用，不存在归还时的 ABA。
+/// 要求用户态指针不超过 48 位，同时处在 load() 中的线程不超过 kBatch / 2。
+/// 存入期间对象的 use_count() 包含预加的引用。
+template <traits::CPtrT T> class atomic_ptr final {
+  static_assert(detail::is_atomic_counter_v<typename T::counter_type>,
+                "atomic_ptr requires thread safe ref_policy");
+
+public:
+  atomic_ptr() noexcept = default;
+  explicit atomic_ptr(ptr<T> p) : _word{pack(install(std::move(p)), 0)} {
+  }
+
+  ~atomic_ptr() {
+    release(_word.load(std::memory_order_acquire));
+  }
+
+  atomic_ptr(const atomic_ptr &) = delete;
+  atomic_ptr &operator=(const atomic_ptr &) = delete;
+
+  /// @brief 读取当前对象，wait-free（补充引用时除外）
+  auto load() const -> ptr<T> {
+    if (!ptr_of(_word.load(std::memory_order_relaxed))) {
+      return nullptr;
+    }
+    auto word = _word.fetch_add(kOne, std::memory_order_acq_rel);
+    auto *t = ptr_of(word);
+    if (!t) {
+      undo_take();
+      return nullptr;
+    }
+    auto taken = count_of(word) + 1;
+    DSG_SP_PTR_ASSERT(taken < kBatch);
+    if (taken >= kBatch / 2) {
+      refill(t);
+    }
+    return ptr<T>{t, traits::RawPtrConstructNoRef{}};
+  }
+
+  auto store(ptr<T> p) -> void {
+    exchange(std::move(p));
+  }
+
+  /// @return 原来的对象
+  auto exchange(ptr<T> p) -> ptr<T> {
+    auto word = _word.exchange(pack(install(std::move(p)), 0), std::memory_order_acq_rel);
+    return release(word);
+  }
+
+  /// @brief 当前对象为 expected 时替换为 desired
+  /// @param expected 失败时更新为当前对象
+  /// @param desired
+  /// @return 是否替换
+  auto compare_exchange(ptr<T> &expected, ptr<T> desired) -> bool {
+    const auto installed = pack(install(std::move(desired)), 0);
+    auto word = _word.load(std::memory_order_acquire);
+    while (ptr_of(word) == expected.get()) {
+      if (_word.compare_exchange_weak(word, installed, std::memory_order_acq_rel,
+                                      std::memory_order_acquire)) {
+        release(word);
+        return true;
+      }
+    }
+    release(installed);
+    expected = load();
+    return false;
+  }
+
+private:
+  static constexpr int kPtrBits = 48;
+  static constexpr uint64_t kPtrMask = (uint64_t{1} << kPtrBits) - 1;
+  static constexpr uint64_t kOne = uint64_t{1} << kPtrBits;
+  static constexpr detail::val_t kBatch = detail::val_t{1} << 15;
+
+  static_assert(sizeof(void *) <= sizeof(uint64_t));
+
+  mutable std::atomic<uint64_t> _word{0};
+
+  static auto pack(T *t, uint64_t count) -> uint64_t {
+    auto bits = static_cast<uint64_t>(reinterpret_cast<std::uintptr_t>(t));
+    DSG_SP_PTR_ASSERT((bits & ~kPtrMask) == 0);
+    return bits | count << kPtrBits;
+  }
+
+  static auto ptr_of(uint64_t word) -> T * {
+    return reinterpret_cast<T *>(static_cast<std::uintptr_t>(word & kPtrMask));
+  }
+
+  static auto count_of(uint64_t word) -> detail::val_t {
+    return static_cast<detail::val_t>(word >> kPtrBits);
+  }
+
+  static auto add(T *t, detail::val_t n) -> void {
+    auto c = t->_ref_counter.load(std::memory_order_relaxed);
+    while (!t->_ref_counter.cas(c, c + n)) {
+    }
+  }
+
+  /// @brief 调用方另外持有引用，计数不会减到 0
+  static auto sub(T *t, detail::val_t n) -> void {
+    auto c = t->_ref_counter.load(std::memory_order_relaxed);
+    while (!t->_ref_counter.cas(c, c - n)) {
+    }
+  }
+
+  /// @brief 接管 p 的引用，另外预加 kBatch - 1 个
+  static auto install(ptr<T> p) -> T * {
+    auto *t = p.detach();
+    if (t) {
+      add(t, kBatch - 1);
+    }
+    return t;
+  }
+
+  /// @brief 换出后归还未取走的引用，保留一个交给返回值
+  static auto release(uint64_t word) -> ptr<T> {
+    auto *t = ptr_of(word);
+    if (t) {
+      auto left = kBatch - count_of(word);
+      if (left > 1) {
+        sub(t, left - 1);
+      }
+    }
+    return ptr<T>{t, traits::RawPtrConstructNoRef{}};
+  }
+
+  /// @brief 补充已取走的引用，原子字已被替换或他人已补充时放弃
+  auto refill(T *t) const -> void {
+    auto word = _word.load(std::memory_order_relaxed);
+    while (ptr_of(word) == t && count_of(word) >= kBatch / 2) {
+      auto taken = count_of(word);
+      add(t, taken);
+      if (_word.compare_exchange_weak(word, pack(t, 0), std::memory_order_acq_rel,
+                                      std::memory_order_relaxed)) {
+        return;
+      }
+      sub(t, taken);
+    }
+  }
+
+  /// @brief load() 时对象已被置空，撤销多加的计数
+  auto undo_take() const -> void {
+    auto word = _word.load(std::memory_order_relaxed);
+    while (!ptr_of(word) && count_of(word) > 0 &&
+           !_word.compare_exchange_weak(word, word - kOne, std::memory_order_relaxed)) {
+    }
+  }
+};
+
 template <traits::CPtrT T> class scope_ptr {
 public:
   using func = std::function<void(T *)>;
@@ -456,6 +1272,8 @@ private:
 };
 
 namespace detail {
+template <typename Interface, traits::CPrtPolicyT PtrPolicyT> class weak_interface_ptr;
+
 template <typename Interface, traits::CPrtPolicyT PtrPolicyT = ref_policy>
 class interface_ptr final {
 public:
@@ -516,6 +1334,43 @@ public:
 
 private:
   ptr<detail::__interface_wrapper<Interface, PtrPolicyT>> _p;
+
+  friend class weak_interface_ptr<Interface, PtrPolicyT>;
+};
+
+template <typename Interface, traits::CPrtPolicyT PtrPolicyT = ref_policy>
+class weak_interface_ptr final {
+public:
+  weak_interface_ptr() = default;
+  ~weak_interface_ptr() = default;
+  weak_interface_ptr(const weak_interface_ptr &) = default;
+  weak_interface_ptr &operator=(const weak_interface_ptr &) = default;
+  weak_interface_ptr(weak_interface_ptr &&) noexcept = default;
+  weak_interface_ptr &operator=(weak_interface_ptr &&) noexcept = default;
+
+  weak_interface_ptr(const interface_ptr<Interface, PtrPolicyT> &p) : _p{p._p} {
+  }
+
+  weak_interface_ptr &operator=(const interface_ptr<Interface, PtrPolicyT> &p) {
+    _p = p._p;
+    return *this;
+  }
+
+  auto reset() -> void {
+    _p.reset();
+  }
+
+  auto expired() const -> bool {
+    return _p.expired();
+  }
+
+  /// @return 对象已析构返回空指针
+  auto lock() const -> interface_ptr<Interface, PtrPolicyT> {
+    return _p.lock();
+  }
+
+private:
+  weak_ptr<detail::__interface_wrapper<Interface, PtrPolicyT>> _p;
 };
 } // namespace detail
 
@@ -538,6 +1393,15 @@ template <typename Interface> using interface_ptr = detail::interface_ptr<Interf
 template <typename Interface>
 using unsafe_interface_ptr = detail::interface_ptr<Interface, unsafe_ref_policy>;
 
+template <typename Interface>
+using biased_interface_ptr = detail::interface_ptr<Interface, biased_ref_policy>;
+
+template <typename Interface>
+using weak_interface_ptr = detail::weak_interface_ptr<Interface, ref_policy>;
+
+template <typename Interface>
+using unsafe_weak_interface_ptr = detail::weak_interface_ptr<Interface, unsafe_ref_policy>;
+
 } // namespace dsg::sp
 
 namespace std {
@@ -562,6 +1426,13 @@ public:
   }
 };
 
+template <typename Interface> class hash<dsg::sp::biased_interface_ptr<Interface>> {
+public:
+  size_t operator()(const dsg::sp::biased_interface_ptr<Interface> &p) const {
+    return std::hash<Interface *>()(p.get());
+  }
+};
+
 } // namespace std
 
 namespace dsg {
@@ -0,0 +1,98 @@
+/**
+ * @file ptr_reclaim.hpp
+ * @brief ptr 对象的延迟回收，热点线程不承担析构开销
+ *
+ * 线程进入 reclaim_scope 后，该线程上释放的最后一个引用不再就地 delete，
+ * 对象先记入线程自己的列表，攒够一批再整体交给 reclaim_domain，
+ * 由后台线程或在调用 collect() 的静止点统一析构。
+ * 引用归零时对象已不可达（weak_ptr 的 lock() 此时已失败），推迟析构不需要额外的纪元判断。
+ *
+ * @code
+ * reclaim_domain domain;            // 默认启动后台线程
+ * std::thread pipeline{[&] {
+ *   reclaim_scope scope{domain};
+ *   while (running) {
+ *     auto frame = Next();            // 帧、消息、连接等在这里释放
+ *     ...
+ *   }
+ * }};
+ * @endcode
+ */
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "ptr.hpp"
+
+namespace dsg::sp {
+class reclaim_domain final {
+public:
+  /// @param background 是否启动后台析构线程，否则由使用方调用 collect()
+  explicit reclaim_domain(bool background = true);
+  /// @brief 析构所有已交回的对象，须在各 reclaim_scope 结束之后
+  ~reclaim_domain();
+
+  reclaim_domain(const reclaim_domain &) = delete;
+  reclaim_domain &operator=(const reclaim_domain &) = delete;
+
+  /// @brief 在调用线程析构已交回的对象
+  /// @return 析构的对象数
+  auto collect() -> std::size_t;
+
+  /// @brief 已交回、尚未析构的对象数
+  auto pending() const -> std::size_t;
+
+  /// @brief 累计析构的对象数
+  auto reclaimed() const -> std::size_t;
+
+private:
+  friend class reclaim_scope;
+
+  struct retired {
+    void *_p;
+    detail::reclaim_fn _fn;
+  };
+  using batch = std::vector<retired>;
+
+  static constexpr std::size_t kBatch = 64;
+
+  mutable std::mutex _mutex;
+  std::condition_variable _cv;
+  std::vector<batch> _queue; // 待析构的批次
+  std::vector<batch> _spare; // 清空后复用的批次，交接时不分配
+  std::size_t _pending{0};
+  std::size_t _reclaimed{0};
+  bool _stop{false};
+  std::thread _thread;
+
+  /// @brief 交回一批，换回一个空批次
+  auto hand_off(batch &b) -> void;
+  auto drain(std::unique_lock<std::mutex> &lock) -> std::size_t;
+  auto run() -> void;
+};
+
+/// @brief 作用域内本线程释放的对象交给 domain 析构，可嵌套，离开时交回剩余对象
+class reclaim_scope final : public detail::reclaimer {
+public:
+  explicit reclaim_scope(reclaim_domain &domain);
+  ~reclaim_scope();
+
+  reclaim_scope(const reclaim_scope &) = delete;
+  reclaim_scope &operator=(const reclaim_scope &) = delete;
+
+  /// @brief 静止点：把本线程攒下的对象立即交回
+  auto flush() -> void;
+
+  auto retire(void *p, detail::reclaim_fn fn) -> void override;
+
+private:
+  reclaim_domain &_domain;
+  detail::reclaimer *_prev;
+  reclaim_domain::batch _batch;
+};
+} // namespace dsg::sp
@@ -0,0 +1,280 @@
+/**
+ * @file ptr_track.hpp
+ * @brief ptr 对象按类型统计存活数，用于查找泄漏（如循环引用）
+ *
+ * 定义 DSG_SP_TRACK_OBJECTS 后启用（CMake 选项 DSG_SP_TRACK_OBJECTS），ptr.hpp 自动包含本文件：
+ * 1. 每个 ptr_policy 多一个跟踪槽，ptr 接管新对象时计入其类型，对象析构时扣除
+ * 2. 计数按线程分片，每个分片独占缓存行，创建、析构只做一次 relaxed fetch_add，
+ *    峰值在创建时汇总分片后用 CAS 更新
+ * 3. 再定义 DSG_SP_TRACK_BACKTRACE 时记录创建调用栈，按调用栈统计存活数（每次创建都要回溯，较慢）
+ * 4. census() / dump_census() 随时获取各类型的存活数、峰值、累计创建数
+ *
+ * 未定义时 ptr.hpp 不包含本文件，对象大小和计数路径都不变。
+ * 该宏改变 ptr_policy 的布局，所有编译单元（包括 jbcore 库）须一致。
+ * 类型按 ptr 第一次接管对象时的静态类型记录，make_ptr<T> 即为 T。
+ *
+ * @code
+ * // 定时或在收到调试命令时
+ * dsg::sp::dump_census(std::cerr);
+ * @endcode
+ */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+
+#ifdef __GNUG__
+#include <cxxabi.h>
+#endif
+
+#ifdef DSG_SP_TRACK_BACKTRACE
+#include <execinfo.h>
+#endif
+
+namespace dsg::sp {
+namespace detail::track {
+inline constexpr std::size_t kShards = 8;
+inline constexpr int kFrames = 16;
+
+/// @brief 线程固定使用的分片
+inline auto shard_index() -> std::size_t {
+  static std::atomic<std::size_t> next{0};
+  thread_local std::size_t index = next.fetch_add(1, std::memory_order_relaxed) % kShards;
+  return index;
+}
+
+struct alignas(64) shard {
+  std::atomic<int64_t> _created{0};
+  std::atomic<int64_t> _destroyed{0};
+};
+
+/// @brief 一个创建调用栈及其存活对象数
+struct site {
+  void *_frames[kFrames];
+  int _depth;
+  std::atomic<int64_t> _live{0};
+};
+
+class type_record;
+
+/// @brief 所有出现过的类型，只增不减
+inline std::atomic<type_record *> g_types{nullptr};
+
+class type_record final {
+public:
+  explicit type_record(const char *mangled) : _name{demangle(mangled)} {
+    _next = g_types.load(std::memory_order_relaxed);
+    while (!g_types.compare_exchange_weak(_next, this, std::memory_order_release,
+                                          std::memory_order_relaxed)) {
+    }
+  }
+
+  type_record(const type_record &) = delete;
+  type_record &operator=(const type_record &) = delete;
+
+  auto on_create() -> void {
+    _shards[shard_index()]._created.fetch_add(1, std::memory_order_relaxed);
+    auto live = this->live();
+    auto peak = _peak.load(std::memory_order_relaxed);
+    while (live > peak &&
+           !_peak.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+    }
+  }
+
+  auto on_destroy() -> void {
+    _shards[shard_index()]._destroyed.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  auto name() const -> const std::string & {
+    return _name;
+  }
+
+  auto created() const -> int64_t {
+    int64_t n = 0;
+    for (auto &s : _shards) {
+      n += s._created.load(std::memory_order_relaxed);
+    }
+    return n;
+  }
+
+  auto live() const -> int64_t {
+    int64_t n = 0;
+    for (auto &s : _shards) {
+      n += s._created.load(std::memory_order_relaxed);
+      n -= s._destroyed.load(std::memory_order_relaxed);
+    }
+    return n;
+  }
+
+  auto peak() const -> int64_t {
+    return _peak.load(std::memory_order_relaxed);
+  }
+
+  auto next() const -> type_record * {
+    return _next;
+  }
+
+  /// @brief 查找或登记调用栈，登记后不释放
+  auto site_of(void *const *frames, int depth) -> site * {
+    std::string key{reinterpret_cast<const char *>(frames), depth * sizeof(void *)};
+    std::lock_guard<std::mutex> lock{_siteMutex};
+    auto &s = _sites[key];
+    if (!s) {
+      s = std::make_unique<site>();
+      std::copy_n(frames, depth, s->_frames);
+      s->_depth = depth;
+    }
+    return s.get();
+  }
+
+  /// @brief 存活对象最多的 n 个调用栈
+  auto top_sites(std::size_t n) const -> std::vector<const site *> {
+    std::vector<const site *> sites;
+    {
+      std::lock_guard<std::mutex> lock{_siteMutex};
+      for (auto &[key, s] : _sites) {
+        if (s->_live.load(std::memory_order_relaxed) > 0) {
+          sites.push_back(s.get());
+        }
+      }
+    }
+    std::sort(sites.begin(), sites.end(), [](const site *a, const site *b) {
+      return a->_live.load(std::memory_order_relaxed) > b->_live.load(std::memory_order_relaxed);
+    });
+    sites.resize(std::min(n, sites.size()));
+    return sites;
+  }
+
+private:
+  static auto demangle(const char *mangled) -> std::string {
+#ifdef __GNUG__
+    int status = 0;
+    std::unique_ptr<char, decltype(&std::free)> name{
+        abi::__cxa_demangle(mangled, nullptr, nullptr, &status), &std::free};
+    if (status == 0 && name) {
+      return name.get();
+    }
+#endif
+    return mangled;
+  }
+
+  shard _shards[kShards];
+  std::atomic<int64_t> _peak{0};
+  std::string _name;
+  type_record *_next{nullptr};
+  mutable std::mutex _siteMutex;
+  std::unordered_map<std::string, std::unique_ptr<site>> _sites;
+};
+
+/// @brief 每个类型一个，进程退出时不析构，静态对象的析构中仍可释放对象
+template <typename T> auto record_of() -> type_record & {
+  static auto *r = new type_record{typeid(T).name()};
+  return *r;
+}
+
+/// @brief 嵌在 ptr_policy 中，对象拷贝、赋值时不跟随
+struct slot {
+  type_record *_type{nullptr};
+  site *_site{nullptr};
+
+  slot() noexcept = default;
+  slot(const slot &) noexcept {
+  }
+  slot &operator=(const slot &) noexcept {
+    return *this;
+  }
+};
+
+inline auto on_create(slot &s, type_record &r) -> void {
+  s._type = &r;
+  r.on_create();
+#ifdef DSG_SP_TRACK_BACKTRACE
+  void *frames[kFrames + 1];
+  auto depth = ::backtrace(frames, kFrames + 1);
+  if (depth > 1) {
+    s._site = r.site_of(frames + 1, depth - 1); // 跳过本函数
+    s._site->_live.fetch_add(1, std::memory_order_relaxed);
+  }
+#endif
+}
+
+inline auto on_destroy(slot &s) -> void {
+  if (!s._type) {
+    return;
+  }
+  s._type->on_destroy();
+  if (s._site) {
+    s._site->_live.fetch_sub(1, std::memory_order_relaxed);
+  }
+  s._type = nullptr;
+  s._site = nullptr;
+}
+} // namespace detail::track
+
+struct census_entry {
+  std::string _type;
+  int64_t _live;
+  int64_t _peak;
+  int64_t _created;
+};
+
+/// @brief 各类型的统计，按存活数从多到少，与并发的创建、析构之间不保证一致
+inline auto census() -> std::vector<census_entry> {
+  std::vector<census_entry> entries;
+  for (auto *r = detail::track::g_types.load(std::memory_order_acquire); r; r = r->next()) {
+    entries.push_back({r->name(), r->live(), r->peak(), r->created()});
+  }
+  std::stable_sort(entries.begin(), entries.end(),
+                   [](const census_entry &a, const census_entry &b) { return a._live > b._live; });
+  return entries;
+}
+
+/// @brief 单个类型的统计
+template <typename T> auto census_of() -> census_entry {
+  auto &r = detail::track::record_of<T>();
+  return {r.name(), r.live(), r.peak(), r.created()};
+}
+
+/// @brief 输出各类型的统计；记录了调用栈时，每个类型另外列出存活对象最多的调用栈
+/// @param sites 每个类型列出的调用栈数
+inline auto dump_census(std::ostream &os, std::size_t sites = 3) -> void {
+  int64_t total = 0;
+  auto entries = census();
+  for (auto &e : entries) {
+    total += e._live;
+  }
+  os << "ptr census: " << entries.size() << " types, " << total << " live\n";
+  os << "      live      peak   created  type\n";
+  for (auto &e : entries) {
+    char line[64];
+    std::snprintf(line, sizeof(line), "%10lld%10lld%10lld  ", static_cast<long long>(e._live),
+                  static_cast<long long>(e._peak), static_cast<long long>(e._created));
+    os << line << e._type << "\n";
+  }
+#ifdef DSG_SP_TRACK_BACKTRACE
+  for (auto *r = detail::track::g_types.load(std::memory_order_acquire); r; r = r->next()) {
+    for (auto *s : r->top_sites(sites)) {
+      os << r->name() << ": " << s->_live.load(std::memory_order_relaxed) << " live, created at\n";
+      std::unique_ptr<char *, decltype(&std::free)> symbols{
+          ::backtrace_symbols(s->_frames, s->_depth), &std::free};
+      for (int i = 0; i < s->_depth; ++i) {
+        os << "  #" << i << " " << (symbols ? symbols.get()[i] : "?") << "\n";
+      }
+    }
+  }
+#else
+  (void)sites;
+#endif
+}
+} // namespace dsg::sp
@@ -0,0 +1,181 @@
+/**
+ * @file shared_buffer.hpp
+ * @brief 引用计数的共享字节缓冲区，在各层之间传递负载不拷贝
+ *
+ * 1. 计数头部和字节在同一次分配中，头部之后紧跟数据
+ * 2. slice() 得到共享同一块内存的子视图，拷贝 shared_buffer 只增加引用计数
+ * 3. 可隐式转换为 std::span<const uint8_t>，直接传给 IMqttClient::Send 等接口
+ * 4. 字节内容在各视图间共享，写入（writable()）应在交给其他层之前完成
+ *
+ * @code
+ * auto buf = shared_buffer::copy_of(payload);  // 收到消息时拷贝一次
+ * auto header = buf.slice(0, 4);
+ * auto body = buf.slice(4);                      // 与 buf 共享内存
+ * client->Send(topic, body, qos);
+ * @endcode
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <span>
+#include <string_view>
+#include <utility>
+
+#include "ptr.hpp"
+
+namespace dsg::sp {
+namespace detail {
+/// @brief 缓冲区头部，数据紧跟在头部之后
+struct buffer_block final : public ref_policy {
+  struct extra_bytes {
+    std::size_t _n;
+  };
+
+  explicit buffer_block(std::size_t capacity) noexcept : _capacity{capacity} {
+  }
+
+  auto bytes() noexcept -> uint8_t * {
+    return reinterpret_cast<uint8_t *>(this + 1);
+  }
+
+  static auto operator new(std::size_t size, extra_bytes extra) -> void * {
+    return ::operator new(size + extra._n);
+  }
+
+  static auto operator delete(void *p) -> void {
+    ::operator delete(p);
+  }
+
+  /// @brief 构造函数抛异常时调用
+  static auto operator delete(void *p, extra_bytes) -> void {
+    ::operator delete(p);
+  }
+
+  std::size_t _capacity;
+};
+} // namespace detail
+
+class shared_buffer final {
+public:
+  static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+  shared_buffer() noexcept = default;
+  shared_buffer(const shared_buffer &) = default;
+  shared_buffer &operator=(const shared_buffer &) = default;
+
+  shared_buffer(shared_buffer &&b) noexcept
+      : _block{std::move(b._block)}, _data{std::exchange(b._data, nullptr)},
+        _size{std::exchange(b._size, 0)} {
+  }
+
+  shared_buffer &operator=(shared_buffer &&b) noexcept {
+    _block = std::move(b._block);
+    _data = std::exchange(b._data, nullptr);
+    _size = std::exchange(b._size, 0);
+    return *this;
+  }
+
+  /// @brief 分配 size 字节，内容未初始化，由 writable() 填充
+  static auto allocate(std::size_t size) -> shared_buffer {
+    if (size == 0) {
+      return {};
+    }
+    shared_buffer b;
+    b._block = new (detail::buffer_block::extra_bytes{size}) detail::buffer_block{size};
+    b._data = b._block->bytes();
+    b._size = size;
+    return b;
+  }
+
+  static auto copy_of(std::span<const uint8_t> bytes) -> shared_buffer {
+    auto b = allocate(bytes.size());
+    if (!bytes.empty()) {
+      std::memcpy(b._data, bytes.data(), bytes.size());
+    }
+    return b;
+  }
+
+  static auto copy_of(std::string_view text) -> shared_buffer {
+    return copy_of(std::span<const uint8_t>{reinterpret_cast<const uint8_t *>(text.data()),
+                                            text.size()});
+  }
+
+  auto data() const noexcept -> const uint8_t * {
+    return _data;
+  }
+
+  auto size() const noexcept -> std::size_t {
+    return _size;
+  }
+
+  auto empty() const noexcept -> bool {
+    return _size == 0;
+  }
+
+  auto begin() const noexcept -> const uint8_t * {
+    return _data;
+  }
+
+  auto end() const noexcept -> const uint8_t * {
+    return _data + _size;
+  }
+
+  auto operator[](std::size_t i) const noexcept -> uint8_t {
+    return _data[i];
+  }
+
+  /// @brief 共享同一块内存的子视图，越界部分截断
+  /// @param offset 起始偏移，超过 size() 时得到空视图
+  /// @param count 字节数，默认到末尾
+  auto slice(std::size_t offset, std::size_t count = npos) const -> shared_buffer {
+    if (offset >= _size) {
+      return {};
+    }
+    shared_buffer b{*this};
+    b._data += offset;
+    b._size = std::min(count, _size - offset);
+    return b;
+  }
+
+  auto span() const noexcept -> std::span<const uint8_t> {
+    return {_data, _size};
+  }
+
+  operator std::span<const uint8_t>() const noexcept {
+    return span();
+  }
+
+  auto str() const noexcept -> std::string_view {
+    return {reinterpret_cast<const char *>(_data), _size};
+  }
+
+  /// @brief 可写视图，其他视图同样可见写入的内容
+  auto writable() noexcept -> std::span<uint8_t> {
+    return {_data, _size};
+  }
+
+  /// @brief 引用同一块内存的视图数
+  auto use_count() const -> detail::val_t {
+    return _block.use_count();
+  }
+
+  auto unique() const -> bool {
+    return _block.unique();
+  }
+
+  auto reset() -> void {
+    _block.reset();
+    _data = nullptr;
+    _size = 0;
+  }
+
+private:
+  ptr<detail::buffer_block> _block;
+  uint8_t *_data{nullptr};
+  std::size_t _size{0};
+};
+} // namespace dsg::sp
@@ -0,0 +1,266 @@
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <atomic>
+
+#include <def.hpp>
+#include <mqtt.hpp>
+#include <mqtt_broker.hpp>
+
+using namespace dsg;
+
+// mqtt 发送到接收的吞吐和延迟压测
+// 每条消息带发送时间，订阅端订阅全部压测 topic，统计 msgs/s、MB/s 和延迟分位数，输出 csv 或 json
+// 默认使用进程内 broker，--address 指定外部 broker
+//
+// bench_mqtt [--count 100000] [--payload 64] [--qos 0] [--topics 1] [--publishers 1]
+//            [--window 1000] [--dispatch 0] [--address tcp://host:port] [--format csv|json]
+
+namespace {
+struct Options {
+  int _count{100000};     // 每个发送端的消息数
+  std::size_t _payload{64};
+  int _qos{0};
+  int _topics{1};
+  int _publishers{1};
+  int _window{1000};      // 每个发送端已发出未收到的消息上限
+  int _dispatch{0};       // 订阅端回调分发线程数
+  std::string _address{}; // 为空时启动进程内 broker
+  std::string _format{"csv"};
+};
+
+/// @brief 负载头，其余字节填充到 _payload
+struct Header {
+  int64_t _sentNs;
+  uint32_t _publisher;
+  uint32_t _seq;
+};
+
+inline auto NowNs() -> int64_t {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+auto Parse(int argc, char **argv, Options &opts) -> bool {
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string_view key = argv[i];
+    std::string value = argv[i + 1];
+    if (key == "--count") {
+      opts._count = std::stoi(value);
+    } else if (key == "--payload") {
+      opts._payload = std::stoul(value);
+    } else if (key == "--qos") {
+      opts._qos = std::stoi(value);
+    } else if (key == "--topics") {
+      opts._topics = std::stoi(value);
+    } else if (key == "--publishers") {
+      opts._publishers = std::stoi(value);
+    } else if (key == "--window") {
+      opts._window = std::stoi(value);
+    } else if (key == "--dispatch") {
+      opts._dispatch = std::stoi(value);
+    } else if (key == "--address") {
+      opts._address = value;
+    } else if (key == "--format") {
+      opts._format = value;
+    } else {
+      return false;
+    }
+  }
+  opts._payload = std::max(opts._payload, sizeof(Header));
+  return argc % 2 == 1 && opts._qos >= 0 && opts._qos <= 2 && opts._count > 0 &&
+         opts._topics > 0 && opts._publishers > 0 && opts._window > 0;
+}
+
+template <typename F> auto WaitFor(F &&pred, int timeoutMs) -> bool {
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+  while (!pred()) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return true;
+}
+
+auto Connect(const Options &opts, const std::string &address, const std::string &id,
+             int dispatch) -> interface_ptr<Mqtt> {
+  auto connected = std::make_shared<std::atomic<bool>>(false);
+  auto mqtt = Mqtt::Request(Mqtt::Config{
+      ._address = address,
+      ._clientID = id,
+      ._maxInflight = opts._window,
+      ._dispatchThreads = dispatch,
+      ._dispatchQueueSize = static_cast<std::size_t>(opts._window) * opts._publishers * 2,
+      ._connectCallback = [connected](bool ok, std::string_view) { *connected = ok; },
+  });
+  mqtt->Connect();
+  if (!WaitFor([&] { return connected->load(); }, 10000)) {
+    DSG_ERROR("connect " << address << " timeout, client:" << id);
+    return {};
+  }
+  return mqtt;
+}
+
+auto Percentile(const std::vector<int64_t> &sorted, double p) -> int64_t {
+  if (sorted.empty()) {
+    return 0;
+  }
+  auto i = static_cast<std::size_t>(p / 100 * static_cast<double>(sorted.size() - 1) + 0.5);
+  return sorted[std::min(i, sorted.size() - 1)];
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  Options opts;
+  if (!Parse(argc, argv, opts)) {
+    std::cerr << "usage: bench_mqtt [--count n] [--payload bytes] [--qos 0|1|2] [--topics n]\n"
+                 "                  [--publishers n] [--window n] [--dispatch n]\n"
+                 "                  [--address tcp://host:port] [--format csv|json]\n";
+    return 1;
+  }
+
+  interface_ptr<MqttBroker> broker;
+  auto address = opts._address;
+  if (address.empty()) {
+    broker = MqttBroker::Request({});
+    if (!broker->Start()) {
+      return 1;
+    }
+    address = broker->Address();
+  }
+
+  const auto qos = Mqtt::ToQos(opts._qos);
+  std::vector<Mqtt::Topic> topics;
+  for (int i = 0; i < opts._topics; ++i) {
+    topics.push_back({DSG_STR("bench/" << i), qos});
+  }
+
+  const auto total = static_cast<std::size_t>(opts._count) * opts._publishers;
+  std::vector<int64_t> latencies(total);
+  std::atomic<std::size_t> received{0};
+  std::atomic<int64_t> lastNs{0};
+  auto acked = std::make_unique<std::atomic<int64_t>[]>(opts._publishers);
+
+  auto sub = Connect(opts, address, "bench-sub", opts._dispatch);
+  if (!sub) {
+    return 1;
+  }
+  std::atomic<int> subscribed{0};
+  for (const auto &topic : topics) {
+    sub->Subscribe(topic, [&](Mqtt::TopicView, std::span<uint8_t> payload) {
+      if (payload.size() < sizeof(Header)) {
+        return;
+      }
+      Header h;
+      std::memcpy(&h, payload.data(), sizeof(h));
+      auto now = NowNs();
+      auto i = received.fetch_add(1, std::memory_order_relaxed);
+      if (i < total) {
+        latencies[i] = now - h._sentNs;
+      }
+      lastNs.store(now, std::memory_order_relaxed);
+      if (h._publisher < static_cast<uint32_t>(opts._publishers)) {
+        acked[h._publisher].fetch_add(1, std::memory_order_release);
+      }
+    });
+  }
+  // 用一条探测消息确认订阅已生效
+  auto probe = Connect(opts, address, "bench-probe", 0);
+  if (!probe) {
+    return 1;
+  }
+  WaitFor(
+      [&] {
+        Header h{NowNs(), static_cast<uint32_t>(-1), 0};
+        probe->Send(topics.back(), std::vector<uint8_t>(reinterpret_cast<uint8_t *>(&h),
+                                                         reinterpret_cast<uint8_t *>(&h + 1)));
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        return received.load() > 0;
+      },
+      10000);
+  received = 0;
+
+  std::vector<interface_ptr<Mqtt>> pubs;
+  for (int p = 0; p < opts._publishers; ++p) {
+    auto pub = Connect(opts, address, DSG_STR("bench-pub-" << p), 0);
+    if (!pub) {
+      return 1;
+    }
+    pubs.push_back(pub);
+  }
+
+  std::atomic<uint64_t> sendErrors{0};
+  std::vector<std::thread> threads;
+  const auto startNs = NowNs();
+  for (int p = 0; p < opts._publishers; ++p) {
+    threads.emplace_back([&, p] {
+      std::vector<uint8_t> payload(opts._payload, 0x5a);
+      auto &pub = pubs[p];
+      for (int seq = 0; seq < opts._count; ++seq) {
+        // 在途消息达到窗口时等待订阅端收到
+        while (seq - acked[p].load(std::memory_order_acquire) >= opts._window) {
+          std::this_thread::yield();
+        }
+        Header h{NowNs(), static_cast<uint32_t>(p), static_cast<uint32_t>(seq)};
+        std::memcpy(payload.data(), &h, sizeof(h));
+        while (!pub->Send(topics[(seq + p) % topics.size()], payload)) {
+          sendErrors.fetch_add(1, std::memory_order_relaxed);
+          std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+      }
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+
+  // qos0 可能丢消息，连续 3 秒没有新消息就结束
+  auto last = received.load();
+  while (received.load() < total) {
+    std::this_thread::sleep_for(std::chrono::seconds(3));
+    if (received.load() == last) {
+      break;
+    }
+    last = received.load();
+  }
+
+  const auto count = std::min(received.load(), total);
+  const auto seconds = static_cast<double>(std::max(lastNs.load(), startNs + 1) - startNs) / 1e9;
+  latencies.resize(count);
+  std::sort(latencies.begin(), latencies.end());
+  const auto rate = static_cast<double>(count) / seconds;
+  const auto mbps = rate * static_cast<double>(opts._payload) / 1e6;
+  auto us = [&](double p) { return Percentile(latencies, p) / 1000; };
+
+  if (opts._format == "json") {
+    std::cout << "{\"payload\":" << opts._payload << ",\"qos\":" << opts._qos
+              << ",\"topics\":" << opts._topics << ",\"publishers\":" << opts._publishers
+              << ",\"window\":" << opts._window << ",\"sent\":" << total
+              << ",\"received\":" << count << ",\"seconds\":" << seconds
+              << ",\"msgs_per_sec\":" << static_cast<int64_t>(rate) << ",\"mb_per_sec\":" << mbps
+              << ",\"latency_us\":{\"p50\":" << us(50) << ",\"p90\":" << us(90)
+              << ",\"p99\":" << us(99) << ",\"p999\":" << us(99.9) << ",\"max\":" << us(100)
+              << "},\"send_retries\":" << sendErrors << "}\n";
+  } else {
+    std::cout << "payload,qos,topics,publishers,window,sent,received,seconds,msgs_per_sec,"
+                 "mb_per_sec,p50_us,p90_us,p99_us,p999_us,max_us,send_retries\n"
+              << opts._payload << "," << opts._qos << "," << opts._topics << ","
+              << opts._publishers << "," << opts._window << "," << total << "," << count << ","
+              << seconds << "," << static_cast<int64_t>(rate) << "," << mbps << "," << us(50)
+              << "," << us(90) << "," << us(99) << "," << us(99.9) << "," << us(100) << ","
+              << sendErrors << "\n";
+  }
+
+  for (auto &pub : pubs) {
+    pub->Disconnect();
+  }
+  probe->Disconnect();
+  sub->Disconnect();
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  if (broker) {
+    DSG_LOG(broker->GetStats().to_string());
+  }
+  return 0;
+}
@@ -0,0 +1,361 @@
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <def.hpp>
+#include <ptr.hpp>
+
+using namespace dsg;
+
+// ptr 与 std::shared_ptr、boost 风格 intrusive_ptr 的开销对比，输出 csv 或 json 便于回归跟踪
+// copy：拷贝+析构；move：移动；make：创建+释放；handoff：一个线程创建、另一个线程释放；
+// contended：N 个线程同时拷贝同一个对象；interface_call / interface_copy：经接口指针调用虚函数
+// 结果为 ns/op，contended 为每个线程的 ns/op；unsafe_ref_policy 不参与 contended
+//
+// bench_ptr [--count 10000000] [--threads 4] [--format csv|json]
+
+namespace {
+struct Options {
+  int _count{10000000};
+  int _threads{4};
+  std::string _format{"csv"};
+};
+
+struct Result {
+  std::string _case;
+  std::string _impl;
+  int _threads;
+  double _ns;
+};
+
+struct IValue {
+  virtual ~IValue() = default;
+  virtual auto Value() const -> uint64_t = 0;
+};
+
+template <typename Policy> struct Object : public Policy {
+  uint64_t _v{1};
+};
+
+template <typename Wrapper> struct Impl : public Wrapper {
+  auto Value() const -> uint64_t override {
+    return _v;
+  }
+  uint64_t _v{1};
+};
+
+struct Plain {
+  uint64_t _v{1};
+};
+
+/// @brief boost::intrusive_ref_counter 的等价实现，本仓库不依赖 boost
+template <typename D> class intrusive_counter {
+public:
+  friend auto intrusive_ptr_add_ref(const D *p) -> void {
+    p->_refs.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  friend auto intrusive_ptr_release(const D *p) -> void {
+    if (p->_refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete p;
+    }
+  }
+
+private:
+  mutable std::atomic<uint32_t> _refs{0};
+};
+
+/// @brief boost::intrusive_ptr 的等价实现
+template <typename T> class intrusive_ptr {
+public:
+  intrusive_ptr() noexcept = default;
+  explicit intrusive_ptr(T *p) noexcept : _p{p} {
+    if (_p) {
+      intrusive_ptr_add_ref(_p);
+    }
+  }
+  intrusive_ptr(const intrusive_ptr &r) noexcept : intrusive_ptr{r._p} {
+  }
+  intrusive_ptr(intrusive_ptr &&r) noexcept : _p{std::exchange(r._p, nullptr)} {
+  }
+  ~intrusive_ptr() {
+    if (_p) {
+      intrusive_ptr_release(_p);
+    }
+  }
+  intrusive_ptr &operator=(const intrusive_ptr &r) noexcept {
+    intrusive_ptr{r}.swap(*this);
+    return *this;
+  }
+  intrusive_ptr &operator=(intrusive_ptr &&r) noexcept {
+    intrusive_ptr{std::move(r)}.swap(*this);
+    return *this;
+  }
+  auto swap(intrusive_ptr &r) noexcept -> void {
+    std::swap(_p, r._p);
+  }
+  auto operator->() const noexcept -> T * {
+    return _p;
+  }
+
+private:
+  T *_p{nullptr};
+};
+
+struct IntrusiveObject : public intrusive_counter<IntrusiveObject> {
+  uint64_t _v{1};
+};
+
+struct IIntrusiveValue : public intrusive_counter<IIntrusiveValue> {
+  virtual ~IIntrusiveValue() = default;
+  virtual auto Value() const -> uint64_t = 0;
+};
+
+struct IntrusiveImpl : public IIntrusiveValue {
+  auto Value() const -> uint64_t override {
+    return _v;
+  }
+  uint64_t _v{1};
+};
+
+struct SafeRef {
+  static constexpr const char *kName = "ref_policy";
+  static constexpr bool kThreadSafe = true;
+  static auto make() {
+    return make_ptr<Object<ref_policy>>();
+  }
+  static auto make_interface() -> interface_ptr<IValue> {
+    return make_ptr<Impl<interface_wrapper<IValue>>>();
+  }
+};
+
+struct UnsafeRef {
+  static constexpr const char *kName = "unsafe_ref_policy";
+  static constexpr bool kThreadSafe = false;
+  static auto make() {
+    return make_ptr<Object<unsafe_ref_policy>>();
+  }
+  static auto make_interface() -> unsafe_interface_ptr<IValue> {
+    return make_ptr<Impl<unsafe_interface_wrapper<IValue>>>();
+  }
+};
+
+struct SharedPtr {
+  static constexpr const char *kName = "std::shared_ptr";
+  static constexpr bool kThreadSafe = true;
+  static auto make() {
+    return std::make_shared<Plain>();
+  }
+  static auto make_interface() -> std::shared_ptr<IValue> {
+    return std::make_shared<Impl<IValue>>();
+  }
+};
+
+struct IntrusivePtr {
+  static constexpr const char *kName = "intrusive_ptr";
+  static constexpr bool kThreadSafe = true;
+  static auto make() {
+    return intrusive_ptr<IntrusiveObject>{new IntrusiveObject};
+  }
+  static auto make_interface() -> intrusive_ptr<IIntrusiveValue> {
+    return intrusive_ptr<IIntrusiveValue>{new IntrusiveImpl};
+  }
+};
+
+template <typename F> auto NsPerOp(int count, F &&f) -> double {
+  auto start = std::chrono::steady_clock::now();
+  f();
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start)
+                .count();
+  return static_cast<double>(ns) / count;
+}
+
+template <typename V> auto Copy(int count) -> double {
+  auto p = V::make();
+  volatile uint64_t sink = 0;
+  return NsPerOp(count, [&] {
+    for (int i = 0; i < count; ++i) {
+      auto c = p;
+      sink = sink + c->_v;
+    }
+  });
+}
+
+template <typename V> auto Move(int count) -> double {
+  auto a = V::make();
+  volatile uint64_t sink = 0;
+  return NsPerOp(count, [&] {
+    for (int i = 0; i < count; ++i) {
+      auto b = std::move(a);
+      sink = sink + b->_v;
+      a = std::move(b);
+    }
+  });
+}
+
+template <typename V> auto Make(int count) -> double {
+  volatile uint64_t sink = 0;
+  return NsPerOp(count, [&] {
+    for (int i = 0; i < count; ++i) {
+      auto p = V::make();
+      sink = sink + p->_v;
+    }
+  });
+}
+
+template <typename V> auto Handoff(int count) -> double {
+  using P = decltype(V::make());
+  constexpr std::size_t kBatch = 256;
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::vector<P> queue;
+  bool done = false;
+
+  return NsPerOp(count, [&] {
+    std::thread consumer{[&] {
+      std::vector<P> local;
+      while (true) {
+        {
+          std::unique_lock<std::mutex> lock{mutex};
+          cv.wait(lock, [&] { return !queue.empty() || done; });
+          if (queue.empty()) {
+            break;
+          }
+          local.swap(queue);
+        }
+        local.clear();
+      }
+    }};
+
+    std::vector<P> batch;
+    for (int i = 0; i < count; ++i) {
+      batch.push_back(V::make());
+      if (batch.size() == kBatch || i == count - 1) {
+        std::lock_guard<std::mutex> lock{mutex};
+        for (auto &p : batch) {
+          queue.push_back(std::move(p));
+        }
+        batch.clear();
+        cv.notify_one();
+      }
+    }
+    {
+      std::lock_guard<std::mutex> lock{mutex};
+      done = true;
+    }
+    cv.notify_one();
+    consumer.join();
+  });
+}
+
+template <typename V> auto Contended(int count, int threads) -> double {
+  auto p = V::make();
+  return NsPerOp(count, [&] {
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+      workers.emplace_back([&p, count] {
+        volatile uint64_t sink = 0;
+        for (int i = 0; i < count; ++i) {
+          auto c = p;
+          sink = sink + c->_v;
+        }
+      });
+    }
+    for (auto &w : workers) {
+      w.join();
+    }
+  });
+}
+
+template <typename V> auto InterfaceCall(int count) -> double {
+  auto p = V::make_interface();
+  volatile uint64_t sink = 0;
+  return NsPerOp(count, [&] {
+    for (int i = 0; i < count; ++i) {
+      sink = sink + p->Value();
+    }
+  });
+}
+
+template <typename V> auto InterfaceCopy(int count) -> double {
+  auto p = V::make_interface();
+  volatile uint64_t sink = 0;
+  return NsPerOp(count, [&] {
+    for (int i = 0; i < count; ++i) {
+      auto c = p;
+      sink = sink + c->Value();
+    }
+  });
+}
+
+template <typename V> auto Run(const Options &opts, std::vector<Result> &results) -> void {
+  auto add = [&](const char *name, int threads, double ns) {
+    results.push_back({name, V::kName, threads, ns});
+  };
+  const int count = opts._count;
+  add("copy", 1, Copy<V>(count));
+  add("move", 1, Move<V>(count));
+  add("make", 1, Make<V>(count / 4));
+  add("handoff", 2, Handoff<V>(count / 4));
+  if constexpr (V::kThreadSafe) {
+    add("contended", opts._threads, Contended<V>(count / opts._threads, opts._threads));
+  }
+  add("interface_call", 1, InterfaceCall<V>(count));
+  add("interface_copy", 1, InterfaceCopy<V>(count));
+}
+
+auto Parse(int argc, char **argv, Options &opts) -> bool {
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string_view key = argv[i];
+    std::string value = argv[i + 1];
+    if (key == "--count") {
+      opts._count = std::stoi(value);
+    } else if (key == "--threads") {
+      opts._threads = std::stoi(value);
+    } else if (key == "--format") {
+      opts._format = value;
+    } else {
+      return false;
+    }
+  }
+  return argc % 2 == 1 && opts._count >= 4 && opts._threads > 0;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  Options opts;
+  if (!Parse(argc, argv, opts)) {
+    std::cerr << "usage: bench_ptr [--count n] [--threads n] [--format csv|json]\n";
+    return 1;
+  }
+
+  std::vector<Result> results;
+  Run<SafeRef>(opts, results);
+  Run<UnsafeRef>(opts, results);
+  Run<SharedPtr>(opts, results);
+  Run<IntrusivePtr>(opts, results);
+
+  if (opts._format == "json") {
+    std::cout << "{\"count\":" << opts._count << ",\"threads\":" << opts._threads
+              << ",\"hardware_threads\":" << std::thread::hardware_concurrency()
+              << ",\"results\":[";
+    for (std::size_t i = 0; i < results.size(); ++i) {
+      auto &r = results[i];
+      std::cout << (i ? "," : "") << "{\"case\":\"" << r._case << "\",\"impl\":\"" << r._impl
+                << "\",\"threads\":" << r._threads << ",\"ns_per_op\":" << r._ns << "}";
+    }
+    std::cout << "]}\n";
+  } else {
+    std::cout << "case,impl,threads,ns_per_op\n";
+    for (auto &r : results) {
+      std::cout << r._case << "," << r._impl << "," << r._threads << "," << r._ns << "\n";
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,133 @@
+#include <iostream>
+#include <chrono>
+
+#include <def.hpp>
+#include <codec.hpp>
+
+using namespace dsg;
+
+// 二进制编码与手写 json 对比：检查编解码结果一致，输出负载大小和每次编码/解码耗时，
+// 并与目标（大小、编码耗时都降到 json 的 1/10）比较；耗时只在 Release 构建下有意义
+// 用法：sample_codec [次数]
+
+namespace {
+enum class Status : uint8_t { eIdle, eRunning, eFault };
+
+struct Location {
+  double _lat{0};
+  double _lon{0};
+};
+
+struct Telemetry {
+  uint32_t _device{0};
+  uint64_t _seq{0};
+  int64_t _ts{0}; // ms
+  float _temperature{0};
+  float _humidity{0};
+  uint8_t _battery{0};
+  Status _status{Status::eIdle};
+  bool _online{false};
+  int32_t _rssi{0};
+  std::string_view _name{};
+  Location _location{};
+};
+} // namespace
+
+template <> struct dsg::codec::schema<Location> {
+  static constexpr auto fields = std::tuple{field(&Location::_lat), field(&Location::_lon)};
+};
+
+template <> struct dsg::codec::schema<Telemetry> {
+  static constexpr auto fields =
+      std::tuple{field(&Telemetry::_device),   field(&Telemetry::_seq),
+                 field(&Telemetry::_ts),       field(&Telemetry::_temperature),
+                 field(&Telemetry::_humidity), field(&Telemetry::_battery),
+                 field(&Telemetry::_status),   field(&Telemetry::_online),
+                 field(&Telemetry::_rssi),     field(&Telemetry::_name),
+                 field(&Telemetry::_location)};
+};
+
+namespace {
+auto Json(const Telemetry &t) -> std::string {
+  return DSG_STR("{\"device\":" << t._device << ",\"seq\":" << t._seq << ",\"ts\":" << t._ts
+                                << ",\"temperature\":" << t._temperature
+                                << ",\"humidity\":" << t._humidity
+                                << ",\"battery\":" << +t._battery
+                                << ",\"status\":" << static_cast<int>(t._status)
+                                << ",\"online\":" << (t._online ? "true" : "false")
+                                << ",\"rssi\":" << t._rssi << ",\"name\":\"" << t._name
+                                << "\",\"location\":{\"lat\":" << t._location._lat
+                                << ",\"lon\":" << t._location._lon << "}}");
+}
+
+auto Equal(const Telemetry &a, const Telemetry &b) -> bool {
+  return a._device == b._device && a._seq == b._seq && a._ts == b._ts &&
+         a._temperature == b._temperature && a._humidity == b._humidity &&
+         a._battery == b._battery && a._status == b._status && a._online == b._online &&
+         a._rssi == b._rssi && a._name == b._name && a._location._lat == b._location._lat &&
+         a._location._lon == b._location._lon;
+}
+
+constexpr double kTargetRatio = 10;
+
+template <typename F> auto NsPerOp(int count, F &&f) -> double {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < count; ++i) {
+    f(i);
+  }
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start)
+                .count();
+  return static_cast<double>(ns) / count;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  const int count = argc > 1 ? std::stoi(argv[1]) : 1000000;
+
+  Telemetry t{._device = 1024,
+              ._seq = 123456,
+              ._ts = CurTimestamp(),
+              ._temperature = 23.5f,
+              ._humidity = 61.25f,
+              ._battery = 87,
+              ._status = Status::eRunning,
+              ._online = true,
+              ._rssi = -67,
+              ._name = "gateway-01",
+              ._location = {31.2304, 121.4737}};
+
+  // 编解码一致、截断数据解码失败
+  std::vector<uint8_t> buf;
+  codec::Encode(t, buf);
+  Telemetry decoded;
+  bool ok = codec::Decode(buf, decoded) && Equal(t, decoded) &&
+            !codec::Decode(std::span(buf).first(buf.size() - 1), decoded);
+  DSG_LOG((ok ? "[ OK ] " : "[FAIL] ") << "round trip");
+
+  std::size_t sink = 0;
+  auto jsonNs = NsPerOp(count, [&](int i) {
+    t._seq = static_cast<uint64_t>(i);
+    sink += Json(t).size();
+  });
+  auto encodeNs = NsPerOp(count, [&](int i) {
+    t._seq = static_cast<uint64_t>(i);
+    sink += codec::Encode(t, buf);
+  });
+  auto decodeNs = NsPerOp(count, [&](int) {
+    sink += codec::Decode(buf, decoded) ? decoded._name.size() : 0;
+  });
+
+  const auto jsonSize = Json(t).size();
+  DSG_LOG("json   size:" << jsonSize << "B, encode:" << jsonNs << "ns");
+  DSG_LOG("codec  size:" << buf.size() << "B, encode:" << encodeNs << "ns, decode:" << decodeNs
+                         << "ns");
+  // 目标是大小和编码耗时都降一个数量级；与机器和构建类型有关，不计入检查结果
+  const auto sizeRatio = static_cast<double>(jsonSize) / static_cast<double>(buf.size());
+  const auto encodeRatio = jsonNs / encodeNs;
+  auto vsTarget = [](double ratio) { return ratio >= kTargetRatio ? "met" : "below target"; };
+  DSG_LOG("ratio  size:" << sizeRatio << "x (" << vsTarget(sizeRatio) << "), encode:"
+                         << encodeRatio << "x (" << vsTarget(encodeRatio) << "), target:"
+                         << kTargetRatio << "x (" << sink << ")");
+  return ok ? 0 : 1;
+}
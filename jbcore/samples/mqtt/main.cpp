@@ -17,38 +17,40 @@ int main(int, char **) {
       ._address = "tcp://192.168.146.125:1883",
       // ._address = "tcp://test.mosquitto.org:1883",
       ._clientID = "ExampleClientPub",
+      ._dispatchThreads = 1,
+      ._schedule = true,
       ._connectLostCallback =
-          [](const std::string &msg) {
+          [](std::string_view msg) {
             DSG_LOG("connect lost, " << msg);
           },
       ._messageArrivedCallback =
-          [](const Mqtt ::Topic &topic, std::span<uint8_t> msg) {
+          [](Mqtt::TopicView topic, std::span<uint8_t> msg) {
             DSG_LOG("message arrived " << topic.to_string() << " "
                                        << std::string(msg.begin(), msg.end()));
           },
       ._deliveryCompleteCallback =
-          [](const std::string &) {
+          [](std::string_view) {
 
           },
       ._connectCallback =
-          [](bool connected, const std::string &msg) {
+          [](bool connected, std::string_view msg) {
             DSG_LOG("connect " << std::boolalpha << connected << " " << msg);
           },
       ._disconnectCallback =
-          [&disconnect](bool disconnected, const std::string &msg) {
+          [&disconnect](bool disconnected, std::string_view msg) {
             DSG_LOG("disconnect " << std::boolalpha << disconnected << " " << msg);
             disconnect.store(disconnected);
           },
       ._sendCallback =
-          [](bool success, const Mqtt::Topic &topic, const std::string &msg) {
+          [](bool success, Mqtt::TopicView topic, std::string_view msg) {
             DSG_LOG("send " << topic.to_string() << " " << std::boolalpha << success << " " << msg);
           },
       ._subscribeCallback =
-          [](bool success, const Mqtt::Topic &, const std::string &msg) {
+          [](bool success, Mqtt::TopicView, std::string_view msg) {
             DSG_LOG("subscribe " << std::boolalpha << success << " " << msg);
           },
       ._unsubscribeCallback =
-          [](bool success, const Mqtt::Topic &, const std::string &msg) {
+          [](bool success, Mqtt::TopicView, std::string_view msg) {
             DSG_LOG("unsubscribe " << std::boolalpha << success << " " << msg);
           }});
   DSG_LOG("Usage:\n"
@@ -57,7 +59,8 @@ int main(int, char **) {
           "\tdc # 断开连接\n"
           "\tsub <topic> <qos> # 订阅 qos 0 1 2\n"
           "\tunsub <topic> <qos> # 取消订阅 qos 0 1 2\n"
-          "\tsend <topic> <qos> <msg># 发送消息 qos 0 1 2\n");
+          "\tsend <topic> <qos> <msg># 发送消息 qos 0 1 2\n"
+          "\tstats # 回调分发、发送调度统计和连接指标\n");
   std::string input;
   std::stringstream ss;
   std::string item;
@@ -83,6 +86,10 @@ int main(int, char **) {
         pubMqtt->Connect();
       } else if (cmd == "dc") {
         pubMqtt->Disconnect();
+      } else if (cmd == "stats") {
+        DSG_LOG(pubMqtt->GetDispatchStats().to_string());
+        DSG_LOG(pubMqtt->GetScheduleStats().to_string());
+        DSG_LOG(pubMqtt->GetMetrics().to_string());
       } else if (cmd == "send") {
         if (tokens.size() == 4) {
           const auto &topic = tokens[1];
@@ -0,0 +1,175 @@
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <def.hpp>
+#include <mqtt.hpp>
+#include <mqtt_broker.hpp>
+
+using namespace dsg;
+
+// 检查稳态下每条收发消息的 operator new 次数应为 0
+// 替换全局 operator new 计数，broker 放在子进程中运行不计入；paho 内部使用 malloc，不在统计范围
+// 依次检查回调直接执行、启用分发线程、再启用发送调度三种模式，收发两端同样配置，发送端设置发送回调
+// 用法：sample_mqtt_alloc [消息数]
+
+namespace {
+std::atomic<bool> g_counting{false};
+std::atomic<uint64_t> g_allocs{0};
+} // namespace
+
+auto operator new(std::size_t size) -> void * {
+  if (g_counting.load(std::memory_order_relaxed)) {
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+  }
+  if (auto p = std::malloc(size ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+auto operator delete(void *p) noexcept -> void {
+  std::free(p);
+}
+
+auto operator delete(void *p, std::size_t) noexcept -> void {
+  std::free(p);
+}
+
+namespace {
+// 长度超过 std::string 短字符串优化，拷贝 topic 名会分配内存
+constexpr const char *kTopic = "alloc/check/a-topic-name-longer-than-sso";
+constexpr int kWindow = 100;
+
+template <typename F> auto WaitFor(F &&pred, int timeoutMs = 10000) -> bool {
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+  while (!pred()) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return true;
+}
+
+/// @brief 子进程运行 broker，通过管道返回地址
+auto StartBroker(pid_t &pid) -> std::string {
+  int fds[2];
+  if (pipe(fds) != 0) {
+    return {};
+  }
+  pid = fork();
+  if (pid == 0) {
+    close(fds[0]);
+    auto broker = MqttBroker::Request({});
+    auto address = broker->Start() ? broker->Address() : std::string{};
+    write(fds[1], address.data(), address.size());
+    close(fds[1]);
+    while (true) {
+      pause();
+    }
+  }
+  close(fds[1]);
+  char buf[256];
+  auto n = pid > 0 ? read(fds[0], buf, sizeof(buf)) : -1;
+  close(fds[0]);
+  return n > 0 ? std::string(buf, static_cast<std::size_t>(n)) : std::string{};
+}
+
+struct Counters {
+  std::atomic<int> _connected{0};
+  std::atomic<int64_t> _received{0};
+  std::atomic<int64_t> _acked{0};
+};
+
+/// @brief 收发 count 条消息，返回是否全部收到
+auto Run(Mqtt &pub, const Mqtt::Topic &topic, std::span<const uint8_t> payload,
+         Counters &counters, int64_t count) -> bool {
+  const auto start = counters._received.load();
+  for (int64_t i = 0; i < count; ++i) {
+    while (i - (counters._received.load() - start) >= kWindow) {
+      std::this_thread::yield();
+    }
+    while (!pub.Send(topic, payload, {})) {
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+  }
+  return WaitFor([&] { return counters._received.load() - start >= count; }) &&
+         WaitFor([&] { return counters._acked.load() - start >= count; });
+}
+
+auto Check(const std::string &address, int dispatchThreads, bool schedule, int64_t count)
+    -> bool {
+  Counters counters;
+  auto config = [&](const char *id) {
+    return Mqtt::Config{
+        ._address = address,
+        ._clientID = id,
+        ._dispatchThreads = dispatchThreads,
+        ._schedule = schedule,
+        ._connectCallback = [&counters](bool ok, std::string_view) { counters._connected += ok; },
+        ._sendCallback = [&counters](bool ok, Mqtt::TopicView,
+                                     std::string_view) { counters._acked += ok; },
+    };
+  };
+  auto sub = Mqtt::Request(config("alloc-sub"));
+  auto pub = Mqtt::Request(config("alloc-pub"));
+  sub->Connect();
+  pub->Connect();
+  if (!WaitFor([&] { return counters._connected == 2; })) {
+    DSG_ERROR("connect " << address << " timeout");
+    return false;
+  }
+  sub->Subscribe({kTopic, Mqtt::Qos::e1}, [&counters](Mqtt::TopicView topic,
+                                                      std::span<uint8_t>) {
+    counters._received += topic._name == kTopic;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  const Mqtt::Topic topic{kTopic, Mqtt::Qos::e1};
+  const std::vector<uint8_t> payload(64, 0x5a);
+  // 预热：线程局部缓冲区、消息对象空闲链表等在首次使用时分配
+  auto ok = Run(*pub, topic, payload, counters, count / 10 + kWindow);
+  g_allocs = 0;
+  g_counting = true;
+  ok = Run(*pub, topic, payload, counters, count) && ok;
+  g_counting = false;
+  const auto allocs = g_allocs.load();
+
+  DSG_LOG((ok && allocs == 0 ? "[ OK ] " : "[FAIL] ")
+          << "dispatch threads:" << dispatchThreads << ", schedule:" << schedule
+          << ", messages:" << count
+          << ", operator new:" << allocs << " ("
+          << static_cast<double>(allocs) / static_cast<double>(count) << "/msg)");
+  pub->Disconnect();
+  sub->Disconnect();
+  WaitFor([&] { return !pub->IsConnected() && !sub->IsConnected(); });
+  return ok && allocs == 0;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  const int64_t count = argc > 1 ? std::stoll(argv[1]) : 20000;
+
+  pid_t broker = -1;
+  const auto address = StartBroker(broker);
+  if (address.empty()) {
+    DSG_ERROR("start broker failed");
+    return 1;
+  }
+
+  bool ok = Check(address, 0, false, count);
+  ok = Check(address, 1, false, count) && ok;
+  ok = Check(address, 1, true, count) && ok;
+
+  kill(broker, SIGTERM);
+  waitpid(broker, nullptr, 0);
+  return ok ? 0 : 1;
+}
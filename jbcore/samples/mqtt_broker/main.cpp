@@ -0,0 +1,423 @@
+#include <iostream>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <map>
+#include <mutex>
+
+#include <def.hpp>
+#include <mqtt.hpp>
+#include <mqtt_broker.hpp>
+
+using namespace dsg;
+
+// 使用进程内 broker 做回环测试，不需要网络：
+// 检查 qos 0/1/2、通配符、保留消息、本地最近值缓存、发送调度、压缩、多线程分发和 broker 重启后的自动重连，然后测一次发送到接收的吞吐和延迟
+// 用法：sample_mqtt_broker [消息数] [负载字节数] [qos]
+
+namespace {
+inline auto NowNs() -> int64_t {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+inline auto Bytes(std::string_view s) -> std::span<const uint8_t> {
+  return {reinterpret_cast<const uint8_t *>(s.data()), s.size()};
+}
+
+template <typename F> auto WaitFor(F &&pred, int timeoutMs = 5000) -> bool {
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+  while (!pred()) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return true;
+}
+
+auto Check(bool ok, const char *what) -> bool {
+  DSG_LOG((ok ? "[ OK ] " : "[FAIL] ") << what);
+  return ok;
+}
+
+struct Client {
+  std::atomic<bool> _connected{false};
+  std::atomic<int> _lost{0};
+  interface_ptr<Mqtt> _mqtt;
+
+  Client(const std::string &address, const std::string &id, bool reconnect = false,
+         std::size_t lastValues = 0) {
+    _mqtt = Mqtt::Request(Mqtt::Config{
+        ._address = address,
+        ._clientID = id,
+        ._automaticReconnect = reconnect,
+        ._minRetryInterval = 1,
+        ._maxRetryInterval = 1,
+        ._lastValueTopics = lastValues,
+        ._connectLostCallback = [this](std::string_view) { ++_lost, _connected = false; },
+        ._connectCallback = [this](bool ok, std::string_view) { _connected = ok; },
+        ._disconnectCallback = [this](bool ok, std::string_view) { _connected = !ok; },
+    });
+  }
+
+  auto Connect() -> bool {
+    _mqtt->Connect();
+    return WaitFor([this] { return _connected.load(); });
+  }
+};
+} // namespace
+
+int main(int argc, char **argv) {
+  const int count = argc > 1 ? std::stoi(argv[1]) : 100000;
+  const std::size_t size = argc > 2 ? std::stoul(argv[2]) : 64;
+  const auto qos = Mqtt::ToQos(argc > 3 ? std::stoi(argv[3]) : 0);
+
+  auto broker = MqttBroker::Request({});
+  if (!broker->Start()) {
+    return 1;
+  }
+  const auto address = broker->Address();
+  bool ok = true;
+
+  Client pub{address, "loopback-pub"};
+  Client sub{address, "loopback-sub", true};
+  ok = Check(pub.Connect() && sub.Connect(), "connect") && ok;
+
+  // qos 0/1/2 和通配符
+  std::atomic<int> received[3]{};
+  sub._mqtt->Subscribe({"loop/+/data", Mqtt::Qos::e2},
+                       [&](Mqtt::TopicView topic, std::span<uint8_t>) {
+                         ++received[Mqtt::FromQos(topic._qos)];
+                       });
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  for (int q = 0; q < 3; ++q) {
+    pub._mqtt->Send({DSG_STR("loop/" << q << "/data"), Mqtt::ToQos(q)}, std::string("hello"));
+  }
+  pub._mqtt->Send({"loop/x/other", Mqtt::Qos::e0}, std::string("not matched"));
+  ok = Check(WaitFor([&] { return received[0] + received[1] + received[2] == 3; }) &&
+                 received[0] == 1 && received[1] == 1 && received[2] == 1,
+             "qos 0/1/2 with wildcard") &&
+       ok;
+
+  // 保留消息，之后订阅的客户端也能收到
+  pub._mqtt->Send({"retain/a", Mqtt::Qos::e1}, Bytes("a"), {._retained = true});
+  pub._mqtt->Send({"retain/b", Mqtt::Qos::e1}, Bytes("b"), {._retained = true});
+  pub._mqtt->Send({"retain/b", Mqtt::Qos::e1}, Bytes(""), {._retained = true}); // 清除
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  {
+    Client late{address, "loopback-late"};
+    std::atomic<int> retained{0};
+    late.Connect();
+    late._mqtt->Subscribe({"retain/#", Mqtt::Qos::e1},
+                          [&](Mqtt::TopicView, std::span<uint8_t>) { ++retained; });
+    ok = Check(WaitFor([&] { return retained >= 1; }) &&
+                   (std::this_thread::sleep_for(std::chrono::milliseconds(100)), retained == 1),
+               "retained message") &&
+         ok;
+    late._mqtt->Disconnect();
+    WaitFor([&] { return !late._connected; });
+  }
+
+  // 连接和收发指标
+  {
+    auto m = pub._mqtt->GetMetrics();
+    auto r = sub._mqtt->GetMetrics();
+    DSG_LOG(m.to_string());
+    ok = Check(m._connected && m._sent >= 7 && m._acked == m._sent && m._failed == 0 &&
+                   m._inflight == 0 && m._bytesOut > 0 && m._connectLatencyUs >= 0 &&
+                   m._sinceLastInboundMs == -1 && m.AckRttPercentile(50) > 0 &&
+                   r._received == 3 && r._sinceLastInboundMs >= 0,
+               "metrics") &&
+         ok;
+  }
+
+  // 本地缓存的最近一条消息，取消订阅后移除
+  {
+    Client cache{address, "loopback-cache", false, 16};
+    cache.Connect();
+    cache._mqtt->Subscribe({"cache/#", Mqtt::Qos::e1});
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    pub._mqtt->Send({"cache/a", Mqtt::Qos::e1}, std::string("1"));
+    pub._mqtt->Send({"cache/a", Mqtt::Qos::e1}, std::string("22"));
+    pub._mqtt->Send({"cache/b", Mqtt::Qos::e1}, std::string("333"));
+    std::vector<uint8_t> value;
+    auto is = [&](const char *topic, std::string_view expect) {
+      return cache._mqtt->LastValue(topic, value) &&
+             std::string_view(reinterpret_cast<const char *>(value.data()), value.size()) ==
+                 expect;
+    };
+    ok = Check(WaitFor([&] { return is("cache/a", "22") && is("cache/b", "333"); }) &&
+                   !cache._mqtt->LastValue("cache/c", value),
+               "last value cache") &&
+         ok;
+    cache._mqtt->Unsubscribe({"cache/#", Mqtt::Qos::e1});
+    ok = Check(!cache._mqtt->LastValue("cache/a", value), "last value evicted on unsubscribe") &&
+         ok;
+    cache._mqtt->Disconnect();
+    WaitFor([&] { return !cache._connected; });
+  }
+
+  // 发送调度：断线时消息留在队列中，连接后重试发出；交给 paho 的消息数不超过在途窗口
+  {
+    std::atomic<int> scheduled{0};
+    sub._mqtt->Subscribe({"schedule/#", Mqtt::Qos::e1},
+                         [&](Mqtt::TopicView, std::span<uint8_t>) { ++scheduled; });
+    std::atomic<bool> connected{false};
+    auto sched = Mqtt::Request(Mqtt::Config{
+        ._address = address,
+        ._clientID = "loopback-schedule",
+        ._schedule = true,
+        ._scheduleInflight = 4,
+        ._connectCallback = [&connected](bool ok, std::string_view) { connected = ok; },
+        ._disconnectCallback = [&connected](bool ok, std::string_view) { connected = !ok; },
+    });
+    for (int i = 0; i < 50; ++i) {
+      sched->Send({"schedule/data", Mqtt::Qos::e1}, Bytes("queued"),
+                  {._priority = i % 2 ? Mqtt::Priority::eLow : Mqtt::Priority::eHigh});
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    auto before = sched->GetScheduleStats();
+    sched->Connect();
+    ok = Check(WaitFor([&] { return scheduled == 50; }), "scheduled messages retried") && ok;
+    auto s = sched->GetScheduleStats();
+    DSG_LOG(s.to_string());
+    ok = Check(before._lanes[0]._retried > 0 && before._lanes[0]._failed == 0 &&
+                   s._lanes[0]._sent == 25 && s._lanes[2]._sent == 25 && s._window == 4 &&
+                   WaitFor([&] { return sched->GetScheduleStats()._inflight == 0; }),
+               "schedule inflight window") &&
+         ok;
+    sched->Disconnect();
+    WaitFor([&] { return !connected; });
+    sub._mqtt->Unsubscribe({"schedule/#", Mqtt::Qos::e1});
+  }
+
+  // 压缩：不同内容和长度的负载往返一致，以 magic 开头的原始负载转义；
+  // 参考实现压缩的块能解出原文；伪造的超大原始长度、截断和损坏的块不解压，按原负载交付
+  {
+    std::atomic<bool> connected{false};
+    std::mutex mutex;
+    std::map<std::string, std::string> payloads;
+    auto zip = Mqtt::Request(Mqtt::Config{
+        ._address = address,
+        ._clientID = "loopback-compress",
+        ._dispatchThreads = 1,
+        ._compress = true,
+        ._compressThreshold = 64,
+        ._connectCallback = [&connected](bool ok, std::string_view) { connected = ok; },
+        ._disconnectCallback = [&connected](bool ok, std::string_view) { connected = !ok; },
+    });
+    zip->Connect();
+    WaitFor([&] { return connected.load(); });
+    zip->Subscribe({"zip/#", Mqtt::Qos::e1}, [&](Mqtt::TopicView topic,
+                                                 std::span<uint8_t> payload) {
+      std::lock_guard<std::mutex> lock{mutex};
+      payloads[std::string(topic._name)].assign(payload.begin(), payload.end());
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    // 往返：重复、文本、不可压缩、刚过阈值的负载
+    std::map<std::string, std::string> roundTrip;
+    roundTrip["zip/large"] = std::string(4096, 'z');
+    for (int i = 0; i < 40; ++i) {
+      roundTrip["zip/text"] += DSG_STR("{\"device\":" << i % 7 << ",\"seq\":" << i * 31
+                                                     << ",\"status\":\"online\"}\n");
+    }
+    uint32_t seed = 1;
+    for (int i = 0; i < 1000; ++i) {
+      seed = seed * 1103515245 + 12345;
+      roundTrip["zip/random"].push_back(static_cast<char>(seed >> 16));
+    }
+    roundTrip["zip/short"] = std::string(32, 'a') + std::string(33, 'b');
+    roundTrip["zip/magic"] = std::string("\xD5Z\x00\x01tiny", 8);
+    for (const auto &[topic, payload] : roundTrip) {
+      zip->Send({topic, Mqtt::Qos::e1}, payload);
+    }
+
+    // LZ4 参考实现（liblz4 1.9.4 LZ4_compress_default）对 reference 原文压缩的块，
+    // 由未启用压缩的客户端加上头原样发送
+    const std::string reference =
+        R"({"device":42,"status":"online","status":"online","status":"online"})";
+    const std::string block("\xff\x0f{\"device\":42,\"status\":\"online\"\x12\x00\x0dPine\"}", 41);
+    const std::string header("\xD5Z\x00\x01\x43\x00\x00\x00", 8);
+    auto corrupt = header + block;
+    corrupt[header.size() + 32] = '\xff'; // 匹配偏移超出已输出的数据
+    corrupt[header.size() + 33] = '\xff';
+    std::map<std::string, std::string> raw;
+    raw["zip/reference"] = header + block;
+    raw["zip/truncated"] = header + block.substr(0, block.size() - 3);
+    raw["zip/corrupt"] = corrupt;
+    raw["zip/forged"] = std::string("\xD5Z\x00\x01\xff\xff\xff\xff\x00\x00", 10);
+    for (const auto &[topic, payload] : raw) {
+      pub._mqtt->Send({topic, Mqtt::Qos::e1}, payload);
+    }
+
+    const auto total = roundTrip.size() + raw.size();
+    WaitFor([&] {
+      std::lock_guard<std::mutex> lock{mutex};
+      return payloads.size() == total;
+    });
+    std::lock_guard<std::mutex> lock{mutex};
+    auto received = [&](const std::string &topic, const std::string &expect) {
+      auto it = payloads.find(topic);
+      return it != payloads.end() && it->second == expect;
+    };
+    ok = Check(std::all_of(roundTrip.begin(), roundTrip.end(),
+                           [&](const auto &kv) { return received(kv.first, kv.second); }) &&
+                   zip->GetMetrics()._bytesOut < roundTrip["zip/large"].size(),
+               "compress round trip and escape") &&
+         ok;
+    ok = Check(received("zip/reference", reference), "decode reference lz4 block") && ok;
+    ok = Check(received("zip/truncated", raw["zip/truncated"]) &&
+                   received("zip/corrupt", raw["zip/corrupt"]) &&
+                   received("zip/forged", raw["zip/forged"]),
+               "truncated, corrupt and oversized blocks delivered raw") &&
+         ok;
+    zip->Disconnect();
+    WaitFor([&] { return !connected; });
+  }
+
+  // 多线程分发：同一 topic 的消息按序回调
+  {
+    constexpr int kTopics = 4;
+    constexpr int kPerTopic = 200;
+    std::atomic<bool> connected{false};
+    std::mutex mutex;
+    std::vector<std::vector<int>> sequences(kTopics);
+    auto shard = Mqtt::Request(Mqtt::Config{
+        ._address = address,
+        ._clientID = "loopback-shard",
+        ._dispatchThreads = 4,
+        ._dispatchQueueSize = 64,
+        ._connectCallback = [&connected](bool ok, std::string_view) { connected = ok; },
+        ._disconnectCallback = [&connected](bool ok, std::string_view) { connected = !ok; },
+    });
+    shard->Connect();
+    WaitFor([&] { return connected.load(); });
+    shard->Subscribe({"shard/#", Mqtt::Qos::e1}, [&](Mqtt::TopicView topic,
+                                                     std::span<uint8_t> payload) {
+      int seq = 0;
+      std::memcpy(&seq, payload.data(), std::min(payload.size(), sizeof(seq)));
+      std::lock_guard<std::mutex> lock{mutex};
+      sequences[topic._name.back() - '0'].push_back(seq);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    for (int i = 0; i < kPerTopic; ++i) {
+      for (int t = 0; t < kTopics; ++t) {
+        std::string topic = "shard/" + std::to_string(t);
+        auto seq = std::span<const uint8_t>(reinterpret_cast<const uint8_t *>(&i), sizeof(i));
+        while (!shard->Send({topic, Mqtt::Qos::e1}, seq, {})) {
+          std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+      }
+    }
+    auto done = WaitFor([&] {
+      std::lock_guard<std::mutex> lock{mutex};
+      return std::all_of(sequences.begin(), sequences.end(),
+                         [](const auto &s) { return s.size() >= kPerTopic; });
+    });
+    auto stats = shard->GetDispatchStats();
+    DSG_LOG(stats.to_string());
+    std::lock_guard<std::mutex> lock{mutex};
+    ok = Check(done && std::all_of(sequences.begin(), sequences.end(),
+                                   [](const auto &s) { return std::is_sorted(s.begin(), s.end()); }),
+               "sharded dispatch keeps per-topic order") &&
+         ok;
+    shard->Disconnect();
+    WaitFor([&] { return !connected; });
+  }
+
+  // 回调慢、队列很小：发送结果事件转入溢出列表，网络线程等待，不丢弃也不在网络线程执行
+  {
+    constexpr int kCount = 200;
+    std::atomic<bool> connected{false};
+    std::atomic<int> sent{0};
+    std::atomic<int> elsewhere{0};
+    std::thread::id worker;
+    auto slow = Mqtt::Request(Mqtt::Config{
+        ._address = address,
+        ._clientID = "loopback-overflow",
+        ._dispatchThreads = 1,
+        ._dispatchQueueSize = 8,
+        ._connectCallback = [&](bool ok, std::string_view) {
+          worker = std::this_thread::get_id();
+          connected = ok;
+        },
+        ._disconnectCallback = [&connected](bool ok, std::string_view) { connected = !ok; },
+        ._sendCallback = [&](bool, Mqtt::TopicView, std::string_view) {
+          elsewhere += std::this_thread::get_id() != worker;
+          std::this_thread::sleep_for(std::chrono::microseconds(200));
+          ++sent;
+        },
+    });
+    slow->Connect();
+    WaitFor([&] { return connected.load(); });
+    for (int i = 0; i < kCount; ++i) {
+      while (!slow->Send({"overflow/data", Mqtt::Qos::e1}, Bytes("x"), {})) {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+      }
+    }
+    ok = Check(WaitFor([&] { return sent == kCount; }), "overflowed events all dispatched") && ok;
+    auto stats = slow->GetDispatchStats();
+    DSG_LOG(stats.to_string());
+    ok = Check(stats._overflowed > 0 && elsewhere == 0, "overflow runs on dispatch thread") && ok;
+    slow->Disconnect();
+    WaitFor([&] { return !connected; });
+  }
+
+  // broker 重启后自动重连并恢复订阅
+  broker->Stop();
+  ok = Check(WaitFor([&] { return sub._lost > 0; }), "connection lost on broker stop") && ok;
+  broker->Start();
+  pub.Connect();
+  ok = Check(WaitFor([&] { return sub._connected.load(); }), "auto reconnect") && ok;
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  received[1] = 0;
+  pub._mqtt->Send({"loop/1/data", Mqtt::Qos::e1}, std::string("again"));
+  ok = Check(WaitFor([&] { return received[1] == 1; }), "subscriptions restored") && ok;
+  ok = Check(sub._mqtt->GetMetrics()._reconnects == 1 &&
+                 sub._mqtt->GetMetrics()._connectionLost == 1,
+             "reconnect metrics") &&
+       ok;
+
+  // 吞吐和延迟：负载前 8 字节为发送时间
+  std::atomic<int> arrived{0};
+  std::atomic<int64_t> latencySumNs{0};
+  std::atomic<int64_t> latencyMaxNs{0};
+  sub._mqtt->Subscribe({"bench/data", qos}, [&](Mqtt::TopicView, std::span<uint8_t> payload) {
+    int64_t sentNs = 0;
+    std::memcpy(&sentNs, payload.data(), std::min(payload.size(), sizeof(sentNs)));
+    auto latency = NowNs() - sentNs;
+    latencySumNs += latency;
+    if (latency > latencyMaxNs) {
+      latencyMaxNs = latency;
+    }
+    ++arrived;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  std::vector<uint8_t> payload(std::max(size, sizeof(int64_t)));
+  auto start = NowNs();
+  for (int i = 0; i < count; ++i) {
+    auto now = NowNs();
+    std::memcpy(payload.data(), &now, sizeof(now));
+    while (!pub._mqtt->Send({"bench/data", qos}, payload)) {
+      std::this_thread::sleep_for(std::chrono::microseconds(100)); // paho 缓冲满
+    }
+  }
+  WaitFor([&] { return arrived >= count; }, 60000);
+  auto seconds = static_cast<double>(NowNs() - start) / 1e9;
+  auto n = arrived.load();
+  DSG_LOG("bench qos:" << Mqtt::FromQos(qos) << ", payload:" << payload.size() << "B, received:"
+                       << n << "/" << count << ", " << static_cast<int64_t>(n / seconds)
+                       << " msg/s, latency(us) avg:"
+                       << (n ? latencySumNs / n / 1000 : 0) << " max:" << latencyMaxNs / 1000);
+  DSG_LOG(broker->GetStats().to_string());
+
+  pub._mqtt->Disconnect();
+  sub._mqtt->Disconnect();
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  return ok ? 0 : 1;
+}
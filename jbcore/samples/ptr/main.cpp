@@ -2,7 +2,14 @@
 #include <memory>
 #include <map>
 #include <unordered_map>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
 #include <ptr.hpp>
+#include <ptr_reclaim.hpp>
+#include <shared_buffer.hpp>
+#include <cow.hpp>
 
 using namespace dsg;
 
@@ -106,9 +113,332 @@ void test_safe_ref() {
   std::cout << "-------\n";
 }
 
-int main(int argc, char** argv) {
+struct Observed : public interface_wrapper<I> {
+  static inline std::atomic<int> alive{0};
+  static inline std::atomic<int> destroyed{0};
+  Observed() { ++alive; }
+  ~Observed() {
+    --alive;
+    ++destroyed;
+  }
+  void test() override {}
+};
+
+/// 类自定义分配，按实际类型的大小回收
+struct Sized : public interface_wrapper<I> {
+  static inline std::atomic<std::size_t> freed{0};
+  static auto operator new(std::size_t size) -> void* { return ::operator new(size); }
+  static auto operator delete(void* p, std::size_t size) -> void {
+    freed = size;
+    ::operator delete(p);
+  }
+  void test() override {}
+};
+
+struct SizedDerived : public Sized {
+  char _data[64]{};
+};
+
+struct Compact : public compact_ref_policy {
+  uint32_t _v{0};
+};
+
+void test_weak_ref() {
+  auto check = [](bool ok, const char* name) {
+    std::cout << (ok ? "[ OK ] " : "[FAIL] ") << name << "\n";
+  };
+
+  {
+    auto p = make_ptr<DBase>();
+    weak_ptr<Base> w = p;
+    check(w.use_count() == 1 && !w.expired(), "weak does not add strong ref");
+    auto l = w.lock();
+    check(l == p && p.use_count() == 2, "lock while alive");
+    l.reset();
+    p.reset();
+    check(w.expired() && !w.lock(), "lock after destroy");
+  }
+
+  {
+    auto ip = interface_cast<I>(make_ptr<Observed>());
+    weak_interface_ptr<I> w = ip;
+    auto copy = w;
+    ip = interface_ptr<I>{};
+    check(Observed::alive == 0 && copy.expired() && !w.lock(), "weak interface ptr");
+  }
+
+  {
+    ptr<Sized> p = make_ptr<SizedDerived>();
+    weak_ptr<Sized> w = p;
+    p.reset();
+    check(w.expired() && Sized::freed == 0, "weak keeps memory after destroy");
+    w.reset();
+    check(Sized::freed == sizeof(SizedDerived), "weak to base frees with derived size");
+  }
+  {
+    auto p = make_ptr<Compact>();
+    weak_ptr<Compact> w = p;
+    auto l = w.lock();
+    p.reset();
+    l.reset();
+    check(sizeof(Compact) == 12 && w.expired() && !w.lock(), "weak on compact policy");
+  }
+
+  // 多个线程反复 lock，同时释放最后一个强引用，对象只析构一次
+  Observed::destroyed = 0;
+  const int rounds = 500;
+  std::atomic<int> locked{0};
+  for (int r = 0; r < rounds; ++r) {
+    auto p = make_ptr<Observed>();
+    weak_ptr<Observed> w = p;
+    // 线程开始 lock 后再释放，各线程在 lock 失败后退出
+    const auto target = locked + 3;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 3; ++i) {
+      threads.emplace_back([&, w] {
+        while (true) {
+          if (!w.lock()) {
+            break;
+          }
+          ++locked;
+          std::this_thread::yield(); // 不持有强引用时让出
+        }
+      });
+    }
+    while (locked < target) {
+      std::this_thread::yield();
+    }
+    p.reset();
+    for (auto& t : threads) {
+      t.join();
+    }
+  }
+  check(Observed::destroyed == rounds && Observed::alive == 0, "concurrent lock and release");
+  std::cout << "locked " << locked << "\n";
+}
+
+struct Route : public ref_policy {
+  static inline std::atomic<int> alive{0};
+  explicit Route(int version) : _version{version}, _check{version * 7} { ++alive; }
+  ~Route() {
+    _check = -1;
+    --alive;
+  }
+  int _version;
+  int _check;
+};
+
+void test_atomic_ptr() {
+  auto check = [](bool ok, const char* name) {
+    std::cout << (ok ? "[ OK ] " : "[FAIL] ") << name << "\n";
+  };
+
+  {
+    atomic_ptr<Route> a;
+    check(!a.load(), "empty atomic_ptr");
+    auto r1 = make_ptr<Route>(1);
+    a.store(r1);
+    check(a.load() == r1, "load after store");
+    auto old = a.exchange(make_ptr<Route>(2));
+    check(old == r1 && a.load()->_version == 2, "exchange");
+    auto expected = r1;
+    check(!a.compare_exchange(expected, make_ptr<Route>(3)) && expected->_version == 2,
+          "compare_exchange mismatch");
+    check(a.compare_exchange(expected, make_ptr<Route>(4)) && a.load()->_version == 4,
+          "compare_exchange");
+    old.reset();
+    r1.reset();
+    expected.reset();
+    check(Route::alive == 1, "replaced objects released");
+
+    // 多次 load 会触发补充预加的引用，换出后计数应恢复
+    for (int i = 0; i < 100000; ++i) {
+      a.load();
+    }
+    auto last = a.exchange(make_ptr<Route>(5));
+    check(last->_version == 4 && last.use_count() == 1, "refill keeps count balanced");
+  }
+  check(Route::alive == 0, "atomic_ptr releases on destruction");
+
+  // 读线程持续 load，写线程不断替换，读到的对象必须完整有效
+  {
+    atomic_ptr<Route> a{make_ptr<Route>(0)};
+    std::atomic<bool> stop{false};
+    std::atomic<int> bad{0};
+    std::atomic<long> loads{0};
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 3; ++i) {
+      readers.emplace_back([&] {
+        while (!stop) {
+          auto r = a.load();
+          if (!r || r->_check != r->_version * 7) {
+            ++bad;
+          }
+          ++loads;
+        }
+      });
+    }
+    for (int v = 1; v <= 100000; ++v) {
+      a.store(make_ptr<Route>(v));
+      if (v % 1000 == 0) {
+        std::this_thread::yield();
+      }
+    }
+    stop = true;
+    for (auto& t : readers) {
+      t.join();
+    }
+    check(bad == 0 && Route::alive == 1, "concurrent load and store");
+    std::cout << "loads " << loads << "\n";
+  }
+  check(Route::alive == 0, "no leak after concurrent use");
+}
+
+struct Heavy : public ref_policy {
+  static inline std::atomic<int> alive{0};
+  static inline std::atomic<int> offThread{0};
+  static inline std::thread::id owner{};
+  Heavy() { ++alive; }
+  ~Heavy() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1)); // 模拟释放连接等耗时析构
+    if (std::this_thread::get_id() != owner) {
+      ++offThread;
+    }
+    --alive;
+  }
+};
+
+void test_reclaim() {
+  auto check = [](bool ok, const char* name) {
+    std::cout << (ok ? "[ OK ] " : "[FAIL] ") << name << "\n";
+  };
+  Heavy::owner = std::this_thread::get_id();
+
+  {
+    reclaim_domain domain;
+    auto start = std::chrono::steady_clock::now();
+    {
+      reclaim_scope scope{domain};
+      for (int i = 0; i < 200; ++i) {
+        auto h = make_ptr<Heavy>();
+      }
+    }
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+                  std::chrono::steady_clock::now() - start)
+                  .count();
+    std::cout << "release 200 heavy objects in scope: " << us << "us\n";
+    check(us < 100000, "hot thread does not run destructors");
+  }
+  check(Heavy::alive == 0 && Heavy::offThread == 200, "destroyed on background thread");
+
+  {
+    reclaim_domain domain{false};
+    reclaim_scope scope{domain};
+    for (int i = 0; i < 10; ++i) {
+      make_ptr<Heavy>();
+    }
+    bool deferred = Heavy::alive == 10 && domain.pending() == 0;
+    scope.flush();
+    deferred = deferred && domain.pending() == 10;
+    check(deferred && domain.collect() == 10 && Heavy::alive == 0, "collect at quiescent point");
+  }
+}
+
+void test_shared_buffer() {
+  auto check = [](bool ok, const char* name) {
+    std::cout << (ok ? "[ OK ] " : "[FAIL] ") << name << "\n";
+  };
+
+  auto buf = shared_buffer::copy_of(std::string_view{"topic/a:payload"});
+  check(buf.size() == 15 && buf.str() == "topic/a:payload", "copy_of");
+
+  auto body = buf.slice(8);
+  auto head = buf.slice(0, 7);
+  check(body.str() == "payload" && head.str() == "topic/a" && buf.use_count() == 3,
+        "slices share one block");
+  check(buf.slice(20).empty() && buf.slice(10, 100).str() == "yload", "slice clamps to bounds");
+
+  std::span<const uint8_t> view = body;
+  check(view.data() == buf.data() + 8 && view.size() == 7, "converts to span without copy");
+
+  buf.reset();
+  head.reset();
+  check(body.unique() && body.str() == "payload", "slice keeps block alive");
+
+  auto moved = std::move(body);
+  check(body.empty() && body.use_count() == 0 && moved.str() == "payload", "move clears source");
+
+  auto out = shared_buffer::allocate(4);
+  for (auto& b : out.writable()) {
+    b = 0x5a;
+  }
+  check(out[3] == 0x5a && shared_buffer::allocate(0).use_count() == 0, "allocate");
+}
+
+void test_cow() {
+  auto check = [](bool ok, const char* name) {
+    std::cout << (ok ? "[ OK ] " : "[FAIL] ") << name << "\n";
+  };
+
+  cow_map<std::string, int> config{{"qos", 1}, {"retry", 3}};
+  auto snapshot = config;
+  check(snapshot.shares_with(config) && config.use_count() == 2, "copy shares snapshot");
+
+  config.set("qos", 2);
+  check(!snapshot.shares_with(config) && *snapshot.get("qos") == 1 && config.at("qos") == 2,
+        "write clones shared data");
+
+  const auto* before = &config.read();
+  config.set("retry", 5);
+  check(&config.read() == before && config.unique(), "unique writer mutates in place");
+  check(!config.erase("missing") && config.unique() && config.erase("retry") && config.size() == 1,
+        "erase");
+
+  cow_vector<std::string> topics;
+  check(topics.empty() && topics.use_count() == 0, "empty without allocation");
+  topics.push_back("a/#");
+  topics.emplace_back("b/+");
+  auto readers = topics;
+  topics.set(0, "c/#");
+  check(readers[0] == "a/#" && topics[0] == "c/#" && topics.size() == 2, "vector copy on write");
+
+  // 写线程在锁内发布，读线程在锁内取快照，锁外读
+  std::mutex mutex;
+  cow_map<int, int> published;
+  std::atomic<bool> consistent{true};
+  std::thread reader{[&] {
+    for (int i = 0; i < 2000; ++i) {
+      cow_map<int, int> snap;
+      {
+        std::lock_guard<std::mutex> lock{mutex};
+        snap = published;
+      }
+      int expect = snap.empty() ? 0 : snap.begin()->second;
+      for (auto& [k, v] : snap) {
+        consistent = consistent && v == expect;
+      }
+    }
+  }};
+  cow_map<int, int> local;
+  for (int round = 1; round <= 2000; ++round) {
+    for (int k = 0; k < 8; ++k) {
+      local.set(k, round);
+    }
+    std::lock_guard<std::mutex> lock{mutex};
+    published = local;
+  }
+  reader.join();
+  check(consistent, "readers see whole snapshots");
+}
+
+int main() {
   // test_ptr_policy();
   test_safe_ref();
+  test_weak_ref();
+  test_atomic_ptr();
+  test_reclaim();
+  test_shared_buffer();
+  test_cow();
 
   return 0;
 }
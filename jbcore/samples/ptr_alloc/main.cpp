@@ -0,0 +1,234 @@
+#include <iostream>
+#include <chrono>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+
+#include <def.hpp>
+#include <ptr_alloc.hpp>
+
+using namespace dsg;
+
+// make_ptr（全局堆）与 make_pooled（线程缓存定长池）、arena 对比
+// 检查对象析构和归还到正确的池，输出单纯分配+释放和每个对象创建+释放的耗时；
+// 耗时只在 Release 构建下有意义，Debug 构建中池的内联路径没有优化，不比全局堆快
+// 用法：sample_ptr_alloc [次数]
+
+namespace {
+std::atomic<int> g_alive{0};
+
+struct Payload {
+  uint64_t _seq{0};
+  int64_t _ts{0};
+  uint8_t _data[48]{};
+};
+
+struct Frame : public ref_policy {
+  explicit Frame(uint64_t seq) : _p{seq} {
+    ++g_alive;
+  }
+  ~Frame() {
+    --g_alive;
+  }
+  Payload _p;
+};
+
+struct PooledFrame : public ref_policy, public pool_object {
+  explicit PooledFrame(uint64_t seq) : _p{seq} {
+    ++g_alive;
+  }
+  ~PooledFrame() {
+    --g_alive;
+  }
+  Payload _p;
+};
+
+// 测耗时的类型不计数，避免两次原子操作掩盖分配本身的差别
+struct BenchFrame : public ref_policy {
+  explicit BenchFrame(uint64_t seq) : _p{seq} {
+  }
+  Payload _p;
+};
+
+struct PooledBenchFrame : public ref_policy, public pool_object {
+  explicit PooledBenchFrame(uint64_t seq) : _p{seq} {
+  }
+  Payload _p;
+};
+
+template <typename F> auto NsPerOp(int count, F &&f) -> double {
+  auto start = std::chrono::steady_clock::now();
+  f();
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start)
+                .count();
+  return static_cast<double>(ns) / count;
+}
+
+/// @brief 逐个创建释放
+template <typename Make> auto Churn(int count, Make &&make) -> double {
+  uint64_t sink = 0;
+  auto ns = NsPerOp(count, [&] {
+    for (int i = 0; i < count; ++i) {
+      auto p = make(static_cast<uint64_t>(i));
+      sink += p->_p._seq;
+    }
+  });
+  return sink == static_cast<uint64_t>(count) * (count - 1) / 2 ? ns : -1;
+}
+
+constexpr int kBatch = 1024;
+
+/// @brief 先创建一批再整体释放
+/// @param reset 每批释放后调用，arena 在此整体回收
+template <typename Make, typename Reset> auto Batch(int count, Make &&make, Reset &&reset)
+    -> double {
+  std::vector<decltype(make(0))> live;
+  live.reserve(kBatch);
+  return NsPerOp(count, [&] {
+    for (int i = 0; i < count; i += kBatch) {
+      for (int j = 0; j < kBatch; ++j) {
+        live.push_back(make(static_cast<uint64_t>(j)));
+      }
+      live.clear();
+      reset();
+    }
+  });
+}
+
+/// @brief 单纯分配+释放一个块，不构造对象
+template <typename Alloc, typename Free> auto RawAlloc(int count, Alloc &&alloc, Free &&free)
+    -> double {
+  return NsPerOp(count, [&] {
+    for (int i = 0; i < count; ++i) {
+      void *p = alloc();
+      asm volatile("" : : "r"(p) : "memory");
+      free(p);
+    }
+  });
+}
+
+/// @brief 一个线程创建，另一个线程释放
+/// @param peak 同时存活对象数的峰值，消费线程跟不上时对象在队列中积压，池和全局堆都要为其分配
+template <typename Make> auto CrossThread(int count, Make &&make, std::size_t &peak) -> double {
+  using P = decltype(make(0));
+  constexpr std::size_t kBatch = 256;
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::vector<P> queue;
+  bool done = false;
+  std::atomic<std::size_t> freed{0};
+  peak = 0;
+
+  return NsPerOp(count, [&] {
+    std::thread consumer{[&] {
+      std::vector<P> local;
+      while (true) {
+        {
+          std::unique_lock<std::mutex> lock{mutex};
+          cv.wait(lock, [&] { return !queue.empty() || done; });
+          if (queue.empty()) {
+            break;
+          }
+          local.swap(queue);
+        }
+        auto n = local.size();
+        local.clear();
+        freed.fetch_add(n, std::memory_order_relaxed);
+      }
+    }};
+
+    std::vector<P> batch;
+    for (int i = 0; i < count; ++i) {
+      batch.push_back(make(static_cast<uint64_t>(i)));
+      if (batch.size() == kBatch || i == count - 1) {
+        std::lock_guard<std::mutex> lock{mutex};
+        for (auto &p : batch) {
+          queue.push_back(std::move(p));
+        }
+        batch.clear();
+        cv.notify_one();
+        peak = std::max(peak, i + 1 - freed.load(std::memory_order_relaxed));
+      }
+    }
+    {
+      std::lock_guard<std::mutex> lock{mutex};
+      done = true;
+    }
+    cv.notify_one();
+    consumer.join();
+  });
+}
+
+auto Check(bool ok, const char *name) -> bool {
+  DSG_LOG((ok ? "[ OK ] " : "[FAIL] ") << name);
+  return ok;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  const int count = argc > 1 ? std::stoi(argv[1]) : 1000000;
+  bool ok = true;
+  {
+    auto a = make_pooled<PooledFrame>(1);
+    auto b = make_ptr<PooledFrame>(2); // 未指定资源时走全局堆
+    weak_ptr<PooledFrame> w = a;
+    a.reset();
+    ok &= Check(g_alive == 1 && w.expired(), "pooled object destroyed, weak ref keeps block");
+  }
+  ok &= Check(g_alive == 0, "pooled and heap objects released");
+
+  {
+    std::pmr::monotonic_buffer_resource arena{64 * 1024};
+    std::vector<ptr<PooledFrame>> frames;
+    for (uint64_t i = 0; i < 100; ++i) {
+      frames.push_back(make_ptr_in<PooledFrame>(arena, i));
+    }
+    frames.clear();
+    ok &= Check(g_alive == 0, "arena objects destroyed");
+  }
+
+  using Pool = fixed_pool<PooledBenchFrame, sizeof(PooledBenchFrame) + pool_object::header_size>;
+  auto &benchPool = Pool::instance();
+  constexpr std::size_t kRawSize = sizeof(PooledBenchFrame) + pool_object::header_size;
+  auto heapRaw = RawAlloc(
+      count, [] { return ::operator new(kRawSize); },
+      [](void *p) { ::operator delete(p, kRawSize); });
+  auto poolRaw = RawAlloc(
+      count, [&] { return benchPool.allocate(kRawSize, alignof(std::max_align_t)); },
+      [&](void *p) { benchPool.deallocate(p, kRawSize, alignof(std::max_align_t)); });
+
+  auto heap = [](uint64_t seq) { return make_ptr<BenchFrame>(seq); };
+  auto pooled = [](uint64_t seq) { return make_pooled<PooledBenchFrame>(seq); };
+  // arena 每批用完整体回收，复用同一块缓冲区；逐个创建释放不适合 arena，不测
+  std::vector<std::byte> arenaBuffer(kBatch * (kRawSize + alignof(std::max_align_t)));
+  std::pmr::monotonic_buffer_resource arena{arenaBuffer.data(), arenaBuffer.size()};
+  auto arenaMake = [&](uint64_t seq) { return make_ptr_in<PooledBenchFrame>(arena, seq); };
+  auto none = [] {};
+
+  auto heapChurn = Churn(count, heap);
+  auto poolChurn = Churn(count, pooled);
+  auto heapBatch = Batch(count, heap, none);
+  auto poolBatch = Batch(count, pooled, none);
+  auto arenaBatch = Batch(count, arenaMake, [&] { arena.release(); });
+  // 块被复用，池的大小只取决于同时存活的对象数（Batch 中最多 1024 个）
+  ok &= Check(g_alive == 0 && benchPool.capacity() < 2048, "pool blocks reused");
+  std::size_t heapPeak = 0;
+  std::size_t poolPeak = 0;
+  auto heapCross = CrossThread(count, heap, heapPeak);
+  auto poolCross = CrossThread(count, pooled, poolPeak);
+
+  DSG_LOG("ns/object       alloc   churn   batch   cross-thread");
+  DSG_LOG("new          " << heapRaw << "  " << heapChurn << "  " << heapBatch << "  "
+                          << heapCross);
+  DSG_LOG("pool         " << poolRaw << "  " << poolChurn << "  " << poolBatch << "  "
+                          << poolCross);
+  DSG_LOG("arena        -  -  " << arenaBatch << "  -");
+  // churn/batch 中还包含引用计数和构造，分配之外的部分两边相同
+  DSG_LOG("pool vs new  alloc " << heapRaw / poolRaw << "x, churn " << heapChurn / poolChurn
+                                << "x (" << (poolRaw < heapRaw ? "faster" : "NOT faster")
+                                << " than new)");
+  DSG_LOG("pool blocks  " << benchPool.capacity() << ", cross-thread peak live objects: new "
+                          << heapPeak << ", pool " << poolPeak);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,111 @@
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <def.hpp>
+#include <ptr.hpp>
+
+using namespace dsg;
+
+// 偏置计数检查与开销对比：每次拷贝+析构一个 ptr 的耗时
+// 属主线程只做普通读写，其他线程走原子共享计数，对象在别的线程释放时由属主合并
+// 用法：sample_ptr_biased [次数]
+
+namespace {
+std::atomic<int> g_alive{0};
+
+template <typename Policy> struct Object : public Policy {
+  Object() {
+    ++g_alive;
+  }
+  ~Object() {
+    --g_alive;
+  }
+  int _value{1};
+};
+
+using Unsafe = Object<unsafe_ref_policy>;
+using Safe = Object<ref_policy>;
+using Biased = Object<biased_ref_policy>;
+
+template <typename T> auto CopyNs(const ptr<T> &p, int count) -> double {
+  volatile int sink = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < count; ++i) {
+    ptr<T> copy = p;
+    sink = sink + copy->_value;
+  }
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start)
+                .count();
+  return static_cast<double>(ns) / count;
+}
+
+auto Check(bool ok, const char *name) -> bool {
+  DSG_LOG((ok ? "[ OK ] " : "[FAIL] ") << name);
+  return ok;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  const int count = argc > 1 ? std::stoi(argv[1]) : 10000000;
+  bool ok = true;
+
+  {
+    auto p = make_ptr<Biased>();
+    auto q = p;
+    ok &= Check(p.use_count() == 2, "owner copies");
+  }
+  ok &= Check(g_alive == 0, "owner releases");
+
+  // 其他线程拷贝后释放，属主最后释放时合并
+  {
+    auto p = make_ptr<Biased>();
+    std::thread{[p] {
+      for (int i = 0; i < 1000; ++i) {
+        auto c = p;
+      }
+    }}.join();
+    ok &= Check(p.use_count() == 1, "shared copies merged back");
+  }
+  ok &= Check(g_alive == 0, "released after shared copies");
+
+  // 属主创建、交给其他线程释放：共享计数为负，进入属主收件箱，由属主合并后析构
+  {
+    std::vector<ptr<Biased>> objects(100);
+    for (auto &o : objects) {
+      o = make_ptr<Biased>();
+    }
+    std::thread{[objects = std::move(objects)]() mutable { objects.clear(); }}.join();
+    bool parked = g_alive == 100;
+    collect_biased();
+    ok &= Check(parked && g_alive == 0, "hand-off released by owner collect");
+  }
+
+  // 属主线程已退出，释放的线程直接合并
+  {
+    std::vector<ptr<Biased>> objects;
+    std::thread{[&] {
+      for (int i = 0; i < 100; ++i) {
+        objects.push_back(make_ptr<Biased>());
+      }
+    }}.join();
+    objects.clear();
+    ok &= Check(g_alive == 0, "released after owner thread exit");
+  }
+
+  auto unsafeNs = CopyNs(make_ptr<Unsafe>(), count);
+  auto safeNs = CopyNs(make_ptr<Safe>(), count);
+  auto biased = make_ptr<Biased>();
+  auto biasedNs = CopyNs(biased, count);
+  double otherNs = 0;
+  std::thread{[&] { otherNs = CopyNs(biased, count); }}.join();
+
+  DSG_LOG("ns per copy+destroy");
+  DSG_LOG("unsafe_ref_policy          " << unsafeNs);
+  DSG_LOG("ref_policy                 " << safeNs);
+  DSG_LOG("biased_ref_policy (owner)  " << biasedNs);
+  DSG_LOG("biased_ref_policy (other)  " << otherNs);
+  return ok ? 0 : 1;
+}
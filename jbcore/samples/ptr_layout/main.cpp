@@ -0,0 +1,158 @@
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <malloc.h>
+#include <thread>
+#include <vector>
+
+#include <def.hpp>
+#include <ptr.hpp>
+
+using namespace dsg;
+
+// 计数宽度与布局对比：对象大小、实际分配大小，以及多线程拷贝时的伪共享
+// neighbors：每个线程反复拷贝自己的对象，对象在内存中相邻
+// shared：一个线程反复拷贝对象，其他线程读对象的成员
+// 用法：sample_ptr_layout [每线程次数] [线程数]
+
+namespace {
+struct Payload {
+  uint32_t _id{0};
+  uint32_t _flags{0};
+};
+
+template <typename Policy> struct Small : public Policy {
+  Payload _p;
+};
+
+/// @brief 相邻分配，释放为空操作，便于构造相邻对象
+template <typename Policy> struct Packed : public Policy {
+  Payload _p;
+
+  static auto operator new(std::size_t size) -> void * {
+    constexpr std::size_t kArena = 1 << 20;
+    alignas(detail::cache_line_size) static std::byte arena[kArena];
+    static std::size_t used = 0;
+    used = (used + alignof(Packed) - 1) / alignof(Packed) * alignof(Packed);
+    auto *p = arena + used;
+    used += size;
+    return used <= kArena ? p : throw std::bad_alloc{};
+  }
+
+  static auto operator delete(void *) -> void {
+  }
+};
+
+template <typename Policy> auto Footprint(const char *name) -> void {
+  auto *p = new Small<Policy>;
+  auto usable = malloc_usable_size(p);
+  delete p;
+  DSG_LOG(name << "  sizeof " << sizeof(Small<Policy>) << "  alignof " << alignof(Small<Policy>)
+               << "  malloc " << usable);
+}
+
+template <typename F> auto NsPerOp(int count, F &&f) -> double {
+  auto start = std::chrono::steady_clock::now();
+  f();
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start)
+                .count();
+  return static_cast<double>(ns) / count;
+}
+
+template <typename T> auto CopyLoop(const ptr<T> &p, int count) -> void {
+  for (int i = 0; i < count; ++i) {
+    ptr<T> copy = p;
+    copy->_p._flags = static_cast<uint32_t>(i);
+  }
+}
+
+/// @brief 每个线程拷贝自己的对象，各线程平均 ns/次
+template <typename Policy> auto Neighbors(int count, int threads) -> double {
+  std::vector<ptr<Packed<Policy>>> objects;
+  for (int t = 0; t < threads; ++t) {
+    objects.push_back(make_ptr<Packed<Policy>>());
+  }
+  return NsPerOp(count, [&] {
+    std::vector<std::thread> workers;
+    for (auto &o : objects) {
+      workers.emplace_back([&o, count] { CopyLoop(o, count); });
+    }
+    for (auto &w : workers) {
+      w.join();
+    }
+  });
+}
+
+/// @brief 一个线程拷贝对象，其余线程读成员，读者 ns/次
+template <typename Policy> auto Shared(int count, int threads) -> double {
+  auto object = make_ptr<Small<Policy>>();
+  object->_p._id = 1;
+  std::atomic<bool> stop{false};
+  std::thread writer{[&] {
+    while (!stop.load(std::memory_order_relaxed)) {
+      CopyLoop(object, 1024);
+    }
+  }};
+  auto *p = object.get();
+  auto ns = NsPerOp(count, [&] {
+    std::vector<std::thread> readers;
+    for (int t = 1; t < std::max(threads, 2); ++t) {
+      readers.emplace_back([p, count] {
+        uint64_t sum = 0;
+        for (int i = 0; i < count; ++i) {
+          sum += reinterpret_cast<const volatile uint32_t &>(p->_p._id);
+        }
+        DSG_SP_PTR_ASSERT(sum == static_cast<uint64_t>(count));
+      });
+    }
+    for (auto &r : readers) {
+      r.join();
+    }
+  });
+  stop = true;
+  writer.join();
+  return ns;
+}
+
+auto Check(bool ok, const char *name) -> bool {
+  DSG_LOG((ok ? "[ OK ] " : "[FAIL] ") << name);
+  return ok;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  const int count = argc > 1 ? std::stoi(argv[1]) : 2000000;
+  const int threads = argc > 2 ? std::stoi(argv[2])
+                               : std::max(2, static_cast<int>(std::thread::hardware_concurrency()));
+
+  bool ok = true;
+  ok &= Check(sizeof(Small<compact_ref_policy>) + 8 == sizeof(Small<ref_policy>),
+              "compact policy saves 8 bytes");
+  {
+    auto a = make_ptr<Small<isolated_ref_policy>>();
+    auto b = a;
+    auto addr = reinterpret_cast<std::uintptr_t>(&a->_p);
+    ok &= Check(a.use_count() == 2 && addr % detail::cache_line_size == 0,
+                "isolated policy keeps members off the counter line");
+  }
+  {
+    auto a = make_ptr<Small<unsafe_compact_ref_policy>>();
+    std::vector<ptr<Small<unsafe_compact_ref_policy>>> copies(1000, a);
+    ok &= Check(a.use_count() == 1001, "compact counter");
+  }
+
+  Footprint<ref_policy>("ref_policy               ");
+  Footprint<compact_ref_policy>("compact_ref_policy       ");
+  Footprint<unsafe_compact_ref_policy>("unsafe_compact_ref_policy");
+  Footprint<isolated_ref_policy>("isolated_ref_policy      ");
+
+  DSG_LOG("threads " << threads << ", ns/op    neighbors   shared(read)");
+  DSG_LOG("ref_policy            " << Neighbors<ref_policy>(count, threads) << "  "
+                                   << Shared<ref_policy>(count, threads));
+  DSG_LOG("compact_ref_policy    " << Neighbors<compact_ref_policy>(count, threads) << "  "
+                                   << Shared<compact_ref_policy>(count, threads));
+  DSG_LOG("isolated_ref_policy   " << Neighbors<isolated_ref_policy>(count, threads) << "  "
+                                   << Shared<isolated_ref_policy>(count, threads));
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,100 @@
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <def.hpp>
+#include <ptr.hpp>
+
+using namespace dsg;
+
+// 存活对象统计：按类型的存活数、峰值、累计创建数，以及泄漏对象的创建调用栈
+// 本示例开启 DSG_SP_TRACK_OBJECTS、DSG_SP_TRACK_BACKTRACE
+// 用法：sample_ptr_track
+
+namespace {
+struct IPeer {
+  virtual ~IPeer() = default;
+};
+
+/// @brief 互相持有对方，构成循环引用
+struct Peer : public interface_wrapper<IPeer> {
+  interface_ptr<IPeer> _peer;
+};
+
+struct Message : public ref_policy {
+  uint64_t _seq{0};
+};
+
+struct Packet : public unsafe_ref_policy {
+  uint8_t _data[32]{};
+};
+
+auto Check(bool ok, const char *name) -> bool {
+  DSG_LOG((ok ? "[ OK ] " : "[FAIL] ") << name);
+  return ok;
+}
+
+auto MakeCycle() -> Peer * {
+  auto a = make_ptr<Peer>();
+  auto b = make_ptr<Peer>();
+  a->_peer = b;
+  b->_peer = a;
+  return a.get();
+}
+} // namespace
+
+int main() {
+  bool ok = true;
+
+  {
+    std::vector<ptr<Message>> messages;
+    for (int i = 0; i < 100; ++i) {
+      messages.push_back(make_ptr<Message>());
+    }
+    auto copy = messages;
+    auto c = census_of<Message>();
+    ok &= Check(c._live == 100 && c._peak == 100 && c._created == 100, "live objects counted once");
+  }
+  auto c = census_of<Message>();
+  ok &= Check(c._live == 0 && c._peak == 100, "destroyed objects leave peak");
+
+  {
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+      threads.emplace_back([] {
+        std::vector<ptr<Packet>> packets;
+        for (int i = 0; i < 10000; ++i) {
+          packets.push_back(make_ptr<Packet>());
+          if (packets.size() == 64) {
+            packets.clear();
+          }
+        }
+      });
+    }
+    for (auto &t : threads) {
+      t.join();
+    }
+    auto p = census_of<Packet>();
+    ok &= Check(p._live == 0 && p._created == 40000 && p._peak >= 64 && p._peak <= 256,
+                "sharded counters from several threads");
+  }
+
+  auto *leaked = MakeCycle();
+  ok &= Check(census_of<Peer>()._live == 2, "cycle shows as live objects");
+
+  std::ostringstream os;
+  dump_census(os);
+  DSG_LOG("\n" << os.str());
+  auto dump = os.str();
+  ok &= Check(dump.find("Peer") != std::string::npos, "census lists leaked type");
+#ifdef DSG_SP_TRACK_BACKTRACE
+  // a、b 在不同位置创建，各占一个调用栈
+  ok &= Check(dump.find("Peer: 1 live, created at") != std::string::npos,
+              "census lists creation backtraces");
+#endif
+
+  leaked->_peer = {}; // 打破循环
+  ok &= Check(census_of<Peer>()._live == 0, "cycle released");
+  return ok ? 0 : 1;
+}
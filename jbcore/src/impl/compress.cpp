@@ -0,0 +1,247 @@
+#include "def.hpp"
+#include "compress.hpp"
+
+namespace dsg::compress {
+namespace {
+constexpr uint8_t kMagic0 = 0xD5;
+constexpr uint8_t kMagic1 = 'Z';
+constexpr uint8_t kVersion = 1;
+constexpr uint8_t kEscaped = 0; // 转义头的版本字节
+
+constexpr std::size_t kMinMatch = 4;
+constexpr std::size_t kLastLiterals = 5; // 最后 5 字节必须是字面量
+constexpr std::size_t kMFLimit = 12;     // 最后一个匹配至少在结尾前 12 字节开始
+constexpr std::size_t kMaxOffset = 65535;
+constexpr int kHashLog = 12;
+
+inline auto Read32(const uint8_t *p) -> uint32_t {
+  uint32_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+inline auto Hash(uint32_t v) -> uint32_t {
+  return (v * 2654435761U) >> (32 - kHashLog);
+}
+
+inline auto WriteLength(std::vector<uint8_t> &out, std::size_t len) -> void {
+  while (len >= 255) {
+    out.push_back(255);
+    len -= 255;
+  }
+  out.push_back(static_cast<uint8_t>(len));
+}
+
+inline auto WriteSequence(std::vector<uint8_t> &out, const uint8_t *literal,
+                          std::size_t literalLen, std::size_t offset, std::size_t matchLen)
+    -> void {
+  auto ml = matchLen - kMinMatch;
+  out.push_back(static_cast<uint8_t>((std::min<std::size_t>(literalLen, 15) << 4) |
+                                     std::min<std::size_t>(ml, 15)));
+  if (literalLen >= 15) {
+    WriteLength(out, literalLen - 15);
+  }
+  out.insert(out.end(), literal, literal + literalLen);
+  out.push_back(static_cast<uint8_t>(offset & 0xff));
+  out.push_back(static_cast<uint8_t>(offset >> 8));
+  if (ml >= 15) {
+    WriteLength(out, ml - 15);
+  }
+}
+
+inline auto WriteLastLiterals(std::vector<uint8_t> &out, const uint8_t *literal,
+                              std::size_t literalLen) -> void {
+  out.push_back(static_cast<uint8_t>(std::min<std::size_t>(literalLen, 15) << 4));
+  if (literalLen >= 15) {
+    WriteLength(out, literalLen - 15);
+  }
+  out.insert(out.end(), literal, literal + literalLen);
+}
+
+/// @brief 贪心匹配的 LZ4 块压缩，window = dict + src，只输出 src 部分
+auto CompressBlock(std::span<const uint8_t> window, std::size_t dictLen, std::vector<uint8_t> &out)
+    -> void {
+  thread_local uint32_t table[1 << kHashLog];
+  std::memset(table, 0, sizeof(table)); // 存 pos + 1，0 为空
+
+  const uint8_t *base = window.data();
+  const std::size_t end = window.size();
+  const std::size_t srcLen = end - dictLen;
+
+  std::size_t anchor = dictLen;
+  if (srcLen < kMFLimit + 1) {
+    WriteLastLiterals(out, base + anchor, end - anchor);
+    return;
+  }
+
+  const std::size_t dictStart = dictLen > kMaxOffset ? dictLen - kMaxOffset : 0;
+  for (std::size_t p = dictStart; p + kMinMatch <= dictLen; ++p) {
+    table[Hash(Read32(base + p))] = static_cast<uint32_t>(p + 1);
+  }
+
+  const std::size_t matchLimit = end - kLastLiterals;
+  const std::size_t mfLimit = end - kMFLimit;
+  std::size_t ip = dictLen;
+  while (ip < mfLimit) {
+    auto seq = Read32(base + ip);
+    auto h = Hash(seq);
+    auto ref = static_cast<std::size_t>(table[h]);
+    table[h] = static_cast<uint32_t>(ip + 1);
+    if (ref == 0 || ip - (ref - 1) > kMaxOffset || Read32(base + ref - 1) != seq) {
+      ip += 1 + ((ip - anchor) >> 6); // 长时间无匹配时加速跳过
+      continue;
+    }
+    --ref;
+
+    std::size_t len = kMinMatch;
+    while (ip + len < matchLimit && base[ref + len] == base[ip + len]) {
+      ++len;
+    }
+    WriteSequence(out, base + anchor, ip - anchor, ip - ref, len);
+    ip += len;
+    anchor = ip;
+    if (ip < mfLimit) {
+      table[Hash(Read32(base + ip - 2))] = static_cast<uint32_t>(ip - 2 + 1);
+    }
+  }
+  WriteLastLiterals(out, base + anchor, end - anchor);
+}
+
+auto DecompressBlock(std::span<const uint8_t> in, std::span<const uint8_t> dict,
+                     std::span<uint8_t> out) -> bool {
+  const uint8_t *ip = in.data();
+  const uint8_t *iend = ip + in.size();
+  std::size_t op = 0;
+
+  auto readLength = [&](std::size_t &len) -> bool {
+    uint8_t b = 255;
+    while (b == 255) {
+      if (ip >= iend) {
+        return false;
+      }
+      b = *ip++;
+      len += b;
+    }
+    return true;
+  };
+
+  while (ip < iend) {
+    const uint8_t token = *ip++;
+    std::size_t literalLen = token >> 4;
+    if (literalLen == 15 && !readLength(literalLen)) {
+      return false;
+    }
+    if (literalLen > static_cast<std::size_t>(iend - ip) || literalLen > out.size() - op) {
+      return false;
+    }
+    std::memcpy(out.data() + op, ip, literalLen);
+    ip += literalLen;
+    op += literalLen;
+    if (ip == iend) {
+      break; // 最后一个序列只有字面量
+    }
+
+    if (iend - ip < 2) {
+      return false;
+    }
+    const std::size_t offset = ip[0] | (ip[1] << 8);
+    ip += 2;
+    std::size_t matchLen = token & 15;
+    if (matchLen == 15 && !readLength(matchLen)) {
+      return false;
+    }
+    matchLen += kMinMatch;
+    if (offset == 0 || offset > op + dict.size() || matchLen > out.size() - op) {
+      return false;
+    }
+
+    // 引用到字典的部分
+    if (offset > op) {
+      const std::size_t back = offset - op;
+      const std::size_t n = std::min(back, matchLen);
+      std::memcpy(out.data() + op, dict.data() + dict.size() - back, n);
+      op += n;
+      matchLen -= n;
+    }
+    // 可能与输出重叠，逐字节复制
+    const std::size_t from = op - offset;
+    for (std::size_t i = 0; i < matchLen; ++i) {
+      out[op + i] = out[from + i];
+    }
+    op += matchLen;
+  }
+  return op == out.size();
+}
+} // namespace
+
+auto Peek(std::span<const uint8_t> payload, Header &header) -> Format {
+  if (payload.size() < kEscapeSize || payload[0] != kMagic0 || payload[1] != kMagic1) {
+    return Format::eRaw;
+  }
+  if (payload[3] == kEscaped) {
+    return Format::eEscaped;
+  }
+  if (payload.size() < kHeaderSize || payload[3] != kVersion) {
+    return Format::eRaw;
+  }
+  header._dict = payload[2];
+  header._size = static_cast<uint32_t>(payload[4]) | (static_cast<uint32_t>(payload[5]) << 8) |
+                 (static_cast<uint32_t>(payload[6]) << 16) |
+                 (static_cast<uint32_t>(payload[7]) << 24);
+  return Format::eCompressed;
+}
+
+auto NeedsEscape(std::span<const uint8_t> payload) -> bool {
+  return payload.size() >= 2 && payload[0] == kMagic0 && payload[1] == kMagic1;
+}
+
+auto Escape(std::span<const uint8_t> src, std::vector<uint8_t> &out) -> void {
+  // 逐字节写头，initializer_list 插入在 Release 下会误报 -Wstringop-overflow
+  out.resize(kEscapeSize + src.size());
+  out[0] = kMagic0;
+  out[1] = kMagic1;
+  out[2] = 0;
+  out[3] = kEscaped;
+  if (!src.empty()) {
+    std::memcpy(out.data() + kEscapeSize, src.data(), src.size());
+  }
+}
+
+auto Encode(std::span<const uint8_t> src, std::span<const uint8_t> dict, uint8_t dictId,
+            std::vector<uint8_t> &out) -> bool {
+  if (src.size() > std::numeric_limits<uint32_t>::max()) {
+    return false;
+  }
+  const auto size = static_cast<uint32_t>(src.size());
+  out.resize(kHeaderSize);
+  out[0] = kMagic0;
+  out[1] = kMagic1;
+  out[2] = dictId;
+  out[3] = kVersion;
+  for (std::size_t i = 0; i < 4; ++i) {
+    out[4 + i] = static_cast<uint8_t>(size >> (8 * i));
+  }
+
+  if (dict.empty()) {
+    CompressBlock(src, 0, out);
+  } else {
+    // 字典放在输入之前，匹配可以回溯到字典内，缓冲区按线程复用
+    thread_local std::vector<uint8_t> window;
+    dict = dict.size() > kMaxOffset ? dict.last(kMaxOffset) : dict;
+    window.assign(dict.begin(), dict.end());
+    window.insert(window.end(), src.begin(), src.end());
+    CompressBlock(window, dict.size(), out);
+  }
+  return out.size() < src.size();
+}
+
+auto Decode(std::span<const uint8_t> payload, std::span<const uint8_t> dict,
+            std::span<uint8_t> out) -> bool {
+  Header header;
+  if (Peek(payload, header) != Format::eCompressed || header._size != out.size()) {
+    return false;
+  }
+  dict = dict.size() > kMaxOffset ? dict.last(kMaxOffset) : dict;
+  return DecompressBlock(payload.subspan(kHeaderSize), dict, out);
+}
+} // namespace dsg::compress
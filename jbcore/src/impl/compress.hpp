@@ -0,0 +1,67 @@
+/**
+ * @file compress.hpp
+ * @brief mqtt 负载压缩
+ *
+ * 块格式与 LZ4 block format 一致（对端可用 LZ4_decompress_safe_usingDict 解码），
+ * 支持预置字典：字典视为输入之前的数据，匹配可以引用字典内容。
+ * 压缩后的负载带 8 字节头：magic(2) + 字典编号(1) + 版本(1) + 原始长度(4, LE)。
+ * 未压缩的负载恰好以 magic 开头时加 4 字节转义头：magic(2) + 0 + 0，其余未压缩负载原样发送，
+ * 接收端据此区分，不会把原始负载误判为压缩格式。
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace dsg::compress {
+inline constexpr std::size_t kHeaderSize = 8;
+inline constexpr std::size_t kEscapeSize = 4;
+/// LZ4 块的最大压缩比，原始长度超过压缩数据的该倍数时头无效
+inline constexpr std::size_t kMaxRatio = 255;
+
+enum class Format {
+  eRaw,        // 未压缩
+  eEscaped,    // 未压缩，带转义头
+  eCompressed, // 压缩
+};
+
+struct Header {
+  uint8_t _dict{0}; // 0 不使用字典
+  uint32_t _size{0};
+};
+
+/// @brief 判断负载格式，压缩格式时解析头
+/// @param payload
+/// @param header
+/// @return
+auto Peek(std::span<const uint8_t> payload, Header &header) -> Format;
+
+/// @brief 未压缩的负载是否需要转义
+/// @param payload
+/// @return
+auto NeedsEscape(std::span<const uint8_t> payload) -> bool;
+
+/// @brief 写入转义头和原负载，out 复用调用方的缓冲区
+/// @param src
+/// @param out
+auto Escape(std::span<const uint8_t> src, std::vector<uint8_t> &out) -> void;
+
+/// @brief 压缩并写入头，out 复用调用方的缓冲区
+/// @param src
+/// @param dict 预置字典，可为空
+/// @param dictId 写入头的字典编号
+/// @param out
+/// @return 压缩后不比原数据小时返回 false
+auto Encode(std::span<const uint8_t> src, std::span<const uint8_t> dict, uint8_t dictId,
+            std::vector<uint8_t> &out) -> bool;
+
+/// @brief 解压，out 大小必须等于头中的原始长度
+/// @param payload
+/// @param dict 与压缩时相同的字典
+/// @param out
+/// @return
+auto Decode(std::span<const uint8_t> payload, std::span<const uint8_t> dict,
+            std::span<uint8_t> out) -> bool;
+} // namespace dsg::compress
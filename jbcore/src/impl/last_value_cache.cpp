@@ -0,0 +1,219 @@
+#include "def.hpp"
+#include "last_value_cache.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <thread>
+
+namespace dsg {
+LastValueCache::LastValueCache(std::size_t topics, std::size_t bytes)
+    : _limit{std::max<std::size_t>(topics, 1)},
+      _arenaSize{std::clamp<std::size_t>(bytes, kMinBlock, BlockSize(kClasses - 1))} {
+  // 装载率不超过 1/2，探测链保持较短
+  std::size_t cap = 2;
+  while (cap < _limit * 2) {
+    cap <<= 1;
+  }
+  _mask = cap - 1;
+  _slots = std::make_unique<Slot[]>(cap);
+  _arena = std::make_unique<uint8_t[]>(_arenaSize);
+}
+
+auto LastValueCache::Hash(std::string_view topic) -> uint64_t {
+  // 0 和 1 留给空槽和删除标记
+  auto h = static_cast<uint64_t>(std::hash<std::string_view>{}(topic));
+  return h > kTombstone ? h : h + 2;
+}
+
+auto LastValueCache::BlockClass(std::size_t size) -> uint32_t {
+  uint32_t cls = 0;
+  while (BlockSize(cls) < size) {
+    ++cls;
+  }
+  return cls;
+}
+
+auto LastValueCache::BlockSize(uint32_t cls) -> std::size_t {
+  return static_cast<std::size_t>(kMinBlock) << cls;
+}
+
+auto LastValueCache::BeginWrite(Slot &slot) -> void {
+  slot._seq.store(slot._seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+}
+
+auto LastValueCache::EndWrite(Slot &slot) -> void {
+  slot._seq.store(slot._seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+auto LastValueCache::Name(const Slot &slot) const -> std::string_view {
+  return {reinterpret_cast<const char *>(&_arena[slot._offset.load(std::memory_order_relaxed)]),
+          slot._nameLen.load(std::memory_order_relaxed)};
+}
+
+auto LastValueCache::Find(std::string_view topic, uint64_t hash, Slot *&tombstone) -> Slot * {
+  tombstone = nullptr;
+  for (std::size_t i = 0; i <= _mask; ++i) {
+    auto &slot = _slots[(hash + i) & _mask];
+    auto h = slot._hash.load(std::memory_order_relaxed);
+    if (h == kEmpty) {
+      if (!tombstone) {
+        tombstone = &slot;
+      }
+      return nullptr;
+    }
+    if (h == kTombstone) {
+      if (!tombstone) {
+        tombstone = &slot;
+      }
+    } else if (h == hash && Name(slot) == topic) {
+      return &slot;
+    }
+  }
+  return nullptr;
+}
+
+auto LastValueCache::Alloc(std::size_t size, uint32_t &cls, uint32_t &offset) -> bool {
+  cls = BlockClass(size);
+  if (cls >= kClasses) {
+    return false;
+  }
+  auto &free = _free[cls];
+  if (!free.empty()) {
+    offset = free.back();
+    free.pop_back();
+    return true;
+  }
+  if (_used + BlockSize(cls) > _arenaSize) {
+    return false;
+  }
+  offset = static_cast<uint32_t>(_used);
+  _used += BlockSize(cls);
+  return true;
+}
+
+auto LastValueCache::Free(uint32_t cls, uint32_t offset) -> void {
+  _free[cls].push_back(offset);
+}
+
+auto LastValueCache::Remove(Slot &slot) -> void {
+  BeginWrite(slot);
+  slot._hash.store(kTombstone, std::memory_order_relaxed);
+  EndWrite(slot);
+  // 序号已变化，之后块被复用时仍在读旧内容的读者会校验失败
+  Free(slot._class, slot._offset.load(std::memory_order_relaxed));
+  _count.fetch_sub(1, std::memory_order_relaxed);
+}
+
+auto LastValueCache::Update(std::string_view topic, std::span<const uint8_t> payload) -> bool {
+  const auto hash = Hash(topic);
+  const auto size = topic.size() + payload.size();
+  std::lock_guard<std::mutex> lock{_writer};
+
+  Slot *tombstone = nullptr;
+  auto slot = Find(topic, hash, tombstone);
+  if (slot && BlockSize(slot->_class) >= size) {
+    // 原块放得下，原地改写负载
+    BeginWrite(*slot);
+    auto offset = slot->_offset.load(std::memory_order_relaxed);
+    std::memcpy(&_arena[offset + topic.size()], payload.data(), payload.size());
+    slot->_payloadLen.store(static_cast<uint32_t>(payload.size()), std::memory_order_relaxed);
+    EndWrite(*slot);
+    return true;
+  }
+
+  uint32_t cls = 0;
+  uint32_t offset = 0;
+  if ((!slot && (_count.load(std::memory_order_relaxed) >= _limit || !tombstone)) ||
+      !Alloc(size, cls, offset)) {
+    if (slot) {
+      Remove(*slot); // 不能保留过期的值
+    }
+    return false;
+  }
+
+  // 新块此时不属于任何槽位，先写入内容再发布
+  std::memcpy(&_arena[offset], topic.data(), topic.size());
+  std::memcpy(&_arena[offset + topic.size()], payload.data(), payload.size());
+  if (slot) {
+    auto oldClass = slot->_class;
+    auto oldOffset = slot->_offset.load(std::memory_order_relaxed);
+    BeginWrite(*slot);
+    slot->_offset.store(offset, std::memory_order_relaxed);
+    slot->_payloadLen.store(static_cast<uint32_t>(payload.size()), std::memory_order_relaxed);
+    EndWrite(*slot);
+    slot->_class = cls;
+    Free(oldClass, oldOffset);
+    return true;
+  }
+
+  slot = tombstone;
+  BeginWrite(*slot);
+  slot->_hash.store(hash, std::memory_order_relaxed);
+  slot->_offset.store(offset, std::memory_order_relaxed);
+  slot->_nameLen.store(static_cast<uint32_t>(topic.size()), std::memory_order_relaxed);
+  slot->_payloadLen.store(static_cast<uint32_t>(payload.size()), std::memory_order_relaxed);
+  EndWrite(*slot);
+  slot->_class = cls;
+  _count.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+auto LastValueCache::Evict(const delegate<bool(std::string_view)> &remove) -> std::size_t {
+  std::lock_guard<std::mutex> lock{_writer};
+  std::size_t count = 0;
+  for (std::size_t i = 0; i <= _mask; ++i) {
+    auto &slot = _slots[i];
+    if (slot._hash.load(std::memory_order_relaxed) > kTombstone && remove(Name(slot))) {
+      Remove(slot);
+      ++count;
+    }
+  }
+  return count;
+}
+
+auto LastValueCache::Read(std::string_view topic, std::vector<uint8_t> &payload) const -> bool {
+  const auto hash = Hash(topic);
+  for (std::size_t i = 0; i <= _mask; ++i) {
+    const auto &slot = _slots[(hash + i) & _mask];
+    while (true) {
+      auto seq = slot._seq.load(std::memory_order_acquire);
+      if (seq & 1) {
+        std::this_thread::yield();
+        continue;
+      }
+      auto h = slot._hash.load(std::memory_order_relaxed);
+      bool found = false;
+      if (h == hash) {
+        auto offset = slot._offset.load(std::memory_order_relaxed);
+        std::size_t nameLen = slot._nameLen.load(std::memory_order_relaxed);
+        std::size_t payloadLen = slot._payloadLen.load(std::memory_order_relaxed);
+        // 并发改写时读到的长度可能不一致，越界的组合直接重读
+        if (offset + nameLen + payloadLen <= _arenaSize && nameLen == topic.size() &&
+            std::memcmp(&_arena[offset], topic.data(), nameLen) == 0) {
+          payload.resize(payloadLen);
+          std::memcpy(payload.data(), &_arena[offset + nameLen], payloadLen);
+          found = true;
+        }
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot._seq.load(std::memory_order_relaxed) != seq) {
+        continue;
+      }
+      if (found) {
+        return true;
+      }
+      if (h == kEmpty) {
+        return false;
+      }
+      break;
+    }
+  }
+  return false;
+}
+
+auto LastValueCache::Size() const -> std::size_t {
+  return _count.load(std::memory_order_relaxed);
+}
+} // namespace dsg
@@ -0,0 +1,92 @@
+/**
+ * @file last_value_cache.hpp
+ * @brief 按 topic 缓存最近一条消息
+ *
+ * 固定容量的开放寻址表，topic 名和负载存放在一块预分配的内存中，按 2 的幂分块复用。
+ * 每个槽位带 seqlock 序号：写者（网络线程、取消订阅）之间加锁，写入前后各递增一次序号；
+ * 读者不加锁，拷贝后校验序号，被并发改写则重读，不会阻塞写者。
+ * 槽位和内存块都不释放，读者读到过期的偏移也不会越界，只会校验失败。
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "delegate.hpp"
+
+namespace dsg {
+class LastValueCache final {
+public:
+  /// @param topics 缓存的 topic 数上限
+  /// @param bytes topic 名和负载占用的内存上限
+  LastValueCache(std::size_t topics, std::size_t bytes);
+
+  LastValueCache(const LastValueCache &) = delete;
+  LastValueCache &operator=(const LastValueCache &) = delete;
+
+  /// @brief 写入 topic 的最近一条消息
+  /// @param topic
+  /// @param payload
+  /// @return topic 数或内存达到上限时返回 false，该 topic 原有的缓存同时移除
+  auto Update(std::string_view topic, std::span<const uint8_t> payload) -> bool;
+
+  /// @brief 移除 remove 返回 true 的 topic
+  /// @param remove
+  /// @return 移除的个数
+  auto Evict(const delegate<bool(std::string_view)> &remove) -> std::size_t;
+
+  /// @brief 读取 topic 的最近一条消息，无锁
+  /// @param topic
+  /// @param payload 输出，复用调用方缓冲区
+  /// @return 没有缓存返回 false
+  auto Read(std::string_view topic, std::vector<uint8_t> &payload) const -> bool;
+
+  /// @brief 当前缓存的 topic 数
+  auto Size() const -> std::size_t;
+
+private:
+  static constexpr uint64_t kEmpty = 0;
+  static constexpr uint64_t kTombstone = 1;
+  static constexpr uint32_t kMinBlock = 64;
+  static constexpr std::size_t kClasses = 26; // 64B ~ 2GB
+
+  struct Slot {
+    std::atomic<uint32_t> _seq{0}; // 奇数表示正在写
+    uint32_t _class{0};            // 内存块大小等级，只有写者访问
+    std::atomic<uint64_t> _hash{kEmpty};
+    std::atomic<uint32_t> _offset{0}; // 块内依次存放 topic 名和负载
+    std::atomic<uint32_t> _nameLen{0};
+    std::atomic<uint32_t> _payloadLen{0};
+  };
+
+  static auto Hash(std::string_view topic) -> uint64_t;
+  static auto BlockClass(std::size_t size) -> uint32_t;
+  static auto BlockSize(uint32_t cls) -> std::size_t;
+
+  auto Find(std::string_view topic, uint64_t hash, Slot *&tombstone) -> Slot *;
+  auto Alloc(std::size_t size, uint32_t &cls, uint32_t &offset) -> bool;
+  auto Free(uint32_t cls, uint32_t offset) -> void;
+  auto Remove(Slot &slot) -> void;
+  auto Name(const Slot &slot) const -> std::string_view;
+
+  static auto BeginWrite(Slot &slot) -> void;
+  static auto EndWrite(Slot &slot) -> void;
+
+private:
+  std::unique_ptr<Slot[]> _slots;
+  std::size_t _mask;
+  std::size_t _limit;
+  std::atomic<std::size_t> _count{0};
+  std::unique_ptr<uint8_t[]> _arena;
+  std::size_t _arenaSize;
+  std::size_t _used{0};
+  std::array<std::vector<uint32_t>, kClasses> _free{}; // 按大小等级的空闲块
+  std::mutex _writer;
+};
+} // namespace dsg
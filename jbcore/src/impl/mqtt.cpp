@@ -1,5 +1,11 @@
 #include "def.hpp"
 #include "mqtt.hpp"
+#include "compress.hpp"
+#include "last_value_cache.hpp"
+#include "mqtt_dispatcher.hpp"
+#include "mqtt_metrics.hpp"
+#include "mqtt_scheduler.hpp"
+#include "topic_router.hpp"
 
 #include <MQTTAsync.h>
 
@@ -40,19 +46,166 @@ public:
   auto IsConnected() -> bool override;
   auto Send(const Topic &topic, const std::string &textMsg) -> Result override;
   auto Send(const Topic &topic, const std::vector<uint8_t> &payload) -> Result override;
+  auto Send(const Topic &topic, std::span<const uint8_t> payload, const SendOptions &options)
+      -> Result override;
   auto Subscribe(const Topic &topic) -> Result override;
+  auto Subscribe(const Topic &topic, MessageHandler handler) -> Result override;
   auto Unsubscribe(const Topic &topic) -> Result override;
+  auto Subscribe(std::span<const Topic> topics) -> Result override;
+  auto Unsubscribe(std::span<const Topic> topics) -> Result override;
+  auto LastValue(std::string_view topic, std::vector<uint8_t> &payload) -> bool override;
+  auto GetDispatchStats() -> DispatchStats override;
+  auto GetScheduleStats() -> ScheduleStats override;
+  auto GetMetrics() -> Metrics override;
 
   auto getConfig() const -> const Config &;
+  auto metrics() -> MqttMetrics &;
+
+  /// @brief 是否使用 mqtt 5
+  auto IsV5() const -> bool;
+
+  /// @brief 是否启用了回调分发线程
+  auto HasDispatcher() const -> bool;
+
+  /// @brief paho 应答一次发送（成功或失败），腾出发送调度的在途窗口
+  auto SendAcked() -> void;
+
+  /// @brief 投递消息事件，未启用分发时直接执行；队列满时返回 false
+  /// @param ev
+  /// @return
+  auto Post(MqttEvent &ev) -> bool;
+
+  /// @brief 投递其余事件，未启用分发时直接执行；不丢弃，队列满时排队或等待
+  /// @param ev
+  auto Queue(MqttEvent &ev) -> void;
+
+  /// @brief 执行事件对应的用户回调
+  /// @param ev
+  auto Dispatch(MqttEvent &ev) -> void;
+
+  /// @brief 消息按订阅分发，未匹配的交给 _messageArrivedCallback
+  /// @param topic
+  /// @param qos
+  /// @param payload 已解压的负载
+  auto Deliver(std::string_view topic, Qos qos, std::span<uint8_t> payload) -> void;
+
+  /// @brief 更新 topic 的最近一条消息，未启用缓存时忽略
+  /// @param topic
+  /// @param payload 收到的原始负载，压缩负载读取时再解压
+  auto CacheLastValue(std::string_view topic, std::span<const uint8_t> payload) -> void;
+
+  /// @brief 压缩负载解压到 buf，转义负载去掉转义头，其余原样返回
+  /// @param payload
+  /// @param buf
+  /// @return 指向 buf 或 payload 内部
+  auto Inflate(std::span<uint8_t> payload, std::vector<uint8_t> &buf) -> std::span<uint8_t>;
+
+  /// @brief 按记录的订阅集合批量重新订阅
+  auto RestoreSubscriptions() -> Result;
+
+  /// @brief 新连接建立时清空 topic alias 映射，alias 只在一个连接内有效
+  /// @param aliasMax broker 允许的最大 alias，0 表示不支持，-1 只清空映射、沿用原来的最大值
+  auto ResetTopicAlias(int aliasMax) -> void;
+
+  /// @brief 由 alias 查找 topic 名，用于只带 alias 的发送回调
+  /// @param alias
+  /// @return
+  auto AliasTopic(int alias) -> std::string;
 
 private:
   auto InitClient() -> Result;
   auto DeInitClient() -> void;
-  auto Send(const Topic &topic, void *payload, int payloadLen) -> Result;
+  auto Send(const Topic &topic, void *payload, int payloadLen, const SendOptions &options)
+      -> Result;
+  /// @brief 交给 paho 发送并记录指标
+  auto Publish(const char *dest, MQTTAsync_message &msg, MQTTAsync_responseOptions &opts) -> int;
+
+  /// @brief 为 qos0 topic 分配 alias，返回 0 表示不使用 alias
+  /// @param topic
+  /// @param first 是否首次使用该 alias，首次需要同时携带 topic 名
+  /// @return
+  auto AcquireTopicAlias(const std::string &topic, bool &first) -> int;
+  auto ReleaseTopicAlias(const std::string &topic) -> void;
+  auto CompressDict(int id) const -> std::span<const uint8_t>;
+  auto SubscribeChunked(std::span<const Topic> topics) -> Result;
+  auto SubscribeMany(std::span<const Topic> topics) -> Result;
+  auto UnsubscribeMany(std::span<const Topic> topics) -> Result;
+  /// @brief 移除不再匹配任何订阅的缓存，调用时持有 _subscriptionsMutex
+  auto EvictLastValues() -> void;
 
 private:
   Config _config;
   void *_client;
+  std::unique_ptr<MqttDispatcher> _dispatcher;
+  std::unique_ptr<MqttScheduler> _scheduler;
+  std::unique_ptr<LastValueCache> _lastValues;
+  MqttMetrics _metrics;
+  std::atomic<bool> _lastValueFull{false}; // 缓存满只告警一次
+  TopicRouter _router;
+
+  /// 当前应生效的订阅集合，topic -> qos
+  std::map<std::string, Qos, std::less<>> _subscriptions;
+  std::mutex _subscriptionsMutex;
+
+  /// mqtt 5 topic alias
+  struct TopicAlias {
+    int _alias{0};
+    uint32_t _count{0};
+  };
+  std::unordered_map<std::string, TopicAlias, StrHash, std::equal_to<>> _aliases;
+  std::vector<std::string> _aliasTopics; // alias - 1 -> topic
+  int _aliasMax{0};
+  std::mutex _aliasMutex;
+};
+
+//////////////////////////////////////////
+class MqttMessage : public interface_wrapper<Mqtt::Message> {
+public:
+  /// @brief 接管 paho 分配的消息和 topic
+  /// @param topicName
+  /// @param topicLen
+  /// @param m
+  MqttMessage(char *topicName, std::size_t topicLen, MQTTAsync_message *m);
+  ~MqttMessage();
+
+  MqttMessage(const MqttMessage &) = delete;
+  MqttMessage &operator=(const MqttMessage &) = delete;
+
+  /// 每条消息都要创建一个对象，网络线程分配、分发线程释放，用无锁空闲链表复用内存
+  static auto operator new(std::size_t size) -> void *;
+  static auto operator delete(void *p, std::size_t size) -> void;
+  /// @brief 预先分配空闲块，使在途消息数达到峰值时也不再分配；各客户端共用空闲链表，容量累加
+  /// @param count 本客户端的在途消息上限
+  static auto Reserve(std::size_t count) -> void;
+
+  auto topic() const -> std::string_view override;
+  auto qos() const -> Mqtt::Qos override;
+  auto retained() const -> bool override;
+  auto payload() const -> std::span<uint8_t> override;
+  auto userProperty(std::string_view name) const -> std::string_view override;
+
+  /// @brief 替换为解压后的负载，指向 Buffer() 或原负载内部
+  /// @param payload
+  auto SetPayload(std::span<uint8_t> payload) -> void;
+
+  /// @brief 解压缓冲区，从空闲缓冲区中取，消息释放时归还
+  auto Buffer() -> std::vector<uint8_t> &;
+
+  /// @brief 放弃所有权，析构时不再释放
+  auto Detach() -> void;
+
+private:
+  char *_topicName;
+  std::size_t _topicLen;
+  MQTTAsync_message *_m;
+  std::span<uint8_t> _payload;
+  std::vector<uint8_t> _buffer;
+};
+
+/// @brief 批量订阅/取消订阅的请求上下文，在结果回调中释放
+struct MqttBatch {
+  MqttImpl *_mqtt;
+  std::vector<Mqtt::Topic> _topics;
 };
 
 ////////////////////////////////////////////
@@ -77,6 +230,68 @@ static std::string to_string(MQTTAsync_failureData *response) {
   return ss.str();
 }
 
+static std::string to_string(MQTTAsync_failureData5 *response) {
+  if (!response)
+    return "";
+
+  std::stringstream ss;
+  ss << "{token:" << response->token << ", code:" << response->code
+     << ", reason:" << MQTTReasonCode_toString(response->reasonCode);
+  if (response->message) {
+    ss << ", msg:" << response->message;
+  }
+  ss << "}";
+  return ss.str();
+}
+
+/// @brief 按协议版本设置结果回调，mqtt 5 必须使用 *5 版本的回调
+template <typename Opts>
+inline auto SetCallbacks(Opts &opts, bool v5, MQTTAsync_onSuccess *onSuccess,
+                         MQTTAsync_onFailure *onFailure, MQTTAsync_onSuccess5 *onSuccess5,
+                         MQTTAsync_onFailure5 *onFailure5) -> void {
+  if (v5) {
+    opts.onSuccess5 = onSuccess5;
+    opts.onFailure5 = onFailure5;
+  } else {
+    opts.onSuccess = onSuccess;
+    opts.onFailure = onFailure;
+  }
+}
+
+/// @brief MQTTProperties 的 RAII 封装
+class Properties {
+public:
+  Properties() = default;
+  ~Properties() {
+    MQTTProperties_free(&_props);
+  }
+
+  Properties(const Properties &) = delete;
+  Properties &operator=(const Properties &) = delete;
+
+  auto AddInt(MQTTPropertyCodes code, int value) -> void {
+    MQTTProperty prop{};
+    prop.identifier = code;
+    prop.value.integer4 = value;
+    MQTTProperties_add(&_props, &prop);
+  }
+
+  auto AddUser(const std::string &name, const std::string &value) -> void {
+    MQTTProperty prop{};
+    prop.identifier = MQTTPROPERTY_CODE_USER_PROPERTY;
+    prop.value.data = {static_cast<int>(name.size()), const_cast<char *>(name.data())};
+    prop.value.value = {static_cast<int>(value.size()), const_cast<char *>(value.data())};
+    MQTTProperties_add(&_props, &prop);
+  }
+
+  auto get() const -> const MQTTProperties & {
+    return _props;
+  }
+
+private:
+  MQTTProperties _props = MQTTProperties_initializer;
+};
+
 enum class SuccessType {
   eSub,
   eSubMany,
@@ -84,7 +299,8 @@ enum class SuccessType {
   eConnect,
 };
 
-static std::string to_string(MQTTAsync_successData *response, SuccessType type) {
+static std::string to_string(MQTTAsync_successData *response, SuccessType type,
+                             int count = 1) {
   if (!response)
     return "";
 
@@ -96,8 +312,12 @@ static std::string to_string(MQTTAsync_successData *response, SuccessType type)
     ss << ", qos:" << response->alt.qos;
     break;
   case SuccessType::eSubMany:
-    if (response->alt.qosList) {
-      // todo
+    if (count > 1 && response->alt.qosList) {
+      ss << ", qos:[";
+      for (int i = 0; i < count; ++i) {
+        ss << (i ? "," : "") << response->alt.qosList[i];
+      }
+      ss << "]";
     } else {
       ss << ", qos:" << response->alt.qos;
     }
@@ -123,16 +343,93 @@ static std::string to_string(MQTTAsync_successData *response, SuccessType type)
 }
 } // namespace utils
 
+//////////////////////////////////////////
+namespace {
+constexpr std::size_t kMaxPooledBuffer = 64 << 10; // 更大的缓冲区用完即释放
+constexpr std::size_t kPrefillCount = 256;          // 启用分发、调度时预先放入的空闲缓冲区数
+constexpr std::size_t kPrefillText = 128;           // 预置 topic 名缓冲区的容量
+constexpr std::size_t kPrefillPayload = 1024;       // 预置发送缓冲区的容量
+
+/// @brief MqttMessage 空闲块，进程退出时不释放
+auto MessageFreeList() -> utils::free_list<void *> & {
+  static auto *freeList = new utils::free_list<void *>(1024);
+  return *freeList;
+}
+
+/// @brief 空闲的解压、发送缓冲区，进程退出时不释放
+auto BufferFreeList() -> utils::free_list<std::vector<uint8_t>> & {
+  static auto *freeList = new utils::free_list<std::vector<uint8_t>>(256);
+  return *freeList;
+}
+
+/// @brief 空闲的 topic 名、结果说明字符串，进程退出时不释放
+auto TextFreeList() -> utils::free_list<std::string> & {
+  static auto *freeList = new utils::free_list<std::string>(256);
+  return *freeList;
+}
+
+/// @brief 复制到空闲缓冲区中，容量足够时不分配
+auto PooledCopy(std::span<const uint8_t> data) -> std::vector<uint8_t> {
+  std::vector<uint8_t> buf;
+  BufferFreeList().pop(buf);
+  buf.assign(data.begin(), data.end());
+  return buf;
+}
+
+auto PooledCopy(std::string_view text) -> std::string {
+  std::string s;
+  if (text.size() >= s.capacity()) {
+    TextFreeList().pop(s);
+  }
+  s.assign(text);
+  return s;
+}
+
+auto Recycle(std::vector<uint8_t> &&buf) -> void {
+  if (buf.capacity() > 0 && buf.capacity() <= kMaxPooledBuffer) {
+    BufferFreeList().push(std::move(buf));
+  }
+}
+
+/// @brief 短字符串不占堆内存，不必回收
+auto Recycle(std::string &&s) -> void {
+  if (s.capacity() > std::string{}.capacity() && s.capacity() <= kMaxPooledBuffer) {
+    TextFreeList().push(std::move(s));
+  }
+}
+
+/// @brief 预先放入容量为 bytes 的空闲缓冲区，直到共有 count 个，
+/// 在途数量首次达到峰值时也不再分配
+template <typename T>
+auto Prefill(utils::free_list<T> &freeList, std::size_t count, std::size_t bytes) -> void {
+  freeList.reserve(count);
+  while (freeList.size() < count) {
+    T buf;
+    buf.reserve(bytes);
+    if (!freeList.push(std::move(buf))) {
+      break;
+    }
+  }
+}
+} // namespace
+
 namespace cb {
+/// @brief 投递消息以外的事件，不丢弃；队列满时由分发器排队或等待，不在网络线程执行回调
+/// @param mqtt
+/// @param ev
+static void QueueEvent(MqttImpl *mqtt, MqttEvent &ev) {
+  mqtt->Queue(ev);
+}
+
 /// @brief 连接断开回调
 /// @param context
 /// @param cause
 static void OnConnectionLost(void *context, char *cause) {
   auto mqtt = static_cast<MqttImpl *>(context);
-  auto cb = mqtt->getConfig()._connectLostCallback;
-  if (cb) {
-    cb(cause ? cause : "");
-  }
+  mqtt->metrics().ConnectionLost();
+  mqtt->ResetTopicAlias(-1);
+  MqttEvent ev{._kind = MqttEvent::Kind::eConnectionLost, ._msg = cause ? cause : ""};
+  QueueEvent(mqtt, ev);
 }
 
 /// @brief 接收消息回调
@@ -143,13 +440,31 @@ static void OnConnectionLost(void *context, char *cause) {
 /// @return
 static int OnMessageArrived(void *context, char *topicName, int topicLen, MQTTAsync_message *m) {
   auto mqtt = static_cast<MqttImpl *>(context);
-  auto cb = mqtt->getConfig()._messageArrivedCallback;
-  if (cb) {
-    cb({{topicName, static_cast<std::size_t>(topicLen)}, utils::ToQos(m->qos)},
-       {static_cast<uint8_t *>(m->payload), static_cast<std::size_t>(m->payloadlen)});
+  auto topicSize = topicLen > 0 ? static_cast<std::size_t>(topicLen) : std::strlen(topicName);
+  std::string_view topic{topicName, topicSize};
+  std::span<uint8_t> payload{static_cast<uint8_t *>(m->payload),
+                             static_cast<std::size_t>(m->payloadlen)};
+  if (!mqtt->HasDispatcher() && !mqtt->getConfig()._messageCallback) {
+    mqtt->metrics().Received(payload.size());
+    mqtt->CacheLastValue(topic, payload);
+    thread_local std::vector<uint8_t> inflated;
+    mqtt->Deliver(topic, utils::ToQos(m->qos), mqtt->Inflate(payload, inflated));
+    MQTTAsync_freeMessage(&m);
+    MQTTAsync_free(topicName);
+    return 1;
+  }
+
+  // 消息所有权转交给 MqttMessage，负载不拷贝
+  auto message = make_ptr<MqttMessage>(topicName, topicSize, m);
+  MqttEvent ev{._kind = MqttEvent::Kind::eMessageArrived, ._success = true, ._message = message};
+  if (!mqtt->Post(ev)) {
+    // 队列满，交还所有权，返回 0 由 paho 稍后重新投递，网络线程不阻塞
+    message->Detach();
+    return 0;
   }
-  MQTTAsync_freeMessage(&m);
-  MQTTAsync_free(topicName);
+  // 投递成功后才计数、缓存，paho 重新投递的消息不重复计入；message 仍持有负载
+  mqtt->metrics().Received(payload.size());
+  mqtt->CacheLastValue(topic, payload);
   return 1;
 }
 
@@ -160,16 +475,40 @@ static void OnDeliveryComplete(void *context, MQTTAsync_token token) {
   // DSG_LOG("DeliveryComplete token:" << token);
 }
 
+/// @brief 连接建立后的处理，v3 v5 共用
+/// @param mqtt
+/// @param sessionPresent
+static void Connected(MqttImpl *mqtt, bool sessionPresent) {
+  mqtt->metrics().Connected();
+  // 自动重连也会回调这里，broker 没有保留会话时在用户回调之前恢复订阅
+  if (mqtt->getConfig()._restoreSubscriptions && !sessionPresent) {
+    mqtt->RestoreSubscriptions();
+  }
+  MqttEvent ev{._kind = MqttEvent::Kind::eConnect, ._success = true};
+  QueueEvent(mqtt, ev);
+}
+
+/// @brief 连接建立回调，paho 只在首次连接时调用 onSuccess，自动重连和 ReConnect 只回调这里
+/// @param context
+/// @param cause
+static void OnConnected(void *context, char *cause) {
+  if (!cause || std::string_view(cause) != "automatic reconnect") {
+    return; // 已由 onSuccess 处理
+  }
+  auto mqtt = static_cast<MqttImpl *>(context);
+  // 拿不到 CONNACK，alias 上限沿用上次连接的值；也不知道 broker 是否保留了会话，
+  // 按没有会话恢复订阅，重复订阅没有副作用
+  mqtt->ResetTopicAlias(-1);
+  Connected(mqtt, false);
+}
+
 /// @brief 连接成功回调
 /// @param context
 /// @param response
 static void OnConnect(void *context, MQTTAsync_successData *response) {
   // DSG_LOG("OnConnect:" << to_string(response, SuccessType::eConnect));
   auto mqtt = static_cast<MqttImpl *>(context);
-  auto cb = mqtt->getConfig()._connectCallback;
-  if (cb) {
-    cb(true, "");
-  }
+  Connected(mqtt, response && response->alt.connect.sessionPresent);
 }
 
 /// @brief 连接失败回调
@@ -177,10 +516,8 @@ static void OnConnect(void *context, MQTTAsync_successData *response) {
 /// @param response
 static void OnConnectFailure(void *context, MQTTAsync_failureData *response) {
   auto mqtt = static_cast<MqttImpl *>(context);
-  auto cb = mqtt->getConfig()._connectCallback;
-  if (cb) {
-    cb(false, utils::to_string(response));
-  }
+  MqttEvent ev{._kind = MqttEvent::Kind::eConnect, ._msg = utils::to_string(response)};
+  QueueEvent(mqtt, ev);
 }
 
 /// @brief 断连成功回调
@@ -189,10 +526,8 @@ static void OnConnectFailure(void *context, MQTTAsync_failureData *response) {
 static void OnDisconnect(void *context, MQTTAsync_successData *response) {
   // DSG_LOG("OnDisconnect:" << to_string(response, SuccessType::eConnect));
   auto mqtt = static_cast<MqttImpl *>(context);
-  auto cb = mqtt->getConfig()._disconnectCallback;
-  if (cb) {
-    cb(true, "");
-  }
+  MqttEvent ev{._kind = MqttEvent::Kind::eDisconnect, ._success = true};
+  QueueEvent(mqtt, ev);
 }
 
 /// @brief 断连失败回调
@@ -200,10 +535,34 @@ static void OnDisconnect(void *context, MQTTAsync_successData *response) {
 /// @param response
 static void OnDisconnectFailure(void *context, MQTTAsync_failureData *response) {
   auto mqtt = static_cast<MqttImpl *>(context);
-  auto cb = mqtt->getConfig()._disconnectCallback;
-  if (cb) {
-    cb(false, utils::to_string(response));
+  MqttEvent ev{._kind = MqttEvent::Kind::eDisconnect, ._msg = utils::to_string(response)};
+  QueueEvent(mqtt, ev);
+}
+
+/// @brief 发送结果，先记录指标；未设置回调时直接返回，未启用分发时在当前线程回调
+/// @param mqtt
+/// @param success
+/// @param token
+/// @param topic
+/// @param msg
+static void SendDone(MqttImpl *mqtt, bool success, MQTTAsync_token token, Mqtt::TopicView topic,
+                     std::string_view msg) {
+  mqtt->metrics().Acked(success, token);
+  mqtt->SendAcked();
+  const auto &callback = mqtt->getConfig()._sendCallback;
+  if (!callback) {
+    return;
+  }
+  if (!mqtt->HasDispatcher()) {
+    callback(success, topic, msg);
+    return;
   }
+  // topic 名只在回调内有效，复制到空闲字符串中，Dispatch 回调后归还
+  MqttEvent ev{._kind = MqttEvent::Kind::eSend,
+               ._success = success,
+               ._topic = {PooledCopy(topic._name), topic._qos},
+               ._msg = PooledCopy(msg)};
+  QueueEvent(mqtt, ev);
 }
 
 /// @brief 发送成功回调
@@ -211,22 +570,17 @@ static void OnDisconnectFailure(void *context, MQTTAsync_failureData *response)
 /// @param response
 static void OnSend(void *context, MQTTAsync_successData *response) {
   // DSG_LOG("OnSend:" << to_string(response, SuccessType::ePub));
-  auto mqtt = static_cast<MqttImpl *>(context);
-  auto cb = mqtt->getConfig()._sendCallback;
-  if (cb) {
-    cb(true, {response->alt.pub.destinationName, utils::ToQos(response->alt.qos)}, "");
-  }
+  auto dest = response->alt.pub.destinationName;
+  SendDone(static_cast<MqttImpl *>(context), true, response->token,
+           {dest ? dest : "", utils::ToQos(response->alt.qos)}, {});
 }
 
 /// @brief 发送失败回调
 /// @param context
 /// @param response
 static void OnSendFailure(void *context, MQTTAsync_failureData *response) {
-  auto mqtt = static_cast<MqttImpl *>(context);
-  auto cb = mqtt->getConfig()._sendCallback;
-  if (cb) {
-    cb(false, {}, utils::to_string(response));
-  }
+  SendDone(static_cast<MqttImpl *>(context), false, response ? response->token : 0, {},
+           utils::to_string(response));
 }
 
 /// @brief 订阅成功回调
@@ -235,10 +589,8 @@ static void OnSendFailure(void *context, MQTTAsync_failureData *response) {
 static void OnSubscribe(void *context, MQTTAsync_successData *response) {
   // DSG_LOG("OnSubscribe:" << to_string(response, SuccessType::eSub));
   auto mqtt = static_cast<MqttImpl *>(context);
-  auto cb = mqtt->getConfig()._subscribeCallback;
-  if (cb) {
-    cb(true, {}, "");
-  }
+  MqttEvent ev{._kind = MqttEvent::Kind::eSubscribe, ._success = true};
+  QueueEvent(mqtt, ev);
 }
 
 /// @brief 订阅失败回调
@@ -246,10 +598,8 @@ static void OnSubscribe(void *context, MQTTAsync_successData *response) {
 /// @param response
 static void OnSubscribeFailure(void *context, MQTTAsync_failureData *response) {
   auto mqtt = static_cast<MqttImpl *>(context);
-  auto cb = mqtt->getConfig()._subscribeCallback;
-  if (cb) {
-    cb(false, {}, utils::to_string(response));
-  }
+  MqttEvent ev{._kind = MqttEvent::Kind::eSubscribe, ._msg = utils::to_string(response)};
+  QueueEvent(mqtt, ev);
 }
 
 /// @brief 取消订阅成功
@@ -258,36 +608,368 @@ static void OnSubscribeFailure(void *context, MQTTAsync_failureData *response) {
 static void OnUnsubscribe(void *context, MQTTAsync_successData *response) {
   // DSG_LOG("OnUnSubscribe:" << to_string(response, SuccessType::eSub));
   auto mqtt = static_cast<MqttImpl *>(context);
-  auto cb = mqtt->getConfig()._unsubscribeCallback;
-  if (cb) {
-    cb(true, {}, "");
-  }
+  MqttEvent ev{._kind = MqttEvent::Kind::eUnsubscribe, ._success = true};
+  QueueEvent(mqtt, ev);
 }
 
 static void OnUnsubscribeFailure(void *context, MQTTAsync_failureData *response) {
   auto mqtt = static_cast<MqttImpl *>(context);
-  auto cb = mqtt->getConfig()._unsubscribeCallback;
-  if (cb) {
-    cb(false, {}, utils::to_string(response));
+  MqttEvent ev{._kind = MqttEvent::Kind::eUnsubscribe, ._msg = utils::to_string(response)};
+  QueueEvent(mqtt, ev);
+}
+
+/// @brief 按 broker 返回的结果码拆分批量订阅结果，>= 0x80 为失败，v3 v5 共用
+/// @param batch
+/// @param code 第 i 个 topic 的结果码
+/// @param reason 有 topic 被拒绝时的说明
+template <typename F>
+static void SubscribeManyDone(MqttBatch &batch, F &&code,
+                              std::string reason = "rejected by broker") {
+  auto &topics = batch._topics;
+  const auto count = static_cast<int>(topics.size());
+
+  MqttEvent granted{._kind = MqttEvent::Kind::eSubscribeMany, ._success = true};
+  MqttEvent rejected{._kind = MqttEvent::Kind::eSubscribeMany, ._msg = std::move(reason)};
+  for (int i = 0; i < count; ++i) {
+    auto qos = code(i);
+    if (qos >= 0x80) {
+      rejected._topics.push_back(std::move(topics[i]));
+    } else {
+      granted._topics.push_back({std::move(topics[i]._name), utils::ToQos(qos)});
+    }
   }
+  if (!granted._topics.empty()) {
+    QueueEvent(batch._mqtt, granted);
+  }
+  if (!rejected._topics.empty()) {
+    QueueEvent(batch._mqtt, rejected);
+  }
+}
+
+/// @brief 批量订阅成功回调，按 topic 给出 broker 授予的 qos
+/// @param context
+/// @param response
+static void OnSubscribeMany(void *context, MQTTAsync_successData *response) {
+  std::unique_ptr<MqttBatch> batch{static_cast<MqttBatch *>(context)};
+  const auto count = static_cast<int>(batch->_topics.size());
+  SubscribeManyDone(
+      *batch,
+      [&](int i) {
+        return count > 1 && response->alt.qosList ? response->alt.qosList[i] : response->alt.qos;
+      },
+      "rejected by broker, " + utils::to_string(response, utils::SuccessType::eSubMany, count));
+}
+
+/// @brief 批量订阅失败回调
+/// @param context
+/// @param response
+static void OnSubscribeManyFailure(void *context, MQTTAsync_failureData *response) {
+  std::unique_ptr<MqttBatch> batch{static_cast<MqttBatch *>(context)};
+  MqttEvent ev{._kind = MqttEvent::Kind::eSubscribeMany,
+               ._topics = std::move(batch->_topics),
+               ._msg = utils::to_string(response)};
+  QueueEvent(batch->_mqtt, ev);
+}
+
+/// @brief 批量取消订阅成功回调
+/// @param context
+/// @param response
+static void OnUnsubscribeMany(void *context, MQTTAsync_successData *response) {
+  std::unique_ptr<MqttBatch> batch{static_cast<MqttBatch *>(context)};
+  MqttEvent ev{._kind = MqttEvent::Kind::eUnsubscribeMany,
+               ._success = true,
+               ._topics = std::move(batch->_topics)};
+  QueueEvent(batch->_mqtt, ev);
+}
+
+static void OnUnsubscribeManyFailure(void *context, MQTTAsync_failureData *response) {
+  std::unique_ptr<MqttBatch> batch{static_cast<MqttBatch *>(context)};
+  MqttEvent ev{._kind = MqttEvent::Kind::eUnsubscribeMany,
+               ._topics = std::move(batch->_topics),
+               ._msg = utils::to_string(response)};
+  QueueEvent(batch->_mqtt, ev);
+}
+
+////////////////////////////////////////////
+/// mqtt 5
+
+/// @brief 连接成功回调
+/// @param context
+/// @param response
+static void OnConnect5(void *context, MQTTAsync_successData5 *response) {
+  auto mqtt = static_cast<MqttImpl *>(context);
+  auto aliasMax = response ? MQTTProperties_getNumericValue(
+                                 &response->properties, MQTTPROPERTY_CODE_TOPIC_ALIAS_MAXIMUM)
+                           : 0;
+  mqtt->ResetTopicAlias(aliasMax > 0 ? aliasMax : 0);
+  Connected(mqtt, response && response->alt.connect.sessionPresent);
+}
+
+static void OnConnectFailure5(void *context, MQTTAsync_failureData5 *response) {
+  auto mqtt = static_cast<MqttImpl *>(context);
+  MqttEvent ev{._kind = MqttEvent::Kind::eConnect, ._msg = utils::to_string(response)};
+  QueueEvent(mqtt, ev);
+}
+
+static void OnDisconnect5(void *context, MQTTAsync_successData5 *response) {
+  auto mqtt = static_cast<MqttImpl *>(context);
+  MqttEvent ev{._kind = MqttEvent::Kind::eDisconnect, ._success = true};
+  QueueEvent(mqtt, ev);
+}
+
+static void OnDisconnectFailure5(void *context, MQTTAsync_failureData5 *response) {
+  auto mqtt = static_cast<MqttImpl *>(context);
+  MqttEvent ev{._kind = MqttEvent::Kind::eDisconnect, ._msg = utils::to_string(response)};
+  QueueEvent(mqtt, ev);
+}
+
+/// @brief 发送成功回调，只带 alias 的消息由 alias 还原 topic 名
+/// @param context
+/// @param response
+static void OnSend5(void *context, MQTTAsync_successData5 *response) {
+  auto mqtt = static_cast<MqttImpl *>(context);
+  auto dest = response->alt.pub.destinationName;
+  Mqtt::TopicView topic{dest ? dest : "", utils::ToQos(response->alt.pub.message.qos)};
+  std::string aliasTopic;
+  if (topic._name.empty() && mqtt->getConfig()._sendCallback) {
+    auto alias =
+        MQTTProperties_getNumericValue(&response->properties, MQTTPROPERTY_CODE_TOPIC_ALIAS);
+    if (alias > 0) {
+      aliasTopic = mqtt->AliasTopic(alias);
+      topic._name = aliasTopic;
+    }
+  }
+  SendDone(mqtt, true, response->token, topic, {});
+}
+
+static void OnSendFailure5(void *context, MQTTAsync_failureData5 *response) {
+  SendDone(static_cast<MqttImpl *>(context), false, response ? response->token : 0, {},
+           utils::to_string(response));
+}
+
+static void OnSubscribe5(void *context, MQTTAsync_successData5 *response) {
+  auto mqtt = static_cast<MqttImpl *>(context);
+  MqttEvent ev{._kind = MqttEvent::Kind::eSubscribe};
+  if (response->reasonCode >= MQTTREASONCODE_UNSPECIFIED_ERROR) {
+    ev._msg = MQTTReasonCode_toString(response->reasonCode);
+  } else {
+    ev._success = true;
+  }
+  QueueEvent(mqtt, ev);
+}
+
+static void OnSubscribeFailure5(void *context, MQTTAsync_failureData5 *response) {
+  auto mqtt = static_cast<MqttImpl *>(context);
+  MqttEvent ev{._kind = MqttEvent::Kind::eSubscribe, ._msg = utils::to_string(response)};
+  QueueEvent(mqtt, ev);
+}
+
+static void OnUnsubscribe5(void *context, MQTTAsync_successData5 *response) {
+  auto mqtt = static_cast<MqttImpl *>(context);
+  MqttEvent ev{._kind = MqttEvent::Kind::eUnsubscribe, ._success = true};
+  QueueEvent(mqtt, ev);
+}
+
+static void OnUnsubscribeFailure5(void *context, MQTTAsync_failureData5 *response) {
+  auto mqtt = static_cast<MqttImpl *>(context);
+  MqttEvent ev{._kind = MqttEvent::Kind::eUnsubscribe, ._msg = utils::to_string(response)};
+  QueueEvent(mqtt, ev);
+}
+
+/// @brief 批量订阅成功回调，mqtt 5 的结果码即授予的 qos
+/// @param context
+/// @param response
+static void OnSubscribeMany5(void *context, MQTTAsync_successData5 *response) {
+  std::unique_ptr<MqttBatch> batch{static_cast<MqttBatch *>(context)};
+  auto &sub = response->alt.sub;
+  SubscribeManyDone(*batch, [&](int i) {
+    return static_cast<int>(sub.reasonCodes && i < sub.reasonCodeCount ? sub.reasonCodes[i]
+                                                                       : response->reasonCode);
+  });
+}
+
+static void OnSubscribeManyFailure5(void *context, MQTTAsync_failureData5 *response) {
+  std::unique_ptr<MqttBatch> batch{static_cast<MqttBatch *>(context)};
+  MqttEvent ev{._kind = MqttEvent::Kind::eSubscribeMany,
+               ._topics = std::move(batch->_topics),
+               ._msg = utils::to_string(response)};
+  QueueEvent(batch->_mqtt, ev);
+}
+
+static void OnUnsubscribeMany5(void *context, MQTTAsync_successData5 *response) {
+  std::unique_ptr<MqttBatch> batch{static_cast<MqttBatch *>(context)};
+  MqttEvent ev{._kind = MqttEvent::Kind::eUnsubscribeMany,
+               ._success = true,
+               ._topics = std::move(batch->_topics)};
+  QueueEvent(batch->_mqtt, ev);
+}
+
+static void OnUnsubscribeManyFailure5(void *context, MQTTAsync_failureData5 *response) {
+  std::unique_ptr<MqttBatch> batch{static_cast<MqttBatch *>(context)};
+  MqttEvent ev{._kind = MqttEvent::Kind::eUnsubscribeMany,
+               ._topics = std::move(batch->_topics),
+               ._msg = utils::to_string(response)};
+  QueueEvent(batch->_mqtt, ev);
 }
 } // namespace cb
 
+//////////////////////////////////////////
+MqttMessage::MqttMessage(char *topicName, std::size_t topicLen, MQTTAsync_message *m)
+    : _topicName{topicName}, _topicLen{topicLen}, _m{m},
+      _payload{static_cast<uint8_t *>(m->payload), static_cast<std::size_t>(m->payloadlen)} {
+}
+
+MqttMessage::~MqttMessage() {
+  if (_m) {
+    MQTTAsync_freeMessage(&_m);
+  }
+  if (_topicName) {
+    MQTTAsync_free(_topicName);
+  }
+  Recycle(std::move(_buffer));
+}
+
+auto MqttMessage::operator new(std::size_t size) -> void * {
+  void *p = nullptr;
+  if (size == sizeof(MqttMessage) && MessageFreeList().pop(p)) {
+    return p;
+  }
+  return ::operator new(size);
+}
+
+auto MqttMessage::operator delete(void *p, std::size_t size) -> void {
+  if (size == sizeof(MqttMessage) && MessageFreeList().push(std::move(p))) {
+    return;
+  }
+  ::operator delete(p);
+}
+
+auto MqttMessage::Reserve(std::size_t count) -> void {
+  static std::atomic<std::size_t> reserved{0};
+  auto &freeList = MessageFreeList();
+  freeList.reserve(reserved.fetch_add(count, std::memory_order_relaxed) + count);
+  for (std::size_t i = 0; i < count; ++i) {
+    void *p = ::operator new(sizeof(MqttMessage));
+    if (!freeList.push(std::move(p))) {
+      ::operator delete(p);
+      break;
+    }
+  }
+}
+
+auto MqttMessage::topic() const -> std::string_view {
+  return {_topicName, _topicLen};
+}
+
+auto MqttMessage::qos() const -> Mqtt::Qos {
+  return utils::ToQos(_m->qos);
+}
+
+auto MqttMessage::retained() const -> bool {
+  return _m->retained != 0;
+}
+
+auto MqttMessage::payload() const -> std::span<uint8_t> {
+  return _payload;
+}
+
+auto MqttMessage::userProperty(std::string_view name) const -> std::string_view {
+  for (int i = 0; i < _m->properties.count; ++i) {
+    const auto &prop = _m->properties.array[i];
+    if (prop.identifier == MQTTPROPERTY_CODE_USER_PROPERTY &&
+        std::string_view(prop.value.data.data, prop.value.data.len) == name) {
+      return {prop.value.value.data, static_cast<std::size_t>(prop.value.value.len)};
+    }
+  }
+  return {};
+}
+
+auto MqttMessage::SetPayload(std::span<uint8_t> payload) -> void {
+  _payload = payload;
+}
+
+auto MqttMessage::Buffer() -> std::vector<uint8_t> & {
+  if (_buffer.capacity() == 0) {
+    BufferFreeList().pop(_buffer);
+  }
+  return _buffer;
+}
+
+auto MqttMessage::Detach() -> void {
+  _topicName = nullptr;
+  _m = nullptr;
+}
+
 //////////////////////////////////////////
 MqttImpl::MqttImpl(const Config &config) : _config{config}, _client{nullptr} {
   DSG_LOG(_config.to_string());
+  if (_config._lastValueTopics > 0) {
+    _lastValues = std::make_unique<LastValueCache>(_config._lastValueTopics,
+                                                   _config._lastValueBytes);
+  }
+  if (_config._dispatchThreads > 0) {
+    _dispatcher = std::make_unique<MqttDispatcher>(_config._dispatchQueueSize,
+                                                   _config._dispatchThreads,
+                                                   [this](MqttEvent &ev) { Dispatch(ev); });
+    _dispatcher->Start();
+    // 在途消息数不超过各分片的队列容量之和加分发线程数（每个线程正在回调的一条）
+    MqttMessage::Reserve(_dispatcher->Capacity() + _config._dispatchThreads);
+    // 发送结果事件携带 topic 名
+    if (_config._sendCallback) {
+      Prefill(TextFreeList(), kPrefillCount, kPrefillText);
+    }
+  }
   DSG_CALL_EX(InitClient());
+  if (_config._schedule) {
+    Prefill(TextFreeList(), kPrefillCount, kPrefillText);
+    Prefill(BufferFreeList(), kPrefillCount, kPrefillPayload);
+    _scheduler = std::make_unique<MqttScheduler>(_config, [this](MqttOutbound &msg) {
+      auto status = MqttScheduler::SendStatus::eSent;
+      if (!Send(msg._topic, msg._payload.data(), static_cast<int>(msg._payload.size()),
+                msg._options)) {
+        // 断线时 paho 拒绝发送，留在队列中等重连后重试
+        if (!IsConnected()) {
+          return MqttScheduler::SendStatus::eRetry;
+        }
+        // 调用方已返回，失败通过发送回调通知
+        MqttEvent ev{._kind = MqttEvent::Kind::eSend,
+                     ._topic = {PooledCopy(msg._topic._name), msg._topic._qos},
+                     ._msg = "scheduled send failed"};
+        cb::QueueEvent(this, ev);
+        status = MqttScheduler::SendStatus::eFailed;
+      }
+      // paho 已复制负载，消息不再使用
+      Recycle(std::move(msg._topic._name));
+      Recycle(std::move(msg._payload));
+      return status;
+    });
+    _scheduler->Start();
+  }
 }
 
 MqttImpl::~MqttImpl() {
+  if (_scheduler) {
+    _scheduler->Stop();
+  }
   DeInitClient();
+  if (_dispatcher) {
+    _dispatcher->Stop();
+  }
 }
 
 auto MqttImpl::InitClient() -> Result {
-  DSG_MQTTCALL(MQTTAsync_create(&_client, _config._address.c_str(), _config._clientID.c_str(),
-                                MQTTCLIENT_PERSISTENCE_NONE, NULL));
+  if (IsV5()) {
+    MQTTAsync_createOptions createOpts = MQTTAsync_createOptions_initializer5;
+    DSG_MQTTCALL(MQTTAsync_createWithOptions(&_client, _config._address.c_str(),
+                                             _config._clientID.c_str(),
+                                             MQTTCLIENT_PERSISTENCE_NONE, NULL, &createOpts));
+  } else {
+    DSG_MQTTCALL(MQTTAsync_create(&_client, _config._address.c_str(), _config._clientID.c_str(),
+                                  MQTTCLIENT_PERSISTENCE_NONE, NULL));
+  }
   DSG_MQTTCALL(MQTTAsync_setCallbacks(_client, this, cb::OnConnectionLost, cb::OnMessageArrived,
                                       cb::OnDeliveryComplete));
+  DSG_MQTTCALL(MQTTAsync_setConnected(_client, this, cb::OnConnected));
   return RV::eSuccess;
 }
 
@@ -301,12 +983,218 @@ auto MqttImpl::getConfig() const -> const Config & {
   return _config;
 }
 
+auto MqttImpl::IsV5() const -> bool {
+  return _config._mqttVersion >= MQTTVERSION_5;
+}
+
+auto MqttImpl::metrics() -> MqttMetrics & {
+  return _metrics;
+}
+
+auto MqttImpl::HasDispatcher() const -> bool {
+  return _dispatcher != nullptr;
+}
+
+auto MqttImpl::SendAcked() -> void {
+  if (_scheduler) {
+    _scheduler->OnAck();
+  }
+}
+
+auto MqttImpl::Post(MqttEvent &ev) -> bool {
+  if (!_dispatcher) {
+    Dispatch(ev);
+    return true;
+  }
+  return _dispatcher->Post(ev);
+}
+
+auto MqttImpl::Queue(MqttEvent &ev) -> void {
+  if (!_dispatcher) {
+    Dispatch(ev);
+    return;
+  }
+  _dispatcher->Queue(ev);
+}
+
+auto MqttImpl::Dispatch(MqttEvent &ev) -> void {
+  switch (ev._kind) {
+  case MqttEvent::Kind::eConnectionLost:
+    if (_config._connectLostCallback) {
+      _config._connectLostCallback(ev._msg);
+    }
+    break;
+  case MqttEvent::Kind::eMessageArrived:
+    if (_config._compress) {
+      // 在分发线程解压，网络线程不承担解压开销；消息可能被 _messageCallback 持有，
+      // 解压到消息自带的缓冲区，缓冲区随消息释放归还复用
+      auto *message = static_cast<MqttMessage *>(ev._message.get());
+      message->SetPayload(Inflate(message->payload(), message->Buffer()));
+    }
+    Deliver(ev._message->topic(), ev._message->qos(), ev._message->payload());
+    if (_config._messageCallback) {
+      _config._messageCallback(ev._message);
+    }
+    break;
+  case MqttEvent::Kind::eConnect:
+    if (_config._connectCallback) {
+      _config._connectCallback(ev._success, ev._msg);
+    }
+    break;
+  case MqttEvent::Kind::eDisconnect:
+    if (_config._disconnectCallback) {
+      _config._disconnectCallback(ev._success, ev._msg);
+    }
+    break;
+  case MqttEvent::Kind::eSend:
+    if (_config._sendCallback) {
+      _config._sendCallback(ev._success, ev._topic, ev._msg);
+    }
+    Recycle(std::move(ev._topic._name));
+    Recycle(std::move(ev._msg));
+    break;
+  case MqttEvent::Kind::eSubscribe:
+    if (_config._subscribeCallback) {
+      _config._subscribeCallback(ev._success, ev._topic, ev._msg);
+    }
+    break;
+  case MqttEvent::Kind::eUnsubscribe:
+    if (_config._unsubscribeCallback) {
+      _config._unsubscribeCallback(ev._success, ev._topic, ev._msg);
+    }
+    break;
+  case MqttEvent::Kind::eSubscribeMany:
+    if (_config._subscribeManyCallback) {
+      _config._subscribeManyCallback(ev._success, ev._topics, ev._msg);
+    }
+    break;
+  case MqttEvent::Kind::eUnsubscribeMany:
+    if (_config._unsubscribeManyCallback) {
+      _config._unsubscribeManyCallback(ev._success, ev._topics, ev._msg);
+    }
+    break;
+  default:
+    break;
+  }
+}
+
+auto MqttImpl::Deliver(std::string_view topic, Qos qos, std::span<uint8_t> payload) -> void {
+  if (_router.Empty() && !_config._messageArrivedCallback) {
+    return;
+  }
+  TopicView t{topic, qos};
+  auto matched = _router.Match(topic, [&](const MessageHandler &handler) { handler(t, payload); });
+  if (matched == 0 && _config._messageArrivedCallback) {
+    _config._messageArrivedCallback(t, payload);
+  }
+}
+
+auto MqttImpl::CacheLastValue(std::string_view topic, std::span<const uint8_t> payload) -> void {
+  if (_lastValues && !_lastValues->Update(topic, payload) && !_lastValueFull.exchange(true)) {
+    DSG_WARN("last value cache full, topic:" << topic << ", size:" << payload.size());
+  }
+}
+
+auto MqttImpl::LastValue(std::string_view topic, std::vector<uint8_t> &payload) -> bool {
+  if (!_lastValues || !_lastValues->Read(topic, payload)) {
+    return false;
+  }
+  if (_config._compress) {
+    thread_local std::vector<uint8_t> inflated;
+    auto p = Inflate(payload, inflated);
+    if (p.data() == inflated.data()) {
+      payload.swap(inflated);
+    } else {
+      payload.erase(payload.begin(), payload.begin() + (p.data() - payload.data()));
+    }
+  }
+  return true;
+}
+
+auto MqttImpl::EvictLastValues() -> void {
+  if (!_lastValues) {
+    return;
+  }
+  _lastValues->Evict([this](std::string_view topic) {
+    return std::none_of(_subscriptions.begin(), _subscriptions.end(), [&](const auto &sub) {
+      return TopicRouter::Matches(sub.first, topic);
+    });
+  });
+}
+
+auto MqttImpl::Inflate(std::span<uint8_t> payload, std::vector<uint8_t> &buf)
+    -> std::span<uint8_t> {
+  if (!_config._compress) {
+    return payload;
+  }
+  compress::Header header;
+  switch (compress::Peek(payload, header)) {
+  case compress::Format::eEscaped:
+    return payload.subspan(compress::kEscapeSize);
+  case compress::Format::eCompressed:
+    break;
+  default:
+    return payload;
+  }
+  // 头中的长度不可信，先按压缩比和配置上限校验再分配
+  auto limit = std::min(_config._compressMaxSize,
+                        (payload.size() - compress::kHeaderSize) * compress::kMaxRatio);
+  if (header._size > limit) {
+    DSG_WARN("compressed payload too large, size:" << payload.size()
+                                                    << ", inflated:" << header._size);
+    return payload;
+  }
+  buf.resize(header._size);
+  if (!compress::Decode(payload, CompressDict(header._dict), buf)) {
+    DSG_WARN("decompress payload failed, size:" << payload.size() << ", dict:" << +header._dict);
+    return payload;
+  }
+  return buf;
+}
+
+auto MqttImpl::CompressDict(int id) const -> std::span<const uint8_t> {
+  if (id <= 0 || id > static_cast<int>(_config._compressDicts.size())) {
+    return {};
+  }
+  const auto &dict = _config._compressDicts[id - 1];
+  return {reinterpret_cast<const uint8_t *>(dict.data()), dict.size()};
+}
+
+auto MqttImpl::GetDispatchStats() -> DispatchStats {
+  return _dispatcher ? _dispatcher->Stats() : DispatchStats{};
+}
+
+auto MqttImpl::GetScheduleStats() -> ScheduleStats {
+  return _scheduler ? _scheduler->Stats() : ScheduleStats{};
+}
+
+auto MqttImpl::GetMetrics() -> Metrics {
+  auto m = _metrics.Snapshot();
+  m._connected = IsConnected();
+  return m;
+}
+
 auto MqttImpl::Connect() -> Result {
+  _metrics.Connecting();
   MQTTAsync_connectOptions connOpts = MQTTAsync_connectOptions_initializer;
+  if (IsV5()) {
+    connOpts = MQTTAsync_connectOptions_initializer5;
+    connOpts.cleanstart = _config._cleansession;
+  } else {
+    connOpts.cleansession = _config._cleansession;
+  }
   connOpts.keepAliveInterval = _config._keepAliveInterval;
-  connOpts.cleansession = _config._cleansession;
-  connOpts.onSuccess = cb::OnConnect;
-  connOpts.onFailure = cb::OnConnectFailure;
+  connOpts.maxInflight = _config._maxInflight;
+  connOpts.connectTimeout = _config._connectTimeout;
+  connOpts.automaticReconnect = _config._automaticReconnect;
+  connOpts.minRetryInterval = _config._minRetryInterval;
+  connOpts.maxRetryInterval = _config._maxRetryInterval;
+  if (!_config._username.empty()) {
+    connOpts.username = _config._username.c_str();
+    connOpts.password = _config._pwd.c_str();
+  }
+  utils::SetCallbacks(connOpts, IsV5(), cb::OnConnect, cb::OnConnectFailure, cb::OnConnect5,
+                      cb::OnConnectFailure5);
   connOpts.context = this;
 
   DSG_MQTTCALL(MQTTAsync_connect(_client, &connOpts));
@@ -315,14 +1203,15 @@ auto MqttImpl::Connect() -> Result {
 
 auto MqttImpl::Disconnect() -> Result {
   MQTTAsync_disconnectOptions opts = MQTTAsync_disconnectOptions_initializer;
-  opts.onSuccess = cb::OnDisconnect;
-  opts.onFailure = cb::OnDisconnectFailure;
+  utils::SetCallbacks(opts, IsV5(), cb::OnDisconnect, cb::OnDisconnectFailure, cb::OnDisconnect5,
+                      cb::OnDisconnectFailure5);
   opts.context = this;
   DSG_MQTTCALL(MQTTAsync_disconnect(_client, &opts));
   return RV::eSuccess;
 }
 
 auto MqttImpl::ReConnect() -> Result {
+  _metrics.Connecting();
   DSG_MQTTCALL(MQTTAsync_reconnect(_client));
   return RV::eSuccess;
 }
@@ -331,57 +1220,362 @@ auto MqttImpl::IsConnected() -> bool {
   return MQTTAsync_isConnected(_client);
 }
 
-auto MqttImpl::Send(const Topic &topic, void *payload, int payloadLen) -> Result {
+auto MqttImpl::Send(const Topic &topic, void *payload, int payloadLen, const SendOptions &options)
+    -> Result {
   MQTTAsync_responseOptions opts = MQTTAsync_responseOptions_initializer;
-  opts.onSuccess = cb::OnSend;
-  opts.onFailure = cb::OnSendFailure;
+  utils::SetCallbacks(opts, IsV5(), cb::OnSend, cb::OnSendFailure, cb::OnSend5,
+                      cb::OnSendFailure5);
   opts.context = this;
 
+  if (_config._compress) {
+    // paho 会拷贝负载，压缩缓冲区按线程复用
+    thread_local std::vector<uint8_t> encoded;
+    std::span<const uint8_t> src{static_cast<const uint8_t *>(payload),
+                                 static_cast<std::size_t>(payloadLen)};
+    bool encode = src.size() >= _config._compressThreshold &&
+                  compress::Encode(src, CompressDict(_config._compressDict),
+                                   static_cast<uint8_t>(_config._compressDict), encoded);
+    if (!encode && compress::NeedsEscape(src)) {
+      // 未压缩的负载以 magic 开头，加转义头，接收端不会误判为压缩格式
+      compress::Escape(src, encoded);
+      encode = true;
+    }
+    if (encode) {
+      payload = encoded.data();
+      payloadLen = static_cast<int>(encoded.size());
+    }
+  }
+
   MQTTAsync_message pubmsg = MQTTAsync_message_initializer;
   pubmsg.payloadlen = payloadLen;
   pubmsg.payload = payload;
   pubmsg.qos = utils::FromQos(topic._qos);
-  pubmsg.retained = 0;
+  pubmsg.retained = options._retained;
+
+  if (!IsV5()) {
+    DSG_MQTTCALL(Publish(topic._name.c_str(), pubmsg, opts));
+    return RV::eSuccess;
+  }
 
-  DSG_MQTTCALL(MQTTAsync_sendMessage(_client, topic._name.c_str(), &pubmsg, &opts));
+  utils::Properties props;
+  if (options._messageExpiry > 0) {
+    props.AddInt(MQTTPROPERTY_CODE_MESSAGE_EXPIRY_INTERVAL,
+                 static_cast<int>(options._messageExpiry));
+  }
+  for (const auto &[name, value] : options._userProperties) {
+    props.AddUser(name, value);
+  }
+
+  // alias 只用于 qos0：qos1/2 的消息可能在新连接上重传，而 alias 只在原连接有效
+  const char *dest = topic._name.c_str();
+  bool first = false;
+  std::unique_lock<std::mutex> lock{_aliasMutex, std::defer_lock};
+  if (topic._qos == Qos::e0 && _config._topicAliasThreshold > 0) {
+    // 持锁发送，保证携带 topic 名的首条消息先于只带 alias 的消息入队
+    lock.lock();
+    if (auto alias = AcquireTopicAlias(topic._name, first); alias > 0) {
+      props.AddInt(MQTTPROPERTY_CODE_TOPIC_ALIAS, alias);
+      dest = first ? dest : "";
+    } else {
+      lock.unlock();
+    }
+  }
+  pubmsg.properties = props.get();
+
+  auto ret = Publish(dest, pubmsg, opts);
+  if (ret != MQTTASYNC_SUCCESS) {
+    if (first) {
+      ReleaseTopicAlias(topic._name);
+    }
+    DSG_ERROR("MQTTAsync_sendMessage " << topic.to_string()
+                                       << ", ret=" << MQTTAsync_strerror(ret) << "/" << ret);
+    return DSG_Err;
+  }
   return RV::eSuccess;
 }
+
+auto MqttImpl::Publish(const char *dest, MQTTAsync_message &msg, MQTTAsync_responseOptions &opts)
+    -> int {
+  auto ret = MQTTAsync_sendMessage(_client, dest, &msg, &opts);
+  _metrics.Published(ret == MQTTASYNC_SUCCESS, opts.token,
+                     static_cast<std::size_t>(msg.payloadlen));
+  return ret;
+}
+
 auto MqttImpl::Send(const Topic &topic, const std::vector<uint8_t> &payload) -> Result {
-  return Send(topic, const_cast<uint8_t *>(payload.data()), payload.size());
+  return Send(topic, std::span<const uint8_t>(payload), SendOptions{});
 }
 
 auto MqttImpl::Send(const Topic &topic, const std::string &textMsg) -> Result {
-  return Send(topic, const_cast<char *>(textMsg.data()), textMsg.length());
+  return Send(topic,
+              {reinterpret_cast<const uint8_t *>(textMsg.data()), textMsg.length()},
+              SendOptions{});
+}
+
+auto MqttImpl::Send(const Topic &topic, std::span<const uint8_t> payload,
+                    const SendOptions &options) -> Result {
+  if (_scheduler) {
+    // 负载和 topic 名复制到空闲缓冲区中，发出后归还
+    MqttOutbound msg{._topic = {PooledCopy(topic._name), topic._qos},
+                     ._payload = PooledCopy(payload),
+                     ._options = options};
+    if (!_scheduler->Post(std::move(msg))) {
+      Recycle(std::move(msg._topic._name));
+      Recycle(std::move(msg._payload));
+      DSG_WARN("send queue full, priority:" << static_cast<int>(options._priority) << ", "
+                                            << topic.to_string());
+      return DSG_Err;
+    }
+    return RV::eSuccess;
+  }
+  return Send(topic, const_cast<uint8_t *>(payload.data()), payload.size(), options);
+}
+
+auto MqttImpl::AcquireTopicAlias(const std::string &topic, bool &first) -> int {
+  first = false;
+  if (_aliasMax <= 0) {
+    return 0;
+  }
+  auto it = _aliases.find(topic);
+  if (it == _aliases.end()) {
+    // alias 已分配完时不再统计新 topic，避免表无限增长
+    if (_aliasTopics.size() >= static_cast<std::size_t>(_aliasMax)) {
+      return 0;
+    }
+    it = _aliases.emplace(topic, TopicAlias{}).first;
+  }
+  auto &entry = it->second;
+  if (entry._alias > 0) {
+    return entry._alias;
+  }
+  if (++entry._count < static_cast<uint32_t>(_config._topicAliasThreshold) ||
+      _aliasTopics.size() >= static_cast<std::size_t>(_aliasMax)) {
+    return 0;
+  }
+  _aliasTopics.push_back(topic);
+  entry._alias = static_cast<int>(_aliasTopics.size());
+  first = true;
+  return entry._alias;
+}
+
+auto MqttImpl::ReleaseTopicAlias(const std::string &topic) -> void {
+  // 只会回退刚分配的最后一个 alias
+  auto it = _aliases.find(topic);
+  if (it != _aliases.end() && it->second._alias == static_cast<int>(_aliasTopics.size())) {
+    it->second._alias = 0;
+    _aliasTopics.pop_back();
+  }
+}
+
+auto MqttImpl::ResetTopicAlias(int aliasMax) -> void {
+  std::lock_guard<std::mutex> lock{_aliasMutex};
+  _aliases.clear();
+  _aliasTopics.clear();
+  if (aliasMax >= 0) {
+    _aliasMax = aliasMax;
+  }
+}
+
+auto MqttImpl::AliasTopic(int alias) -> std::string {
+  std::lock_guard<std::mutex> lock{_aliasMutex};
+  return alias > 0 && alias <= static_cast<int>(_aliasTopics.size()) ? _aliasTopics[alias - 1]
+                                                                     : std::string{};
 }
 
 auto MqttImpl::Subscribe(const Topic &topic) -> Result {
+  {
+    std::lock_guard<std::mutex> lock{_subscriptionsMutex};
+    _subscriptions.insert_or_assign(topic._name, topic._qos);
+  }
   MQTTAsync_responseOptions opts = MQTTAsync_responseOptions_initializer;
-  opts.onSuccess = cb::OnSubscribe;
-  opts.onFailure = cb::OnSubscribeFailure;
+  utils::SetCallbacks(opts, IsV5(), cb::OnSubscribe, cb::OnSubscribeFailure, cb::OnSubscribe5,
+                      cb::OnSubscribeFailure5);
   opts.context = this;
   DSG_MQTTCALL(
       MQTTAsync_subscribe(_client, topic._name.c_str(), utils::FromQos(topic._qos), &opts));
   return RV::eSuccess;
 }
 
+auto MqttImpl::Subscribe(const Topic &topic, MessageHandler handler) -> Result {
+  // 先注册处理函数，订阅生效后到达的消息即可分发
+  DSG_CALLM(_router.Add(topic._name, std::move(handler)), topic.to_string());
+  return Subscribe(topic);
+}
+
 auto MqttImpl::Unsubscribe(const Topic &topic) -> Result {
+  {
+    std::lock_guard<std::mutex> lock{_subscriptionsMutex};
+    _subscriptions.erase(topic._name);
+    EvictLastValues();
+  }
+  _router.Remove(topic._name);
   MQTTAsync_responseOptions opts = MQTTAsync_responseOptions_initializer;
-  opts.onSuccess = cb::OnUnsubscribe;
-  opts.onFailure = cb::OnUnsubscribeFailure;
+  utils::SetCallbacks(opts, IsV5(), cb::OnUnsubscribe, cb::OnUnsubscribeFailure,
+                      cb::OnUnsubscribe5, cb::OnUnsubscribeFailure5);
   opts.context = this;
   DSG_MQTTCALL(MQTTAsync_unsubscribe(_client, topic._name.c_str(), &opts));
   return RV::eSuccess;
 }
 
+auto MqttImpl::Subscribe(std::span<const Topic> topics) -> Result {
+  {
+    std::lock_guard<std::mutex> lock{_subscriptionsMutex};
+    for (const auto &topic : topics) {
+      _subscriptions.insert_or_assign(topic._name, topic._qos);
+    }
+  }
+  return SubscribeChunked(topics);
+}
+
+auto MqttImpl::RestoreSubscriptions() -> Result {
+  std::vector<Topic> topics;
+  {
+    std::lock_guard<std::mutex> lock{_subscriptionsMutex};
+    topics.reserve(_subscriptions.size());
+    for (const auto &[name, qos] : _subscriptions) {
+      topics.push_back({name, qos});
+    }
+  }
+  if (topics.empty()) {
+    return RV::eSuccess;
+  }
+  DSG_LOG("restore " << topics.size() << " subscriptions");
+  return SubscribeChunked(topics);
+}
+
+auto MqttImpl::SubscribeChunked(std::span<const Topic> topics) -> Result {
+  // 各分包异步流水线发送，不等待前一个应答
+  const auto chunk = static_cast<std::size_t>(std::max(1, _config._maxTopicsPerSubscribe));
+  for (std::size_t i = 0; i < topics.size(); i += chunk) {
+    DSG_CALL(SubscribeMany(topics.subspan(i, std::min(chunk, topics.size() - i))));
+  }
+  return RV::eSuccess;
+}
+
+auto MqttImpl::Unsubscribe(std::span<const Topic> topics) -> Result {
+  {
+    std::lock_guard<std::mutex> lock{_subscriptionsMutex};
+    for (const auto &topic : topics) {
+      _subscriptions.erase(topic._name);
+    }
+    EvictLastValues();
+  }
+  for (const auto &topic : topics) {
+    _router.Remove(topic._name);
+  }
+  const auto chunk = static_cast<std::size_t>(std::max(1, _config._maxTopicsPerSubscribe));
+  for (std::size_t i = 0; i < topics.size(); i += chunk) {
+    DSG_CALL(UnsubscribeMany(topics.subspan(i, std::min(chunk, topics.size() - i))));
+  }
+  return RV::eSuccess;
+}
+
+auto MqttImpl::SubscribeMany(std::span<const Topic> topics) -> Result {
+  auto batch = std::make_unique<MqttBatch>(MqttBatch{this, {topics.begin(), topics.end()}});
+  std::vector<char *> names;
+  std::vector<int> qos;
+  names.reserve(topics.size());
+  qos.reserve(topics.size());
+  for (const auto &topic : batch->_topics) {
+    names.push_back(const_cast<char *>(topic._name.c_str()));
+    qos.push_back(utils::FromQos(topic._qos));
+  }
+
+  MQTTAsync_responseOptions opts = MQTTAsync_responseOptions_initializer;
+  utils::SetCallbacks(opts, IsV5(), cb::OnSubscribeMany, cb::OnSubscribeManyFailure,
+                      cb::OnSubscribeMany5, cb::OnSubscribeManyFailure5);
+  opts.context = batch.get();
+  DSG_MQTTCALL(MQTTAsync_subscribeMany(_client, static_cast<int>(names.size()), names.data(),
+                                       qos.data(), &opts));
+  batch.release(); // 由回调释放
+  return RV::eSuccess;
+}
+
+auto MqttImpl::UnsubscribeMany(std::span<const Topic> topics) -> Result {
+  auto batch = std::make_unique<MqttBatch>(MqttBatch{this, {topics.begin(), topics.end()}});
+  std::vector<char *> names;
+  names.reserve(topics.size());
+  for (const auto &topic : batch->_topics) {
+    names.push_back(const_cast<char *>(topic._name.c_str()));
+  }
+
+  MQTTAsync_responseOptions opts = MQTTAsync_responseOptions_initializer;
+  utils::SetCallbacks(opts, IsV5(), cb::OnUnsubscribeMany, cb::OnUnsubscribeManyFailure,
+                      cb::OnUnsubscribeMany5, cb::OnUnsubscribeManyFailure5);
+  opts.context = batch.get();
+  DSG_MQTTCALL(
+      MQTTAsync_unsubscribeMany(_client, static_cast<int>(names.size()), names.data(), &opts));
+  batch.release(); // 由回调释放
+  return RV::eSuccess;
+}
+
 ///////////////////////////////////////////
 auto Mqtt::Config::to_string() const -> std::string {
-  return DSG_STR("MqttClient{address:" << _address << ", client_id:" << _clientID << "}");
+  return DSG_STR("MqttClient{address:" << _address << ", client_id:" << _clientID
+                                       << ", version:" << _mqttVersion << "}");
+}
+
+auto Mqtt::DispatchStats::to_string() const -> std::string {
+  return DSG_STR("DispatchStats{depth:" << _depth << "/" << _capacity << ", posted:" << _posted
+                                        << ", dispatched:" << _dispatched
+                                        << ", rejected:" << _rejected
+                                        << ", overflowed:" << _overflowed << ", latency(us) avg:"
+                                        << _avgLatencyUs << " max:" << _maxLatencyUs << "}");
+}
+
+auto Mqtt::ScheduleStats::to_string() const -> std::string {
+  std::stringstream ss;
+  ss << "ScheduleStats{";
+  for (std::size_t i = 0; i < _lanes.size(); ++i) {
+    const auto &l = _lanes[i];
+    ss << (i ? ", " : "") << "lane" << i << "{depth:" << l._depth << "/" << l._capacity
+       << ", queued:" << l._queued << ", sent:" << l._sent << ", failed:" << l._failed
+       << ", retried:" << l._retried << ", rejected:" << l._rejected << ", delay(us) avg:" << l._avgDelayUs
+       << " max:" << l._maxDelayUs << "}";
+  }
+  ss << ", inflight:" << _inflight << "/" << _window << "}";
+  return ss.str();
+}
+
+auto Mqtt::Metrics::AckRttPercentile(double p) const -> int64_t {
+  uint64_t total = 0;
+  for (auto n : _ackRtt) {
+    total += n;
+  }
+  if (total == 0) {
+    return 0;
+  }
+  auto rank = static_cast<uint64_t>(p / 100 * static_cast<double>(total - 1)) + 1;
+  for (std::size_t i = 0; i < _ackRtt.size(); ++i) {
+    if (_ackRtt[i] >= rank) {
+      return int64_t{1} << i;
+    }
+    rank -= _ackRtt[i];
+  }
+  return int64_t{1} << (_ackRtt.size() - 1);
+}
+
+auto Mqtt::Metrics::to_string() const -> std::string {
+  return DSG_STR("Metrics{connected:" << std::boolalpha << _connected << ", sent:" << _sent
+                                      << ", acked:" << _acked << ", failed:" << _failed
+                                      << ", inflight:" << _inflight << ", received:" << _received
+                                      << ", bytes out:" << _bytesOut << " in:" << _bytesIn
+                                      << ", reconnects:" << _reconnects
+                                      << ", lost:" << _connectionLost
+                                      << ", connect(us):" << _connectLatencyUs
+                                      << ", since inbound(ms):" << _sinceLastInboundMs
+                                      << ", ack rtt(us) p50:" << AckRttPercentile(50)
+                                      << " p99:" << AckRttPercentile(99) << "}");
 }
 
 auto Mqtt::Topic::to_string() const -> std::string {
   return DSG_STR("topic{" << _name << ":" << utils::FromQos(_qos) << "}");
 }
 
+auto Mqtt::TopicView::to_string() const -> std::string {
+  return DSG_STR("topic{" << _name << ":" << utils::FromQos(_qos) << "}");
+}
+
 auto Mqtt::Request(const Config &config) -> interface_ptr<Mqtt> {
   return make_ptr<MqttImpl>(config);
 }
@@ -0,0 +1,978 @@
+#include "def.hpp"
+#include "mqtt_broker.hpp"
+#include "topic_router.hpp"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <deque>
+#include <thread>
+
+namespace dsg {
+#define DSG_Err RV::eErrMqtt
+
+namespace {
+enum PacketType : uint8_t {
+  eConnect = 1,
+  eConnack = 2,
+  ePublish = 3,
+  ePuback = 4,
+  ePubrec = 5,
+  ePubrel = 6,
+  ePubcomp = 7,
+  eSubscribe = 8,
+  eSuback = 9,
+  eUnsubscribe = 10,
+  eUnsuback = 11,
+  ePingreq = 12,
+  ePingresp = 13,
+  eDisconnect = 14,
+};
+
+constexpr std::size_t kMaxPacketSize = 268435455; // 剩余长度最多 4 字节
+constexpr int kTickMs = 500;                      // keepalive 检查周期
+
+inline auto NowMs() -> int64_t {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+/// @brief 读取报文可变头和负载，越界后 _ok 为 false，之后的读取都返回空值
+class Reader {
+public:
+  explicit Reader(std::string_view data) : _data{data} {
+  }
+
+  auto U8() -> uint8_t {
+    if (!Need(1)) {
+      return 0;
+    }
+    auto v = static_cast<uint8_t>(_data[0]);
+    _data.remove_prefix(1);
+    return v;
+  }
+
+  auto U16() -> uint16_t {
+    if (!Need(2)) {
+      return 0;
+    }
+    auto v = static_cast<uint16_t>((static_cast<uint8_t>(_data[0]) << 8) |
+                                   static_cast<uint8_t>(_data[1]));
+    _data.remove_prefix(2);
+    return v;
+  }
+
+  auto Str() -> std::string_view {
+    auto len = U16();
+    if (!Need(len)) {
+      return {};
+    }
+    auto v = _data.substr(0, len);
+    _data.remove_prefix(len);
+    return v;
+  }
+
+  auto Rest() -> std::string_view {
+    auto v = _data;
+    _data = {};
+    return v;
+  }
+
+  auto Empty() const -> bool {
+    return _data.empty();
+  }
+
+  auto Ok() const -> bool {
+    return _ok;
+  }
+
+private:
+  auto Need(std::size_t n) -> bool {
+    _ok = _ok && _data.size() >= n;
+    return _ok;
+  }
+
+  std::string_view _data;
+  bool _ok{true};
+};
+
+inline auto PutLength(std::string &out, std::size_t len) -> void {
+  do {
+    auto b = static_cast<uint8_t>(len & 0x7f);
+    len >>= 7;
+    out.push_back(static_cast<char>(len ? b | 0x80 : b));
+  } while (len);
+}
+
+inline auto PutU16(std::string &out, uint16_t v) -> void {
+  out.push_back(static_cast<char>(v >> 8));
+  out.push_back(static_cast<char>(v & 0xff));
+}
+
+inline auto PutStr(std::string &out, std::string_view s) -> void {
+  PutU16(out, static_cast<uint16_t>(s.size()));
+  out.append(s);
+}
+
+/// @brief 解析固定头
+/// @param in
+/// @param remaining 剩余长度
+/// @return 固定头长度，0 数据不完整，-1 格式错误
+inline auto ParseFixedHeader(std::string_view in, std::size_t &remaining) -> int {
+  remaining = 0;
+  for (std::size_t i = 1, shift = 0; i <= 4; ++i, shift += 7) {
+    if (in.size() <= i) {
+      return 0;
+    }
+    auto b = static_cast<uint8_t>(in[i]);
+    remaining |= static_cast<std::size_t>(b & 0x7f) << shift;
+    if (!(b & 0x80)) {
+      return static_cast<int>(i + 1);
+    }
+  }
+  return -1;
+}
+} // namespace
+
+//////////////////////////////////////////
+class MqttBrokerImpl : public interface_wrapper<MqttBroker> {
+public:
+  MqttBrokerImpl(const Config &config);
+  ~MqttBrokerImpl();
+
+  MqttBrokerImpl(const MqttBrokerImpl &) = delete;
+  MqttBrokerImpl &operator=(const MqttBrokerImpl &) = delete;
+
+  auto Start() -> Result override;
+  auto Stop() -> void override;
+  auto Address() const -> std::string override;
+  auto GetStats() -> Stats override;
+
+private:
+  struct Message {
+    std::string _topic;
+    std::shared_ptr<const std::string> _payload; // 多个订阅者共享
+    uint8_t _qos{0};
+    bool _retain{false};
+  };
+
+  struct Connection;
+
+  struct Session {
+    struct Inflight {
+      Message _msg;
+      bool _released{false}; // qos2 已收到 PUBREC，等待 PUBCOMP
+    };
+
+    std::string _clientID;
+    bool _clean{true};
+    std::map<std::string, uint8_t, std::less<>> _subscriptions; // filter -> qos
+    std::map<uint16_t, Inflight> _inflight;                      // 发给客户端未确认的 qos1/2
+    std::deque<Message> _queue;                                  // 离线或 packet id 用尽时排队
+    std::set<uint16_t> _incoming; // 客户端发来的 qos2，等待 PUBREL，用于去重
+    uint16_t _nextID{0};
+    Connection *_conn{nullptr};
+  };
+
+  struct Connection {
+    int _fd{-1};
+    std::string _in;
+    std::string _out;
+    std::size_t _outPos{0};
+    bool _writable{true}; // false 时已注册 EPOLLOUT
+    bool _dirty{false};   // 有待写出数据，本轮事件处理完后统一写出
+    Session *_session{nullptr};
+    int _keepAlive{0}; // seconds
+    int64_t _lastRecvMs{0};
+    std::optional<Message> _will;
+  };
+
+  using Subscribers = std::map<Session *, uint8_t>;
+
+  auto Listen() -> Result;
+  auto Run() -> void;
+  auto Accept() -> void;
+  auto OnReadable(Connection &conn) -> void;
+  auto Flush(Connection &conn) -> bool;
+  auto Close(int fd, bool publishWill) -> void;
+  auto CheckKeepAlive() -> void;
+
+  /// @brief 处理一个完整报文，返回 false 时关闭连接
+  auto Handle(Connection &conn, uint8_t header, std::string_view body) -> bool;
+  auto HandleConnect(Connection &conn, std::string_view body) -> bool;
+  auto HandlePublish(Connection &conn, uint8_t header, std::string_view body) -> bool;
+  auto HandleSubscribe(Connection &conn, std::string_view body) -> bool;
+  auto HandleUnsubscribe(Connection &conn, std::string_view body) -> bool;
+  auto HandleAck(Connection &conn, uint8_t type, std::string_view body) -> bool;
+
+  auto Write(Connection &conn, std::string_view data) -> void;
+  auto WriteAck(Connection &conn, uint8_t header, uint16_t id) -> void;
+  auto WritePublish(Connection &conn, const Message &msg, uint8_t qos, uint16_t id, bool dup,
+                    bool retain) -> void;
+
+  /// @brief 按订阅分发，retain 时更新保留消息
+  auto Route(Message msg) -> void;
+  auto Deliver(Session &session, const Message &msg, uint8_t qos, bool retain) -> void;
+  /// @brief 连接恢复或 inflight 释放后发送排队消息
+  auto Drain(Session &session) -> void;
+  auto NextPacketID(Session &session) -> uint16_t;
+  auto Resume(Session &session) -> void;
+
+  auto AddSubscription(Session &session, std::string_view filter, uint8_t qos) -> void;
+  auto RemoveSubscription(Session &session, std::string_view filter) -> void;
+  auto RemoveSession(Session &session) -> void;
+
+private:
+  Config _config;
+  std::string _host;
+  int _port{0};
+  std::string _unixPath;
+
+  int _listenFd{-1};
+  int _epollFd{-1};
+  int _wakeFd{-1};
+  std::thread _worker;
+  std::atomic<bool> _running{false};
+
+  std::unordered_map<int, std::unique_ptr<Connection>> _conns;
+  std::vector<int> _dirty;
+  std::unordered_map<std::string, std::unique_ptr<Session>, StrHash, std::equal_to<>> _sessions;
+  // 不含通配符的过滤器按 topic 直接查找，含通配符的逐个匹配
+  std::unordered_map<std::string, Subscribers, StrHash, std::equal_to<>> _exact;
+  std::map<std::string, Subscribers, std::less<>> _wildcard;
+  std::map<std::string, Message, std::less<>> _retained;
+  uint64_t _autoID{0};
+
+  // stats
+  std::atomic<std::size_t> _clients{0};
+  std::atomic<uint64_t> _received{0};
+  std::atomic<uint64_t> _sent{0};
+  std::atomic<uint64_t> _dropped{0};
+};
+
+//////////////////////////////////////////
+MqttBrokerImpl::MqttBrokerImpl(const Config &config) : _config{config} {
+  DSG_LOG(_config.to_string());
+  std::string_view addr = _config._address;
+  if (addr.starts_with("unix://")) {
+    _unixPath = addr.substr(7);
+  } else {
+    if (addr.starts_with("tcp://")) {
+      addr.remove_prefix(6);
+    }
+    auto colon = addr.rfind(':');
+    _host = addr.substr(0, colon);
+    _port = colon == std::string_view::npos ? 1883 : std::stoi(std::string(addr.substr(colon + 1)));
+    if (_host.empty() || _host == "localhost") {
+      _host = "127.0.0.1";
+    }
+  }
+}
+
+MqttBrokerImpl::~MqttBrokerImpl() {
+  Stop();
+}
+
+auto MqttBrokerImpl::Start() -> Result {
+  if (_running.load()) {
+    return RV::eSuccess;
+  }
+  DSG_CALL(Listen());
+  _epollFd = epoll_create1(EPOLL_CLOEXEC);
+  _wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (_epollFd < 0 || _wakeFd < 0) {
+    DSG_ERROR("epoll/eventfd failed, errno:" << errno);
+    Stop();
+    return DSG_Err;
+  }
+  epoll_event ev{.events = EPOLLIN, .data = {.fd = _listenFd}};
+  epoll_ctl(_epollFd, EPOLL_CTL_ADD, _listenFd, &ev);
+  ev.data.fd = _wakeFd;
+  epoll_ctl(_epollFd, EPOLL_CTL_ADD, _wakeFd, &ev);
+
+  _running.store(true);
+  _worker = std::thread([this] { Run(); });
+  DSG_LOG("mqtt broker listen on " << Address());
+  return RV::eSuccess;
+}
+
+auto MqttBrokerImpl::Stop() -> void {
+  if (_running.exchange(false)) {
+    uint64_t one = 1;
+    [[maybe_unused]] auto n = write(_wakeFd, &one, sizeof(one));
+  }
+  if (_worker.joinable()) {
+    _worker.join();
+  }
+  // 事件线程已退出，在当前线程关闭所有连接，持久会话保留
+  while (!_conns.empty()) {
+    Close(_conns.begin()->first, false);
+  }
+  _dirty.clear();
+  for (auto fd : {&_listenFd, &_epollFd, &_wakeFd}) {
+    if (*fd >= 0) {
+      close(*fd);
+      *fd = -1;
+    }
+  }
+  if (!_unixPath.empty()) {
+    unlink(_unixPath.c_str());
+  }
+}
+
+auto MqttBrokerImpl::Address() const -> std::string {
+  return _unixPath.empty() ? DSG_STR("tcp://" << _host << ":" << _port) : "unix://" + _unixPath;
+}
+
+auto MqttBrokerImpl::GetStats() -> Stats {
+  return {._clients = _clients.load(std::memory_order_relaxed),
+          ._received = _received.load(std::memory_order_relaxed),
+          ._sent = _sent.load(std::memory_order_relaxed),
+          ._dropped = _dropped.load(std::memory_order_relaxed)};
+}
+
+auto MqttBrokerImpl::Listen() -> Result {
+  if (!_unixPath.empty()) {
+    sockaddr_un addr{.sun_family = AF_UNIX, .sun_path = {}};
+    if (_unixPath.size() >= sizeof(addr.sun_path)) {
+      DSG_ERROR("unix socket path too long " << _unixPath);
+      return DSG_Err;
+    }
+    std::memcpy(addr.sun_path, _unixPath.c_str(), _unixPath.size() + 1);
+    unlink(_unixPath.c_str());
+    _listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (_listenFd < 0 || bind(_listenFd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 ||
+        listen(_listenFd, SOMAXCONN) < 0) {
+      DSG_ERROR("listen " << Address() << " failed, errno:" << errno);
+      return DSG_Err;
+    }
+    return RV::eSuccess;
+  }
+
+  sockaddr_in addr{.sin_family = AF_INET,
+                   .sin_port = htons(static_cast<uint16_t>(_port)),
+                   .sin_addr = {},
+                   .sin_zero = {}};
+  if (inet_pton(AF_INET, _host.c_str(), &addr.sin_addr) != 1) {
+    DSG_ERROR("invalid broker address " << _config._address);
+    return DSG_Err;
+  }
+  _listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  int on = 1;
+  setsockopt(_listenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  if (_listenFd < 0 || bind(_listenFd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 ||
+      listen(_listenFd, SOMAXCONN) < 0) {
+    DSG_ERROR("listen " << Address() << " failed, errno:" << errno);
+    return DSG_Err;
+  }
+  // 记下系统分配的端口，重启后沿用，客户端可以重连
+  socklen_t len = sizeof(addr);
+  getsockname(_listenFd, reinterpret_cast<sockaddr *>(&addr), &len);
+  _port = ntohs(addr.sin_port);
+  return RV::eSuccess;
+}
+
+auto MqttBrokerImpl::Run() -> void {
+  epoll_event events[64];
+  auto lastTick = NowMs();
+  while (_running.load(std::memory_order_acquire)) {
+    auto n = epoll_wait(_epollFd, events, 64, kTickMs);
+    for (int i = 0; i < n; ++i) {
+      auto fd = events[i].data.fd;
+      if (fd == _wakeFd) {
+        continue;
+      }
+      if (fd == _listenFd) {
+        Accept();
+        continue;
+      }
+      auto it = _conns.find(fd);
+      if (it == _conns.end()) {
+        continue; // 本轮已关闭
+      }
+      auto &conn = *it->second;
+      if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+        Close(fd, true);
+        continue;
+      }
+      if ((events[i].events & EPOLLOUT) && !Flush(conn)) {
+        Close(fd, true);
+        continue;
+      }
+      if (events[i].events & EPOLLIN) {
+        OnReadable(conn);
+      }
+    }
+
+    // 本轮产生的数据统一写出，减少系统调用
+    auto dirty = std::move(_dirty);
+    _dirty.clear();
+    for (auto fd : dirty) {
+      auto it = _conns.find(fd);
+      if (it != _conns.end()) {
+        it->second->_dirty = false;
+        if (!Flush(*it->second)) {
+          Close(fd, true);
+        }
+      }
+    }
+
+    if (auto now = NowMs(); now - lastTick >= kTickMs) {
+      lastTick = now;
+      CheckKeepAlive();
+    }
+  }
+}
+
+auto MqttBrokerImpl::Accept() -> void {
+  while (true) {
+    auto fd = accept4(_listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+      return;
+    }
+    if (_unixPath.empty()) {
+      int on = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    }
+    auto conn = std::make_unique<Connection>();
+    conn->_fd = fd;
+    conn->_lastRecvMs = NowMs();
+    epoll_event ev{.events = EPOLLIN, .data = {.fd = fd}};
+    epoll_ctl(_epollFd, EPOLL_CTL_ADD, fd, &ev);
+    _conns.emplace(fd, std::move(conn));
+    _clients.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+auto MqttBrokerImpl::OnReadable(Connection &conn) -> void {
+  const auto fd = conn._fd;
+  char buf[64 * 1024];
+  while (true) {
+    auto n = recv(fd, buf, sizeof(buf), 0);
+    if (n > 0) {
+      conn._in.append(buf, static_cast<std::size_t>(n));
+      continue;
+    }
+    if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+      Close(fd, true);
+      return;
+    }
+    if (errno == EINTR) {
+      continue;
+    }
+    break;
+  }
+  conn._lastRecvMs = NowMs();
+
+  std::size_t pos = 0;
+  while (pos < conn._in.size()) {
+    std::string_view in{conn._in.data() + pos, conn._in.size() - pos};
+    std::size_t remaining = 0;
+    auto headerLen = ParseFixedHeader(in, remaining);
+    if (headerLen < 0 || remaining > kMaxPacketSize) {
+      Close(fd, true);
+      return;
+    }
+    if (headerLen == 0 || in.size() < headerLen + remaining) {
+      break;
+    }
+    auto header = static_cast<uint8_t>(in[0]);
+    if (!Handle(conn, header, in.substr(headerLen, remaining))) {
+      // DISCONNECT 正常关闭不发布遗嘱
+      Close(fd, (header >> 4) != eDisconnect);
+      return;
+    }
+    pos += headerLen + remaining;
+  }
+  conn._in.erase(0, pos);
+}
+
+auto MqttBrokerImpl::Flush(Connection &conn) -> bool {
+  while (conn._outPos < conn._out.size()) {
+    auto n = send(conn._fd, conn._out.data() + conn._outPos, conn._out.size() - conn._outPos,
+                  MSG_NOSIGNAL);
+    if (n > 0) {
+      conn._outPos += static_cast<std::size_t>(n);
+      continue;
+    }
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      if (conn._writable) {
+        conn._writable = false;
+        epoll_event ev{.events = EPOLLIN | EPOLLOUT, .data = {.fd = conn._fd}};
+        epoll_ctl(_epollFd, EPOLL_CTL_MOD, conn._fd, &ev);
+      }
+      return true;
+    }
+    return false;
+  }
+  conn._out.clear();
+  conn._outPos = 0;
+  if (!conn._writable) {
+    conn._writable = true;
+    epoll_event ev{.events = EPOLLIN, .data = {.fd = conn._fd}};
+    epoll_ctl(_epollFd, EPOLL_CTL_MOD, conn._fd, &ev);
+  }
+  return true;
+}
+
+auto MqttBrokerImpl::Close(int fd, bool publishWill) -> void {
+  auto it = _conns.find(fd);
+  if (it == _conns.end()) {
+    return;
+  }
+  auto conn = std::move(it->second);
+  _conns.erase(it);
+  _clients.fetch_sub(1, std::memory_order_relaxed);
+  if (_epollFd >= 0) {
+    epoll_ctl(_epollFd, EPOLL_CTL_DEL, fd, nullptr);
+  }
+  close(fd);
+
+  if (auto *session = conn->_session) {
+    session->_conn = nullptr;
+    if (session->_clean) {
+      RemoveSession(*session);
+    }
+  }
+  if (publishWill && conn->_will) {
+    Route(std::move(*conn->_will));
+  }
+}
+
+auto MqttBrokerImpl::CheckKeepAlive() -> void {
+  auto now = NowMs();
+  std::vector<int> expired;
+  for (const auto &[fd, conn] : _conns) {
+    // 超过 1.5 倍 keepalive 没有收到任何报文视为断开；未发 CONNECT 的连接按 30s 处理
+    auto keepAlive = conn->_session ? conn->_keepAlive : 20;
+    if (keepAlive > 0 && now - conn->_lastRecvMs > keepAlive * 1500) {
+      expired.push_back(fd);
+    }
+  }
+  for (auto fd : expired) {
+    DSG_WARN("mqtt broker keepalive timeout, fd:" << fd);
+    Close(fd, true);
+  }
+}
+
+auto MqttBrokerImpl::Handle(Connection &conn, uint8_t header, std::string_view body) -> bool {
+  const auto type = static_cast<uint8_t>(header >> 4);
+  if (!conn._session) {
+    // 第一个报文必须是 CONNECT
+    return type == eConnect && HandleConnect(conn, body);
+  }
+  switch (type) {
+  case ePublish:
+    return HandlePublish(conn, header, body);
+  case ePuback:
+  case ePubrec:
+  case ePubrel:
+  case ePubcomp:
+    return HandleAck(conn, type, body);
+  case eSubscribe:
+    return HandleSubscribe(conn, body);
+  case eUnsubscribe:
+    return HandleUnsubscribe(conn, body);
+  case ePingreq:
+    Write(conn, std::string_view("\xd0\x00", 2));
+    return true;
+  case eDisconnect:
+    conn._will.reset();
+    return false;
+  default:
+    return false; // 客户端不应发送其他报文，按协议关闭连接
+  }
+}
+
+auto MqttBrokerImpl::HandleConnect(Connection &conn, std::string_view body) -> bool {
+  Reader r{body};
+  auto protocol = r.Str();
+  auto level = r.U8();
+  auto flags = r.U8();
+  auto keepAlive = r.U16();
+  if (!r.Ok() || (protocol != "MQTT" && protocol != "MQIsdp") || (flags & 0x01)) {
+    return false;
+  }
+  auto connack = [&](uint8_t present, uint8_t rc) {
+    const char packet[] = {static_cast<char>(eConnack << 4), 2, static_cast<char>(present),
+                           static_cast<char>(rc)};
+    Write(conn, {packet, sizeof(packet)});
+    Flush(conn);
+  };
+  if (level != 3 && level != 4) {
+    connack(0, 0x01); // unacceptable protocol version
+    return false;
+  }
+
+  const bool clean = flags & 0x02;
+  std::string clientID{r.Str()};
+  if (flags & 0x04) {
+    Message will;
+    will._topic = r.Str();
+    will._payload = std::make_shared<const std::string>(r.Str());
+    will._qos = std::min<uint8_t>((flags >> 3) & 0x03, 2);
+    will._retain = flags & 0x20;
+    conn._will = std::move(will);
+  }
+  if (flags & 0x80) {
+    r.Str(); // username
+  }
+  if (flags & 0x40) {
+    r.Str(); // password
+  }
+  if (!r.Ok()) {
+    return false;
+  }
+  if (clientID.empty()) {
+    if (!clean) {
+      connack(0, 0x02); // identifier rejected
+      return false;
+    }
+    clientID = DSG_STR("jbcore-auto-" << ++_autoID);
+  }
+
+  // 同一 clientID 重复连接时断开旧连接
+  auto it = _sessions.find(clientID);
+  if (it != _sessions.end() && it->second->_conn) {
+    Close(it->second->_conn->_fd, true);
+    it = _sessions.find(clientID);
+  }
+  if (it != _sessions.end() && clean) {
+    RemoveSession(*it->second);
+    it = _sessions.end();
+  }
+  const bool present = it != _sessions.end();
+  if (!present) {
+    auto session = std::make_unique<Session>();
+    session->_clientID = clientID;
+    it = _sessions.emplace(clientID, std::move(session)).first;
+  }
+  auto &session = *it->second;
+  session._clean = clean;
+  session._conn = &conn;
+  conn._session = &session;
+  conn._keepAlive = keepAlive;
+
+  connack(present ? 1 : 0, 0x00);
+  if (present) {
+    Resume(session);
+  }
+  return true;
+}
+
+auto MqttBrokerImpl::HandlePublish(Connection &conn, uint8_t header, std::string_view body)
+    -> bool {
+  const uint8_t qos = (header >> 1) & 0x03;
+  if (qos > 2) {
+    return false;
+  }
+  Reader r{body};
+  auto topic = r.Str();
+  uint16_t id = qos > 0 ? r.U16() : 0;
+  auto payload = r.Rest();
+  if (!r.Ok() || topic.empty() || topic.find_first_of("+#") != std::string_view::npos ||
+      (qos > 0 && id == 0)) {
+    return false;
+  }
+  _received.fetch_add(1, std::memory_order_relaxed);
+
+  auto &session = *conn._session;
+  if (qos == 2) {
+    // 收到 PUBREL 之前的重发只回 PUBREC，不重复分发
+    WriteAck(conn, static_cast<uint8_t>(ePubrec << 4), id);
+    if (!session._incoming.insert(id).second) {
+      return true;
+    }
+  } else if (qos == 1) {
+    WriteAck(conn, static_cast<uint8_t>(ePuback << 4), id);
+  }
+  Route({std::string(topic), std::make_shared<const std::string>(payload), qos,
+         static_cast<bool>(header & 0x01)});
+  return true;
+}
+
+auto MqttBrokerImpl::HandleAck(Connection &conn, uint8_t type, std::string_view body) -> bool {
+  Reader r{body};
+  auto id = r.U16();
+  if (!r.Ok()) {
+    return false;
+  }
+  auto &session = *conn._session;
+  switch (type) {
+  case ePubrel:
+    session._incoming.erase(id);
+    WriteAck(conn, static_cast<uint8_t>(ePubcomp << 4), id);
+    return true;
+  case ePubrec:
+    if (auto it = session._inflight.find(id); it != session._inflight.end()) {
+      it->second._released = true;
+    }
+    WriteAck(conn, static_cast<uint8_t>((ePubrel << 4) | 0x02), id);
+    return true;
+  case ePuback:
+  case ePubcomp:
+    if (session._inflight.erase(id) && !session._queue.empty()) {
+      Drain(session);
+    }
+    return true;
+  default:
+    return false;
+  }
+}
+
+auto MqttBrokerImpl::HandleSubscribe(Connection &conn, std::string_view body) -> bool {
+  Reader r{body};
+  auto id = r.U16();
+  std::vector<std::pair<std::string_view, uint8_t>> filters;
+  while (r.Ok() && !r.Empty()) {
+    auto filter = r.Str();
+    auto qos = r.U8();
+    filters.emplace_back(filter, qos);
+  }
+  if (!r.Ok() || filters.empty()) {
+    return false;
+  }
+
+  std::string suback;
+  suback.push_back(static_cast<char>(eSuback << 4));
+  PutLength(suback, 2 + filters.size());
+  PutU16(suback, id);
+  for (auto &[filter, qos] : filters) {
+    if (qos > 2 || !TopicRouter::Valid(filter)) {
+      suback.push_back(static_cast<char>(0x80));
+      qos = 0x80;
+      continue;
+    }
+    suback.push_back(static_cast<char>(qos));
+    AddSubscription(*conn._session, filter, qos);
+  }
+  Write(conn, suback);
+
+  // SUBACK 之后发送匹配的保留消息
+  for (const auto &[filter, qos] : filters) {
+    if (qos > 2) {
+      continue;
+    }
+    for (const auto &[topic, msg] : _retained) {
+      if (TopicRouter::Matches(filter, topic)) {
+        Deliver(*conn._session, msg, std::min(qos, msg._qos), true);
+      }
+    }
+  }
+  return true;
+}
+
+auto MqttBrokerImpl::HandleUnsubscribe(Connection &conn, std::string_view body) -> bool {
+  Reader r{body};
+  auto id = r.U16();
+  while (r.Ok() && !r.Empty()) {
+    RemoveSubscription(*conn._session, r.Str());
+  }
+  if (!r.Ok()) {
+    return false;
+  }
+  WriteAck(conn, static_cast<uint8_t>(eUnsuback << 4), id);
+  return true;
+}
+
+auto MqttBrokerImpl::Write(Connection &conn, std::string_view data) -> void {
+  conn._out.append(data);
+  if (!conn._dirty) {
+    conn._dirty = true;
+    _dirty.push_back(conn._fd);
+  }
+}
+
+auto MqttBrokerImpl::WriteAck(Connection &conn, uint8_t header, uint16_t id) -> void {
+  const char packet[] = {static_cast<char>(header), 2, static_cast<char>(id >> 8),
+                         static_cast<char>(id & 0xff)};
+  Write(conn, {packet, sizeof(packet)});
+}
+
+auto MqttBrokerImpl::WritePublish(Connection &conn, const Message &msg, uint8_t qos, uint16_t id,
+                                  bool dup, bool retain) -> void {
+  auto &out = conn._out;
+  out.push_back(static_cast<char>((ePublish << 4) | (dup ? 0x08 : 0) | (qos << 1) |
+                                  (retain ? 0x01 : 0)));
+  PutLength(out, 2 + msg._topic.size() + (qos > 0 ? 2 : 0) + msg._payload->size());
+  PutStr(out, msg._topic);
+  if (qos > 0) {
+    PutU16(out, id);
+  }
+  Write(conn, *msg._payload);
+  _sent.fetch_add(1, std::memory_order_relaxed);
+}
+
+auto MqttBrokerImpl::Route(Message msg) -> void {
+  if (msg._retain) {
+    if (msg._payload->empty()) {
+      _retained.erase(msg._topic);
+    } else {
+      _retained.insert_or_assign(msg._topic, msg);
+    }
+  }
+
+  // 多个过滤器匹配同一会话时只发一次，取最大 qos
+  thread_local std::vector<std::pair<Session *, uint8_t>> targets;
+  targets.clear();
+  auto collect = [&](const Subscribers &subscribers) {
+    for (const auto &[session, qos] : subscribers) {
+      auto it = std::find_if(targets.begin(), targets.end(),
+                             [s = session](const auto &t) { return t.first == s; });
+      if (it == targets.end()) {
+        targets.emplace_back(session, qos);
+      } else {
+        it->second = std::max(it->second, qos);
+      }
+    }
+  };
+  if (auto it = _exact.find(msg._topic); it != _exact.end()) {
+    collect(it->second);
+  }
+  for (const auto &[filter, subscribers] : _wildcard) {
+    if (TopicRouter::Matches(filter, msg._topic)) {
+      collect(subscribers);
+    }
+  }
+  for (const auto &[session, qos] : targets) {
+    Deliver(*session, msg, std::min(qos, msg._qos), false);
+  }
+}
+
+auto MqttBrokerImpl::Deliver(Session &session, const Message &msg, uint8_t qos, bool retain)
+    -> void {
+  auto *conn = session._conn;
+  if (qos == 0) {
+    if (!conn || conn->_out.size() - conn->_outPos > _config._maxOutputBytes) {
+      _dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    WritePublish(*conn, msg, 0, 0, false, retain);
+    return;
+  }
+
+  if (!conn || !session._queue.empty() || session._inflight.size() >= 65535) {
+    if (session._queue.size() >= _config._maxQueuedMessages) {
+      session._queue.pop_front();
+      _dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    auto queued = msg;
+    queued._qos = qos;
+    queued._retain = retain;
+    session._queue.push_back(std::move(queued));
+    return;
+  }
+  auto id = NextPacketID(session);
+  auto &inflight = session._inflight[id];
+  inflight._msg = msg;
+  inflight._msg._qos = qos;
+  inflight._msg._retain = retain;
+  WritePublish(*conn, msg, qos, id, false, retain);
+}
+
+auto MqttBrokerImpl::Drain(Session &session) -> void {
+  while (session._conn && !session._queue.empty() && session._inflight.size() < 65535) {
+    auto msg = std::move(session._queue.front());
+    session._queue.pop_front();
+    auto id = NextPacketID(session);
+    WritePublish(*session._conn, msg, msg._qos, id, false, msg._retain);
+    session._inflight[id] = {std::move(msg), false};
+  }
+}
+
+auto MqttBrokerImpl::NextPacketID(Session &session) -> uint16_t {
+  do {
+    ++session._nextID;
+  } while (session._nextID == 0 || session._inflight.contains(session._nextID));
+  return session._nextID;
+}
+
+auto MqttBrokerImpl::Resume(Session &session) -> void {
+  // 持久会话重连，未确认的消息按原 packet id 重发
+  auto &conn = *session._conn;
+  for (const auto &[id, inflight] : session._inflight) {
+    if (inflight._released) {
+      WriteAck(conn, static_cast<uint8_t>((ePubrel << 4) | 0x02), id);
+    } else {
+      WritePublish(conn, inflight._msg, inflight._msg._qos, id, true, inflight._msg._retain);
+    }
+  }
+  Drain(session);
+}
+
+auto MqttBrokerImpl::AddSubscription(Session &session, std::string_view filter, uint8_t qos)
+    -> void {
+  session._subscriptions.insert_or_assign(std::string(filter), qos);
+  if (filter.find_first_of("+#") == std::string_view::npos) {
+    auto it = _exact.find(filter);
+    if (it == _exact.end()) {
+      it = _exact.emplace(std::string(filter), Subscribers{}).first;
+    }
+    it->second[&session] = qos;
+  } else {
+    auto it = _wildcard.find(filter);
+    if (it == _wildcard.end()) {
+      it = _wildcard.emplace(std::string(filter), Subscribers{}).first;
+    }
+    it->second[&session] = qos;
+  }
+}
+
+auto MqttBrokerImpl::RemoveSubscription(Session &session, std::string_view filter) -> void {
+  auto sub = session._subscriptions.find(filter);
+  if (sub == session._subscriptions.end()) {
+    return;
+  }
+  session._subscriptions.erase(sub);
+  auto remove = [&](auto &index) {
+    if (auto it = index.find(filter); it != index.end()) {
+      it->second.erase(&session);
+      if (it->second.empty()) {
+        index.erase(it);
+      }
+    }
+  };
+  if (filter.find_first_of("+#") == std::string_view::npos) {
+    remove(_exact);
+  } else {
+    remove(_wildcard);
+  }
+}
+
+auto MqttBrokerImpl::RemoveSession(Session &session) -> void {
+  while (!session._subscriptions.empty()) {
+    std::string filter = session._subscriptions.begin()->first;
+    RemoveSubscription(session, filter);
+  }
+  auto clientID = session._clientID; // session 随 erase 释放
+  _sessions.erase(clientID);
+}
+
+///////////////////////////////////////////
+auto MqttBroker::Config::to_string() const -> std::string {
+  return DSG_STR("MqttBroker{address:" << _address << ", max_queued:" << _maxQueuedMessages
+                                       << "}");
+}
+
+auto MqttBroker::Stats::to_string() const -> std::string {
+  return DSG_STR("BrokerStats{clients:" << _clients << ", received:" << _received
+                                        << ", sent:" << _sent << ", dropped:" << _dropped
+                                        << "}");
+}
+
+auto MqttBroker::Request(const Config &config) -> interface_ptr<MqttBroker> {
+  return make_ptr<MqttBrokerImpl>(config);
+}
+} // namespace dsg
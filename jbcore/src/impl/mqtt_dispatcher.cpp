@@ -0,0 +1,201 @@
+#include "def.hpp"
+#include "mqtt_dispatcher.hpp"
+
+namespace dsg {
+namespace {
+inline auto NowNs() -> int64_t {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+/// @brief 当前工作线程所属分片，回调中再投递事件时不等待自己
+thread_local const void *tlsShard = nullptr;
+} // namespace
+
+MqttDispatcher::MqttDispatcher(std::size_t queueSize, int threads, Handler handler)
+    : _handler{std::move(handler)} {
+  for (int i = 0; i < std::max(1, threads); ++i) {
+    _shards.push_back(std::make_unique<Shard>(queueSize));
+  }
+}
+
+MqttDispatcher::~MqttDispatcher() {
+  Stop();
+}
+
+auto MqttDispatcher::Start() -> void {
+  if (_running.exchange(true)) {
+    return;
+  }
+  for (auto &shard : _shards) {
+    shard->_worker = std::thread([this, s = shard.get()] { Run(*s); });
+  }
+}
+
+auto MqttDispatcher::Stop() -> void {
+  if (!_running.exchange(false)) {
+    return;
+  }
+  for (auto &shard : _shards) {
+    Wake(*shard);
+    std::lock_guard<std::mutex> lock{shard->_mutex};
+    shard->_drained.notify_all();
+  }
+  for (auto &shard : _shards) {
+    if (shard->_worker.joinable()) {
+      shard->_worker.join();
+    }
+  }
+
+  // 停止后残留的事件在当前线程按序执行完
+  MqttEvent ev;
+  for (auto &shard : _shards) {
+    do {
+      while (shard->_ring.pop(ev)) {
+        Handle(ev);
+      }
+    } while (Drain(*shard));
+  }
+}
+
+auto MqttDispatcher::Post(MqttEvent &ev) -> bool {
+  auto &shard = ShardOf(ev);
+  ev._postNs = NowNs();
+  // 有溢出的事件未取走时也拒绝，不越过先到的事件
+  if (shard._overflowed.load(std::memory_order_acquire) || !shard._ring.push(std::move(ev))) {
+    _rejected.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  _posted.fetch_add(1, std::memory_order_relaxed);
+  Wake(shard);
+  return true;
+}
+
+auto MqttDispatcher::Queue(MqttEvent &ev) -> void {
+  auto &shard = ShardOf(ev);
+  ev._postNs = NowNs();
+  if (!shard._overflowed.load(std::memory_order_acquire) && shard._ring.push(std::move(ev))) {
+    _posted.fetch_add(1, std::memory_order_relaxed);
+    Wake(shard);
+    return;
+  }
+  {
+    std::unique_lock<std::mutex> lock{shard._mutex};
+    if (tlsShard != &shard) {
+      shard._drained.wait(lock, [&] {
+        return shard._overflow.size() < shard._ring.capacity() ||
+               !_running.load(std::memory_order_acquire);
+      });
+    }
+    shard._overflow.push_back(std::move(ev));
+    shard._overflowed.store(true, std::memory_order_release);
+  }
+  _posted.fetch_add(1, std::memory_order_relaxed);
+  _overflowed.fetch_add(1, std::memory_order_relaxed);
+  Wake(shard);
+}
+
+auto MqttDispatcher::Capacity() const -> std::size_t {
+  std::size_t n = 0;
+  for (auto &shard : _shards) {
+    n += shard->_ring.capacity();
+  }
+  return n;
+}
+
+auto MqttDispatcher::ShardOf(const MqttEvent &ev) -> Shard & {
+  if (_shards.size() > 1 && ev._kind == MqttEvent::Kind::eMessageArrived && ev._message) {
+    auto h = std::hash<std::string_view>{}(ev._message->topic());
+    return *_shards[h % _shards.size()];
+  }
+  return *_shards.front();
+}
+
+auto MqttDispatcher::Wake(Shard &shard) -> void {
+  shard._signal.fetch_add(1, std::memory_order_release);
+  shard._signal.notify_one();
+}
+
+auto MqttDispatcher::Run(Shard &shard) -> void {
+  tlsShard = &shard;
+  MqttEvent ev;
+  while (_running.load(std::memory_order_acquire)) {
+    // 溢出列表中的事件都晚于队列中已有的事件，队列取空后再取
+    if (shard._ring.pop(ev)) {
+      Handle(ev);
+      continue;
+    }
+    if (Drain(shard)) {
+      continue;
+    }
+    auto s = shard._signal.load(std::memory_order_acquire);
+    if (shard._ring.pop(ev)) {
+      Handle(ev);
+      continue;
+    }
+    if (shard._overflowed.load(std::memory_order_acquire) ||
+        !_running.load(std::memory_order_acquire)) {
+      continue;
+    }
+    shard._signal.wait(s, std::memory_order_acquire);
+  }
+  tlsShard = nullptr;
+}
+
+auto MqttDispatcher::Drain(Shard &shard) -> bool {
+  if (!shard._overflowed.load(std::memory_order_acquire)) {
+    return false;
+  }
+  std::deque<MqttEvent> batch;
+  {
+    std::lock_guard<std::mutex> lock{shard._mutex};
+    batch.swap(shard._overflow);
+    shard._overflowed.store(false, std::memory_order_release);
+  }
+  shard._drained.notify_all();
+  for (auto &ev : batch) {
+    Handle(ev);
+  }
+  return !batch.empty();
+}
+
+auto MqttDispatcher::Handle(MqttEvent &ev) -> void {
+  auto latency = NowNs() - ev._postNs;
+  _latencySumNs.fetch_add(latency, std::memory_order_relaxed);
+  auto max = _latencyMaxNs.load(std::memory_order_relaxed);
+  while (latency > max &&
+         !_latencyMaxNs.compare_exchange_weak(max, latency, std::memory_order_relaxed)) {
+  }
+
+  try {
+    _handler(ev);
+  } catch (const std::exception &e) {
+    DSG_ERROR("mqtt callback exception: " << e.what());
+  }
+  _dispatched.fetch_add(1, std::memory_order_relaxed);
+
+  // 释放负载，避免长期占用
+  ev = MqttEvent{};
+}
+
+auto MqttDispatcher::Stats() const -> Mqtt::DispatchStats {
+  Mqtt::DispatchStats s;
+  for (auto &shard : _shards) {
+    s._depth += shard->_ring.size();
+    s._capacity += shard->_ring.capacity();
+    std::lock_guard<std::mutex> lock{shard->_mutex};
+    s._depth += shard->_overflow.size();
+  }
+  s._posted = _posted.load(std::memory_order_relaxed);
+  s._dispatched = _dispatched.load(std::memory_order_relaxed);
+  s._rejected = _rejected.load(std::memory_order_relaxed);
+  s._overflowed = _overflowed.load(std::memory_order_relaxed);
+  s._avgLatencyUs =
+      s._dispatched ? _latencySumNs.load(std::memory_order_relaxed) / 1000 /
+                          static_cast<int64_t>(s._dispatched)
+                    : 0;
+  s._maxLatencyUs = _latencyMaxNs.load(std::memory_order_relaxed) / 1000;
+  return s;
+}
+} // namespace dsg
@@ -0,0 +1,118 @@
+/**
+ * @file mqtt_dispatcher.hpp
+ * @brief mqtt 回调分发器
+ *
+ * paho 网络线程只把事件压入无锁环形队列，由工作线程执行用户回调，
+ * 避免慢回调阻塞网络收发和心跳。
+ * 每个工作线程一个分片（队列），消息事件按 topic 哈希选分片，同一 topic 的消息按到达顺序回调；
+ * 连接、断开、发送、订阅等其余事件都进第一个分片，彼此之间按发生顺序回调。
+ * 不同 topic 之间、消息与其余事件之间不保证顺序。
+ * 消息事件在队列满时拒绝，由 paho 稍后重新投递；其余事件转入分片的溢出列表，
+ * 由工作线程在队列之后按序取走，溢出列表也满时投递方等待（背压），不在网络线程执行回调。
+ */
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "mqtt.hpp"
+#include "ring.hpp"
+
+namespace dsg {
+struct MqttEvent {
+  enum class Kind : uint8_t {
+    eNone,
+    eConnectionLost,
+    eMessageArrived,
+    eConnect,
+    eDisconnect,
+    eSend,
+    eSubscribe,
+    eUnsubscribe,
+    eSubscribeMany,
+    eUnsubscribeMany,
+  };
+
+  Kind _kind{Kind::eNone};
+  bool _success{false};
+  Mqtt::Topic _topic{};
+  std::vector<Mqtt::Topic> _topics{};
+  std::string _msg{};
+  Mqtt::MessagePtr _message{};
+  int64_t _postNs{0};
+};
+
+class MqttDispatcher final {
+public:
+  using Handler = std::function<void(MqttEvent &)>;
+
+  /// @param queueSize 每个分片的队列容量
+  /// @param threads 工作线程数，即分片数
+  /// @param handler
+  MqttDispatcher(std::size_t queueSize, int threads, Handler handler);
+  ~MqttDispatcher();
+
+  MqttDispatcher(const MqttDispatcher &) = delete;
+  MqttDispatcher &operator=(const MqttDispatcher &) = delete;
+
+  auto Start() -> void;
+  auto Stop() -> void;
+
+  /// @brief 投递消息事件，队列满或分片有溢出的事件未取走时返回 false，ev 保持不变
+  /// @param ev
+  /// @return
+  auto Post(MqttEvent &ev) -> bool;
+
+  /// @brief 投递其余事件，不拒绝；队列满时转入溢出列表，溢出列表也满时等待工作线程取走
+  /// @param ev
+  auto Queue(MqttEvent &ev) -> void;
+
+  /// @brief 所有分片的队列总容量
+  auto Capacity() const -> std::size_t;
+
+  auto Stats() const -> Mqtt::DispatchStats;
+
+private:
+  struct Shard {
+    explicit Shard(std::size_t capacity) : _ring{capacity} {
+    }
+
+    utils::mpmc_ring<MqttEvent> _ring;
+    std::thread _worker;
+    std::atomic<uint32_t> _signal{0};
+
+    // 队列满时的非消息事件，非空期间新事件也进溢出列表，保持顺序
+    std::mutex _mutex;
+    std::condition_variable _drained;
+    std::deque<MqttEvent> _overflow;
+    std::atomic<bool> _overflowed{false};
+  };
+
+  auto ShardOf(const MqttEvent &ev) -> Shard &;
+  auto Run(Shard &shard) -> void;
+  /// @brief 取走溢出列表中的全部事件并执行
+  /// @return 是否有事件
+  auto Drain(Shard &shard) -> bool;
+  auto Wake(Shard &shard) -> void;
+  auto Handle(MqttEvent &ev) -> void;
+
+private:
+  std::vector<std::unique_ptr<Shard>> _shards;
+  Handler _handler;
+  std::atomic<bool> _running{false};
+
+  // stats
+  std::atomic<uint64_t> _posted{0};
+  std::atomic<uint64_t> _dispatched{0};
+  std::atomic<uint64_t> _rejected{0};
+  std::atomic<uint64_t> _overflowed{0};
+  std::atomic<int64_t> _latencySumNs{0};
+  std::atomic<int64_t> _latencyMaxNs{0};
+};
+} // namespace dsg
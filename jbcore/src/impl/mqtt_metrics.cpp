@@ -0,0 +1,90 @@
+#include "def.hpp"
+#include "mqtt_metrics.hpp"
+
+#include <bit>
+
+namespace dsg {
+namespace {
+inline auto NowNs() -> int64_t {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+} // namespace
+
+auto MqttMetrics::Published(bool success, int token, std::size_t bytes) -> void {
+  if (!success) {
+    _failed.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  _sent.fetch_add(1, std::memory_order_relaxed);
+  _bytesOut.fetch_add(bytes, std::memory_order_relaxed);
+  _inflight.fetch_add(1, std::memory_order_relaxed);
+  const auto tag = static_cast<uint64_t>(token & 0xffff);
+  const auto us = static_cast<uint64_t>(NowNs() / 1000) & ((uint64_t{1} << kTimeBits) - 1);
+  _sendUs[tag % kSlots].store(tag << kTimeBits | us, std::memory_order_relaxed);
+}
+
+auto MqttMetrics::Acked(bool success, int token) -> void {
+  _inflight.fetch_sub(1, std::memory_order_relaxed);
+  if (!success) {
+    _failed.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  _acked.fetch_add(1, std::memory_order_relaxed);
+
+  const auto tag = static_cast<uint64_t>(token & 0xffff);
+  const auto slot = _sendUs[tag % kSlots].exchange(0, std::memory_order_relaxed);
+  if (slot == 0 || slot >> kTimeBits != tag) {
+    return; // 槽位已被其他 token 覆盖
+  }
+  const auto mask = (uint64_t{1} << kTimeBits) - 1;
+  const auto rtt = ((static_cast<uint64_t>(NowNs() / 1000) & mask) - (slot & mask)) & mask;
+  const auto bucket = std::min<std::size_t>(std::bit_width(rtt), _ackRtt.size() - 1);
+  _ackRtt[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+auto MqttMetrics::Received(std::size_t bytes) -> void {
+  _received.fetch_add(1, std::memory_order_relaxed);
+  _bytesIn.fetch_add(bytes, std::memory_order_relaxed);
+  _lastInboundNs.store(NowNs(), std::memory_order_relaxed);
+}
+
+auto MqttMetrics::Connecting() -> void {
+  _connectStartNs.store(NowNs(), std::memory_order_relaxed);
+}
+
+auto MqttMetrics::Connected() -> void {
+  _connects.fetch_add(1, std::memory_order_relaxed);
+  if (auto start = _connectStartNs.exchange(0, std::memory_order_relaxed); start > 0) {
+    _connectLatencyUs.store((NowNs() - start) / 1000, std::memory_order_relaxed);
+  }
+}
+
+auto MqttMetrics::ConnectionLost() -> void {
+  _connectionLost.fetch_add(1, std::memory_order_relaxed);
+  _connectStartNs.store(NowNs(), std::memory_order_relaxed);
+}
+
+auto MqttMetrics::Snapshot() const -> Mqtt::Metrics {
+  Mqtt::Metrics m;
+  m._sent = _sent.load(std::memory_order_relaxed);
+  m._acked = _acked.load(std::memory_order_relaxed);
+  m._failed = _failed.load(std::memory_order_relaxed);
+  m._inflight = std::max<int64_t>(_inflight.load(std::memory_order_relaxed), 0);
+  m._received = _received.load(std::memory_order_relaxed);
+  m._bytesOut = _bytesOut.load(std::memory_order_relaxed);
+  m._bytesIn = _bytesIn.load(std::memory_order_relaxed);
+  auto connects = _connects.load(std::memory_order_relaxed);
+  m._reconnects = connects > 0 ? connects - 1 : 0;
+  m._connectionLost = _connectionLost.load(std::memory_order_relaxed);
+  m._connectLatencyUs = _connectLatencyUs.load(std::memory_order_relaxed);
+  if (auto last = _lastInboundNs.load(std::memory_order_relaxed); last > 0) {
+    m._sinceLastInboundMs = (NowNs() - last) / 1000000;
+  }
+  for (std::size_t i = 0; i < _ackRtt.size(); ++i) {
+    m._ackRtt[i] = _ackRtt[i].load(std::memory_order_relaxed);
+  }
+  return m;
+}
+} // namespace dsg
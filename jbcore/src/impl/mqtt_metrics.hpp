@@ -0,0 +1,60 @@
+/**
+ * @file mqtt_metrics.hpp
+ * @brief mqtt 连接和收发指标
+ *
+ * 计数全部为 relaxed 原子操作，在发送路径和 paho 网络线程上更新，读取时汇总成快照。
+ * 应答往返时间按 paho token 记录发送时刻：token 低位索引固定大小的槽位，
+ * 槽位同时保存 token，在途消息超过槽位数或应答先于记录到达时该样本丢弃，不影响计数。
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+#include "mqtt.hpp"
+
+namespace dsg {
+class MqttMetrics final {
+public:
+  /// @brief 发布交给 paho 后调用
+  /// @param success 交给 paho 是否成功
+  /// @param token paho 分配的 token
+  /// @param bytes 负载字节数
+  auto Published(bool success, int token, std::size_t bytes) -> void;
+
+  /// @brief 发送结果回调中调用
+  /// @param success
+  /// @param token
+  auto Acked(bool success, int token) -> void;
+
+  auto Received(std::size_t bytes) -> void;
+
+  /// @brief 开始连接，作为连接耗时的起点
+  auto Connecting() -> void;
+  auto Connected() -> void;
+  auto ConnectionLost() -> void;
+
+  /// @brief 读取快照，_connected 由调用方填写
+  auto Snapshot() const -> Mqtt::Metrics;
+
+private:
+  static constexpr std::size_t kSlots = 1024;
+  static constexpr int kTimeBits = 48;
+
+  std::atomic<uint64_t> _sent{0};
+  std::atomic<uint64_t> _acked{0};
+  std::atomic<uint64_t> _failed{0};
+  std::atomic<int64_t> _inflight{0};
+  std::atomic<uint64_t> _received{0};
+  std::atomic<uint64_t> _bytesOut{0};
+  std::atomic<uint64_t> _bytesIn{0};
+  std::atomic<uint64_t> _connects{0};
+  std::atomic<uint64_t> _connectionLost{0};
+  std::atomic<int64_t> _connectStartNs{0};
+  std::atomic<int64_t> _connectLatencyUs{-1};
+  std::atomic<int64_t> _lastInboundNs{0};
+  std::array<std::atomic<uint64_t>, Mqtt::Metrics::kRttBuckets> _ackRtt{};
+  std::array<std::atomic<uint64_t>, kSlots> _sendUs{}; // token << 48 | 发送时刻 us
+};
+} // namespace dsg
@@ -0,0 +1,279 @@
+#include "def.hpp"
+#include "mqtt.hpp"
+
+namespace dsg {
+#define DSG_Err RV::eErrMqtt
+
+//////////////////////////////////////////
+/// @brief 多连接客户端，对外与单个 Mqtt 相同
+///
+/// 发送按 topic 哈希固定到一个连接，同一 topic 的消息保持顺序；
+/// 订阅及其处理函数只放在第一个连接上，避免同一消息收到多份。
+/// 连接状态汇总：全部连接建立后回调一次 _connectCallback，全部断开后回调一次
+/// _disconnectCallback，单个连接的失败和断线带上该连接的 clientID 转发。
+/// 各连接的回调在各自的线程执行，可能并发。
+class MqttPool : public interface_wrapper<Mqtt> {
+public:
+  MqttPool(const Config &config, int clients);
+  ~MqttPool();
+
+  MqttPool(const MqttPool &) = delete;
+  MqttPool &operator=(const MqttPool &) = delete;
+
+  auto Connect() -> Result override;
+  auto Disconnect() -> Result override;
+  auto ReConnect() -> Result override;
+  auto IsConnected() -> bool override;
+  auto Send(const Topic &topic, const std::string &textMsg) -> Result override;
+  auto Send(const Topic &topic, const std::vector<uint8_t> &payload) -> Result override;
+  auto Send(const Topic &topic, std::span<const uint8_t> payload, const SendOptions &options)
+      -> Result override;
+  auto Subscribe(const Topic &topic) -> Result override;
+  auto Subscribe(const Topic &topic, MessageHandler handler) -> Result override;
+  auto Unsubscribe(const Topic &topic) -> Result override;
+  auto Subscribe(std::span<const Topic> topics) -> Result override;
+  auto Unsubscribe(std::span<const Topic> topics) -> Result override;
+  auto LastValue(std::string_view topic, std::vector<uint8_t> &payload) -> bool override;
+  auto GetDispatchStats() -> DispatchStats override;
+  auto GetScheduleStats() -> ScheduleStats override;
+  auto GetMetrics() -> Metrics override;
+
+private:
+  /// @brief 替换连接状态相关回调，汇总后再回调用户
+  /// @param config
+  /// @param index
+  /// @return
+  auto ClientConfig(const Config &config, std::size_t index) -> Config;
+  auto Shard(const Topic &topic) -> Mqtt &;
+  auto OnConnect(std::size_t index, bool success, std::string_view msg) -> void;
+  auto OnDisconnect(std::size_t index, bool success, std::string_view msg) -> void;
+  auto OnConnectLost(std::size_t index, std::string_view cause) -> void;
+
+  template <typename F> auto ForEach(F &&f) -> Result {
+    bool ok = true;
+    for (auto &client : _clients) {
+      ok = static_cast<bool>(f(*client)) && ok;
+    }
+    return ok ? Result{RV::eSuccess} : Result{DSG_Err};
+  }
+
+private:
+  Config _config;
+  std::unique_ptr<std::atomic<bool>[]> _states; // 各连接是否已连接
+  std::atomic<int> _connected{0};
+  std::vector<interface_ptr<Mqtt>> _clients; // 最后声明，先于回调用到的状态析构
+};
+
+//////////////////////////////////////////
+MqttPool::MqttPool(const Config &config, int clients)
+    : _config{config}, _states{std::make_unique<std::atomic<bool>[]>(std::max(1, clients))} {
+  const auto count = static_cast<std::size_t>(std::max(1, clients));
+  DSG_LOG("MqttPool{clients:" << count << ", " << _config.to_string() << "}");
+  _clients.reserve(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    _clients.push_back(Mqtt::Request(ClientConfig(config, i)));
+  }
+}
+
+MqttPool::~MqttPool() {
+  // 先销毁各连接，停止回调
+  _clients.clear();
+}
+
+auto MqttPool::ClientConfig(const Config &config, std::size_t index) -> Config {
+  Config c = config;
+  c._clientID = DSG_STR(config._clientID << "-" << index);
+  c._connectCallback = [this, index](bool success, std::string_view msg) {
+    OnConnect(index, success, msg);
+  };
+  c._disconnectCallback = [this, index](bool success, std::string_view msg) {
+    OnDisconnect(index, success, msg);
+  };
+  c._connectLostCallback = [this, index](std::string_view cause) {
+    OnConnectLost(index, cause);
+  };
+  if (index > 0) {
+    // 只有第一个连接订阅，其余连接不会收到消息
+    c._messageArrivedCallback = {};
+    c._messageCallback = {};
+    c._lastValueTopics = 0;
+  }
+  return c;
+}
+
+auto MqttPool::Shard(const Topic &topic) -> Mqtt & {
+  auto h = std::hash<std::string_view>{}(topic._name);
+  return *_clients[h % _clients.size()];
+}
+
+auto MqttPool::OnConnect(std::size_t index, bool success, std::string_view msg) -> void {
+  if (!success) {
+    if (_config._connectCallback) {
+      _config._connectCallback(false, DSG_STR(_config._clientID << "-" << index << ": " << msg));
+    }
+    return;
+  }
+  // 自动重连后再次凑齐全部连接时也会回调
+  if (!_states[index].exchange(true) &&
+      _connected.fetch_add(1) + 1 == static_cast<int>(_clients.size()) &&
+      _config._connectCallback) {
+    _config._connectCallback(true, msg);
+  }
+}
+
+auto MqttPool::OnDisconnect(std::size_t index, bool success, std::string_view msg) -> void {
+  if (!success) {
+    if (_config._disconnectCallback) {
+      _config._disconnectCallback(false,
+                                  DSG_STR(_config._clientID << "-" << index << ": " << msg));
+    }
+    return;
+  }
+  if (_states[index].exchange(false) && _connected.fetch_sub(1) - 1 == 0 &&
+      _config._disconnectCallback) {
+    _config._disconnectCallback(true, msg);
+  }
+}
+
+auto MqttPool::OnConnectLost(std::size_t index, std::string_view cause) -> void {
+  if (_states[index].exchange(false)) {
+    _connected.fetch_sub(1);
+  }
+  if (_config._connectLostCallback) {
+    _config._connectLostCallback(DSG_STR(_config._clientID << "-" << index << ": " << cause));
+  }
+}
+
+auto MqttPool::Connect() -> Result {
+  return ForEach([](Mqtt &c) { return c.Connect(); });
+}
+
+auto MqttPool::Disconnect() -> Result {
+  return ForEach([](Mqtt &c) { return c.Disconnect(); });
+}
+
+auto MqttPool::ReConnect() -> Result {
+  return ForEach([](Mqtt &c) { return c.ReConnect(); });
+}
+
+auto MqttPool::IsConnected() -> bool {
+  return std::all_of(_clients.begin(), _clients.end(),
+                     [](const interface_ptr<Mqtt> &c) { return c->IsConnected(); });
+}
+
+auto MqttPool::Send(const Topic &topic, const std::string &textMsg) -> Result {
+  return Shard(topic).Send(topic, textMsg);
+}
+
+auto MqttPool::Send(const Topic &topic, const std::vector<uint8_t> &payload) -> Result {
+  return Shard(topic).Send(topic, payload);
+}
+
+auto MqttPool::Send(const Topic &topic, std::span<const uint8_t> payload,
+                    const SendOptions &options) -> Result {
+  return Shard(topic).Send(topic, payload, options);
+}
+
+auto MqttPool::Subscribe(const Topic &topic) -> Result {
+  return _clients.front()->Subscribe(topic);
+}
+
+auto MqttPool::Subscribe(const Topic &topic, MessageHandler handler) -> Result {
+  return _clients.front()->Subscribe(topic, std::move(handler));
+}
+
+auto MqttPool::Unsubscribe(const Topic &topic) -> Result {
+  return _clients.front()->Unsubscribe(topic);
+}
+
+auto MqttPool::Subscribe(std::span<const Topic> topics) -> Result {
+  return _clients.front()->Subscribe(topics);
+}
+
+auto MqttPool::Unsubscribe(std::span<const Topic> topics) -> Result {
+  return _clients.front()->Unsubscribe(topics);
+}
+
+auto MqttPool::LastValue(std::string_view topic, std::vector<uint8_t> &payload) -> bool {
+  return _clients.front()->LastValue(topic, payload);
+}
+
+auto MqttPool::GetDispatchStats() -> DispatchStats {
+  DispatchStats s;
+  int64_t latencySumUs = 0;
+  for (auto &client : _clients) {
+    auto c = client->GetDispatchStats();
+    s._depth += c._depth;
+    s._capacity += c._capacity;
+    s._posted += c._posted;
+    s._dispatched += c._dispatched;
+    s._rejected += c._rejected;
+    s._overflowed += c._overflowed;
+    latencySumUs += c._avgLatencyUs * static_cast<int64_t>(c._dispatched);
+    s._maxLatencyUs = std::max(s._maxLatencyUs, c._maxLatencyUs);
+  }
+  s._avgLatencyUs = s._dispatched ? latencySumUs / static_cast<int64_t>(s._dispatched) : 0;
+  return s;
+}
+
+auto MqttPool::GetScheduleStats() -> ScheduleStats {
+  ScheduleStats s;
+  std::array<int64_t, kPriorityCount> delaySumUs{};
+  for (auto &client : _clients) {
+    auto c = client->GetScheduleStats();
+    s._inflight += c._inflight;
+    s._window += c._window;
+    for (std::size_t i = 0; i < kPriorityCount; ++i) {
+      auto &l = s._lanes[i];
+      const auto &cl = c._lanes[i];
+      l._depth += cl._depth;
+      l._capacity += cl._capacity;
+      l._queued += cl._queued;
+      l._sent += cl._sent;
+      l._failed += cl._failed;
+      l._retried += cl._retried;
+      l._rejected += cl._rejected;
+      delaySumUs[i] += cl._avgDelayUs * static_cast<int64_t>(cl._sent + cl._failed);
+      l._maxDelayUs = std::max(l._maxDelayUs, cl._maxDelayUs);
+    }
+  }
+  for (std::size_t i = 0; i < kPriorityCount; ++i) {
+    auto &l = s._lanes[i];
+    auto done = static_cast<int64_t>(l._sent + l._failed);
+    l._avgDelayUs = done ? delaySumUs[i] / done : 0;
+  }
+  return s;
+}
+
+auto MqttPool::GetMetrics() -> Metrics {
+  Metrics m;
+  m._connected = true;
+  for (auto &client : _clients) {
+    auto c = client->GetMetrics();
+    m._connected = m._connected && c._connected;
+    m._sent += c._sent;
+    m._acked += c._acked;
+    m._failed += c._failed;
+    m._inflight += c._inflight;
+    m._received += c._received;
+    m._bytesOut += c._bytesOut;
+    m._bytesIn += c._bytesIn;
+    m._reconnects += c._reconnects;
+    m._connectionLost += c._connectionLost;
+    m._connectLatencyUs = std::max(m._connectLatencyUs, c._connectLatencyUs);
+    if (c._sinceLastInboundMs >= 0 &&
+        (m._sinceLastInboundMs < 0 || c._sinceLastInboundMs < m._sinceLastInboundMs)) {
+      m._sinceLastInboundMs = c._sinceLastInboundMs;
+    }
+    for (std::size_t i = 0; i < m._ackRtt.size(); ++i) {
+      m._ackRtt[i] += c._ackRtt[i];
+    }
+  }
+  return m;
+}
+
+///////////////////////////////////////////
+auto Mqtt::RequestPool(const Config &config, int clients) -> interface_ptr<Mqtt> {
+  return make_ptr<MqttPool>(config, clients);
+}
+} // namespace dsg
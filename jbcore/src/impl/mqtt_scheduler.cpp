@@ -0,0 +1,240 @@
+#include "def.hpp"
+#include "mqtt_scheduler.hpp"
+#include "topic_router.hpp"
+
+namespace dsg {
+namespace {
+constexpr int64_t kIdleWaitNs = 100'000'000; // 没有消息时的最长等待，防止意外漏唤醒
+constexpr int64_t kRetryNs = 200'000'000;    // 暂时失败后的重试间隔
+
+inline auto NowNs() -> int64_t {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+} // namespace
+
+MqttScheduler::TokenBucket::TokenBucket(const Mqtt::RateLimit &limit)
+    : _rate{limit._rate}, _burst{limit._burst > 0 ? limit._burst : std::max(1.0, limit._rate)},
+      _tokens{_burst}, _lastNs{NowNs()} {
+}
+
+auto MqttScheduler::TokenBucket::Refill(int64_t nowNs) -> int64_t {
+  if (!Limited()) {
+    return 0;
+  }
+  if (nowNs > _lastNs) {
+    _tokens = std::min(_burst, _tokens + static_cast<double>(nowNs - _lastNs) * _rate / 1e9);
+    _lastNs = nowNs;
+  }
+  if (_tokens >= 1) {
+    return 0;
+  }
+  return std::max<int64_t>(1, static_cast<int64_t>((1 - _tokens) / _rate * 1e9));
+}
+
+MqttScheduler::MqttScheduler(const Mqtt::Config &config, Sender sender)
+    : _sender{std::move(sender)},
+      _window{static_cast<int64_t>(std::max<std::size_t>(1, config._scheduleInflight))} {
+  for (std::size_t i = 0; i < Mqtt::kPriorityCount; ++i) {
+    auto lane = std::make_unique<Lane>(config._scheduleQueueSize);
+    lane->_bucket = TokenBucket{config._priorityRateLimits[i]};
+    _lanes.push_back(std::move(lane));
+  }
+  for (const auto &[filter, limit] : config._topicRateLimits) {
+    _topicBuckets.emplace_back(filter, TokenBucket{limit});
+  }
+}
+
+MqttScheduler::~MqttScheduler() {
+  Stop();
+}
+
+auto MqttScheduler::Start() -> void {
+  if (_running.exchange(true)) {
+    return;
+  }
+  _worker = std::thread([this] { Run(); });
+}
+
+auto MqttScheduler::Stop() -> void {
+  if (!_running.exchange(false)) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock{_mutex};
+    _cv.notify_all();
+  }
+  if (_worker.joinable()) {
+    _worker.join();
+  }
+
+  // 停止后不再发送，残留消息计为失败
+  std::size_t dropped = 0;
+  for (auto &lane : _lanes) {
+    MqttOutbound msg;
+    auto n = static_cast<uint64_t>(lane->_head.has_value());
+    lane->_head.reset();
+    while (lane->_ring.pop(msg)) {
+      ++n;
+    }
+    lane->_failed.fetch_add(n, std::memory_order_relaxed);
+    dropped += n;
+  }
+  if (dropped > 0) {
+    DSG_WARN("mqtt scheduler stopped, drop " << dropped << " messages");
+  }
+}
+
+auto MqttScheduler::Post(MqttOutbound &&msg) -> bool {
+  auto &lane = *_lanes[static_cast<std::size_t>(msg._options._priority)];
+  msg._postNs = NowNs();
+  if (!lane._ring.push(std::move(msg))) {
+    lane._rejected.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  lane._queued.fetch_add(1, std::memory_order_relaxed);
+  Wake();
+  return true;
+}
+
+auto MqttScheduler::OnAck() -> void {
+  // paho 断线清理时对未完成的发送也会回调失败，不会少于发出数；不低于 0 以防重复应答
+  auto n = _inflight.load(std::memory_order_relaxed);
+  while (n > 0 && !_inflight.compare_exchange_weak(n, n - 1, std::memory_order_relaxed)) {
+  }
+  if (n >= _window) {
+    Wake();
+  }
+}
+
+auto MqttScheduler::Wake() -> void {
+  // 与 Run 中的 _waiting/_signal 配对，两边都用 seq_cst，至少一方能看到对方的修改
+  _signal.fetch_add(1);
+  if (_waiting.load()) {
+    std::lock_guard<std::mutex> lock{_mutex};
+    _cv.notify_one();
+  }
+}
+
+auto MqttScheduler::Run() -> void {
+  while (_running.load(std::memory_order_acquire)) {
+    auto s = _signal.load();
+    int64_t waitNs = kIdleWaitNs;
+    auto now = NowNs();
+    if (auto i = Next(now, waitNs); i >= 0) {
+      Emit(*_lanes[i], now);
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock{_mutex};
+    _waiting.store(true);
+    _cv.wait_for(lock, std::chrono::nanoseconds(waitNs), [&] {
+      return _signal.load() != s || !_running.load(std::memory_order_acquire);
+    });
+    _waiting.store(false);
+  }
+}
+
+auto MqttScheduler::Next(int64_t nowNs, int64_t &waitNs) -> int {
+  // 窗口满时由 OnAck 唤醒，队首留在各自的队列中，腾出位置后重新按优先级选择
+  if (_inflight.load(std::memory_order_relaxed) >= _window) {
+    return -1;
+  }
+  if (nowNs < _retryNs) {
+    waitNs = std::min(waitNs, _retryNs - nowNs);
+    return -1;
+  }
+  for (std::size_t i = 0; i < _lanes.size(); ++i) {
+    auto &lane = *_lanes[i];
+    if (!lane._head) {
+      MqttOutbound msg;
+      if (!lane._ring.pop(msg)) {
+        continue;
+      }
+      auto bucket = TopicBucket(msg._topic._name);
+      lane._head.emplace(Pending{std::move(msg), bucket});
+    }
+
+    // 同一优先级内按顺序发送，队首令牌不足时整个优先级等待，低优先级仍可发送
+    auto wait = lane._bucket.Refill(nowNs);
+    auto bucket = lane._head->_bucket;
+    auto *topic = bucket >= 0 ? &_topicBuckets[bucket].second : nullptr;
+    if (topic) {
+      wait = std::max(wait, topic->Refill(nowNs));
+    }
+    if (wait > 0) {
+      waitNs = std::min(waitNs, wait);
+      continue;
+    }
+    if (lane._bucket.Limited()) {
+      lane._bucket.Take();
+    }
+    if (topic) {
+      topic->Take();
+    }
+    return static_cast<int>(i);
+  }
+  return -1;
+}
+
+auto MqttScheduler::Emit(Lane &lane, int64_t nowNs) -> void {
+  auto status = SendStatus::eFailed;
+  _inflight.fetch_add(1, std::memory_order_relaxed);
+  try {
+    status = _sender(lane._head->_msg);
+  } catch (const std::exception &e) {
+    DSG_ERROR("mqtt scheduled send exception: " << e.what());
+  }
+  if (status != SendStatus::eSent) {
+    OnAck();
+  }
+  if (status == SendStatus::eRetry) {
+    // 留在队首，重试时重新取令牌
+    lane._retried.fetch_add(1, std::memory_order_relaxed);
+    _retryNs = nowNs + kRetryNs;
+    return;
+  }
+
+  auto delay = nowNs - lane._head->_msg._postNs;
+  lane._delaySumNs.fetch_add(delay, std::memory_order_relaxed);
+  auto max = lane._delayMaxNs.load(std::memory_order_relaxed);
+  while (delay > max &&
+         !lane._delayMaxNs.compare_exchange_weak(max, delay, std::memory_order_relaxed)) {
+  }
+  (status == SendStatus::eSent ? lane._sent : lane._failed).fetch_add(1, std::memory_order_relaxed);
+  lane._head.reset();
+}
+
+auto MqttScheduler::TopicBucket(const std::string &topic) const -> int {
+  for (std::size_t i = 0; i < _topicBuckets.size(); ++i) {
+    if (TopicRouter::Matches(_topicBuckets[i].first, topic)) {
+      return static_cast<int>(i);
+    }
+  }
+  return -1;
+}
+
+auto MqttScheduler::Stats() const -> Mqtt::ScheduleStats {
+  Mqtt::ScheduleStats s;
+  for (std::size_t i = 0; i < _lanes.size(); ++i) {
+    const auto &lane = *_lanes[i];
+    auto &l = s._lanes[i];
+    l._depth = lane._ring.size();
+    l._capacity = lane._ring.capacity();
+    l._queued = lane._queued.load(std::memory_order_relaxed);
+    l._sent = lane._sent.load(std::memory_order_relaxed);
+    l._failed = lane._failed.load(std::memory_order_relaxed);
+    l._retried = lane._retried.load(std::memory_order_relaxed);
+    l._rejected = lane._rejected.load(std::memory_order_relaxed);
+    auto done = l._sent + l._failed;
+    l._avgDelayUs = done ? lane._delaySumNs.load(std::memory_order_relaxed) / 1000 /
+                               static_cast<int64_t>(done)
+                         : 0;
+    l._maxDelayUs = lane._delayMaxNs.load(std::memory_order_relaxed) / 1000;
+  }
+  s._inflight = static_cast<std::size_t>(_inflight.load(std::memory_order_relaxed));
+  s._window = static_cast<std::size_t>(_window);
+  return s;
+}
+} // namespace dsg
@@ -0,0 +1,142 @@
+/**
+ * @file mqtt_scheduler.hpp
+ * @brief mqtt 发送调度器
+ *
+ * Send 只把消息压入对应优先级的无锁队列，由调度线程每次选出可发送的最高优先级消息交给 paho，
+ * 高优先级消息不会排在大量低优先级消息之后。
+ * 每个优先级和每个 topic 过滤器各有一个令牌桶，令牌不足的队列暂停，不影响其他优先级；
+ * 令牌桶只由调度线程访问，不加锁。
+ * 交给 paho 的消息数受在途窗口限制，paho 应答（成功或失败）后窗口才腾出位置，
+ * 窗口满时各优先级的队首都留在队列中，窗口有空位时仍先发最高优先级。
+ * 断线等暂时失败的消息留在队首，等待一段时间后重试，不丢弃。
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "mqtt.hpp"
+#include "ring.hpp"
+
+namespace dsg {
+struct MqttOutbound {
+  Mqtt::Topic _topic{};
+  std::vector<uint8_t> _payload{};
+  Mqtt::SendOptions _options{};
+  int64_t _postNs{0};
+};
+
+class MqttScheduler final {
+public:
+  enum class SendStatus {
+    eSent,   // 已交给 paho，之后应答时调用 OnAck
+    eRetry,  // 暂时失败（如断线），稍后重试
+    eFailed, // 无法发送，丢弃并计入统计
+  };
+
+  /// @brief 把消息交给 paho
+  using Sender = std::function<SendStatus(MqttOutbound &)>;
+
+  MqttScheduler(const Mqtt::Config &config, Sender sender);
+  ~MqttScheduler();
+
+  MqttScheduler(const MqttScheduler &) = delete;
+  MqttScheduler &operator=(const MqttScheduler &) = delete;
+
+  auto Start() -> void;
+  auto Stop() -> void;
+
+  /// @brief 按 _options._priority 入队，队列满时返回 false
+  /// @param msg
+  /// @return
+  auto Post(MqttOutbound &&msg) -> bool;
+
+  /// @brief paho 对已发出消息的应答（成功或失败），腾出在途窗口
+  auto OnAck() -> void;
+
+  auto Stats() const -> Mqtt::ScheduleStats;
+
+private:
+  class TokenBucket {
+  public:
+    TokenBucket() = default;
+    explicit TokenBucket(const Mqtt::RateLimit &limit);
+
+    auto Limited() const -> bool {
+      return _rate > 0;
+    }
+
+    /// @brief 补充令牌，返回还需等待多久才有一个令牌，0 表示可取
+    /// @param nowNs
+    /// @return
+    auto Refill(int64_t nowNs) -> int64_t;
+
+    auto Take() -> void {
+      _tokens -= 1;
+    }
+
+  private:
+    double _rate{0};
+    double _burst{0};
+    double _tokens{0};
+    int64_t _lastNs{0};
+  };
+
+  struct Pending {
+    MqttOutbound _msg{};
+    int _bucket{-1}; // _topicBuckets 下标，-1 不限速
+  };
+
+  struct Lane {
+    explicit Lane(std::size_t capacity) : _ring{capacity} {
+    }
+
+    utils::mpmc_ring<MqttOutbound> _ring;
+    std::optional<Pending> _head; // 已出队但还未发出的队首消息，仅调度线程访问
+    TokenBucket _bucket;
+
+    // stats
+    std::atomic<uint64_t> _queued{0};
+    std::atomic<uint64_t> _sent{0};
+    std::atomic<uint64_t> _failed{0};
+    std::atomic<uint64_t> _retried{0};
+    std::atomic<uint64_t> _rejected{0};
+    std::atomic<int64_t> _delaySumNs{0};
+    std::atomic<int64_t> _delayMaxNs{0};
+  };
+
+  auto Run() -> void;
+
+  /// @brief 找出令牌充足的最高优先级队首，找不到时 waitNs 为最近一次可发送的等待时间；
+  /// 在途窗口满或等待重试时不取队首，也不消耗令牌
+  /// @param nowNs
+  /// @param waitNs
+  /// @return 优先级下标，-1 表示没有可发送的消息
+  auto Next(int64_t nowNs, int64_t &waitNs) -> int;
+
+  auto Emit(Lane &lane, int64_t nowNs) -> void;
+  auto Wake() -> void;
+  auto TopicBucket(const std::string &topic) const -> int;
+
+private:
+  std::vector<std::unique_ptr<Lane>> _lanes;
+  std::vector<std::pair<std::string, TokenBucket>> _topicBuckets;
+  Sender _sender;
+  int64_t _window;
+  std::atomic<int64_t> _inflight{0};
+  int64_t _retryNs{0}; // 暂时失败后下次重试的时间，仅调度线程访问
+
+  std::thread _worker;
+  std::atomic<bool> _running{false};
+  std::atomic<uint32_t> _signal{0};
+  std::atomic<bool> _waiting{false};
+  std::mutex _mutex;
+  std::condition_variable _cv;
+};
+} // namespace dsg
@@ -0,0 +1,118 @@
+#include "ptr_reclaim.hpp"
+
+namespace dsg::sp {
+reclaim_domain::reclaim_domain(bool background) {
+  if (background) {
+    _thread = std::thread{[this] { run(); }};
+  }
+}
+
+reclaim_domain::~reclaim_domain() {
+  {
+    std::lock_guard<std::mutex> lock{_mutex};
+    _stop = true;
+  }
+  _cv.notify_one();
+  if (_thread.joinable()) {
+    _thread.join();
+  }
+  collect();
+}
+
+auto reclaim_domain::collect() -> std::size_t {
+  std::unique_lock<std::mutex> lock{_mutex};
+  return drain(lock);
+}
+
+auto reclaim_domain::pending() const -> std::size_t {
+  std::lock_guard<std::mutex> lock{_mutex};
+  return _pending;
+}
+
+auto reclaim_domain::reclaimed() const -> std::size_t {
+  std::lock_guard<std::mutex> lock{_mutex};
+  return _reclaimed;
+}
+
+auto reclaim_domain::hand_off(batch &b) -> void {
+  if (b.empty()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock{_mutex};
+    _pending += b.size();
+    _queue.push_back(std::move(b));
+    if (!_spare.empty()) {
+      b = std::move(_spare.back());
+      _spare.pop_back();
+    } else {
+      b = batch{};
+    }
+  }
+  b.reserve(kBatch);
+  _cv.notify_one();
+}
+
+auto reclaim_domain::drain(std::unique_lock<std::mutex> &lock) -> std::size_t {
+  std::size_t count = 0;
+  while (!_queue.empty()) {
+    std::vector<batch> queue;
+    queue.swap(_queue);
+    lock.unlock();
+    // 析构时可能再释放其他对象，本线程没有 reclaim_scope，就地析构
+    std::size_t n = 0;
+    for (auto &b : queue) {
+      for (auto &r : b) {
+        r._fn(r._p);
+      }
+      n += b.size();
+    }
+    lock.lock();
+    _pending -= n;
+    count += n;
+    for (auto &b : queue) {
+      b.clear();
+      _spare.push_back(std::move(b));
+    }
+    if (_queue.empty()) {
+      queue.clear();
+      _queue.swap(queue); // 保留容量，交接时不分配
+    }
+  }
+  _reclaimed += count;
+  return count;
+}
+
+auto reclaim_domain::run() -> void {
+  std::unique_lock<std::mutex> lock{_mutex};
+  while (true) {
+    _cv.wait(lock, [this] { return _stop || !_queue.empty(); });
+    if (_queue.empty() && _stop) {
+      return;
+    }
+    drain(lock);
+  }
+}
+
+reclaim_scope::reclaim_scope(reclaim_domain &domain)
+    : _domain{domain}, _prev{detail::tls_reclaimer} {
+  _batch.reserve(reclaim_domain::kBatch);
+  detail::tls_reclaimer = this;
+}
+
+reclaim_scope::~reclaim_scope() {
+  detail::tls_reclaimer = _prev;
+  _domain.hand_off(_batch);
+}
+
+auto reclaim_scope::flush() -> void {
+  _domain.hand_off(_batch);
+}
+
+auto reclaim_scope::retire(void *p, detail::reclaim_fn fn) -> void {
+  _batch.push_back({p, fn});
+  if (_batch.size() >= reclaim_domain::kBatch) {
+    _domain.hand_off(_batch);
+  }
+}
+} // namespace dsg::sp
@@ -0,0 +1,188 @@
+/**
+ * @file ring.hpp
+ * @brief 有界无锁环形队列
+ *
+ * 多生产者多消费者（Vyukov bounded queue），每个槽位带序号，push/pop 各一次 CAS。
+ * 容量向上取整到 2 的幂，满时 push 返回 false，由调用方决定丢弃或回退。
+ * free_list 由若干 mpmc_ring 组成，用于跨线程复用对象，容量可按需扩大。
+ */
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace dsg::utils {
+inline constexpr std::size_t cache_line_size = 64;
+
+template <typename T> class mpmc_ring final {
+public:
+  explicit mpmc_ring(std::size_t capacity) {
+    std::size_t cap = 2;
+    while (cap < capacity) {
+      cap <<= 1;
+    }
+    _mask = cap - 1;
+    _cells = std::make_unique<cell[]>(cap);
+    for (std::size_t i = 0; i < cap; ++i) {
+      _cells[i]._seq.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  mpmc_ring(const mpmc_ring &) = delete;
+  mpmc_ring &operator=(const mpmc_ring &) = delete;
+
+  auto push(T &&v) -> bool {
+    cell *c = nullptr;
+    auto pos = _tail.load(std::memory_order_relaxed);
+    for (;;) {
+      c = &_cells[pos & _mask];
+      auto seq = c->_seq.load(std::memory_order_acquire);
+      auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+      if (diff == 0) {
+        if (_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false; // full
+      } else {
+        pos = _tail.load(std::memory_order_relaxed);
+      }
+    }
+    c->_data = std::move(v);
+    c->_seq.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  auto pop(T &v) -> bool {
+    cell *c = nullptr;
+    auto pos = _head.load(std::memory_order_relaxed);
+    for (;;) {
+      c = &_cells[pos & _mask];
+      auto seq = c->_seq.load(std::memory_order_acquire);
+      auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1);
+      if (diff == 0) {
+        if (_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false; // empty
+      } else {
+        pos = _head.load(std::memory_order_relaxed);
+      }
+    }
+    v = std::move(c->_data);
+    c->_seq.store(pos + _mask + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// @brief 近似长度，仅用于统计
+  auto size() const -> std::size_t {
+    auto tail = _tail.load(std::memory_order_relaxed);
+    auto head = _head.load(std::memory_order_relaxed);
+    return tail > head ? tail - head : 0;
+  }
+
+  auto capacity() const -> std::size_t {
+    return _mask + 1;
+  }
+
+private:
+  struct cell {
+    std::atomic<std::size_t> _seq;
+    T _data;
+  };
+
+  std::unique_ptr<cell[]> _cells;
+  std::size_t _mask;
+  alignas(cache_line_size) std::atomic<std::size_t> _tail{0};
+  alignas(cache_line_size) std::atomic<std::size_t> _head{0};
+};
+
+/// @brief 空闲对象池，容量不足时 reserve 追加一段环形队列，已有的段不移动、不释放，
+/// push/pop 依次尝试各段，不加锁；只有 reserve 加锁
+template <typename T> class free_list final {
+public:
+  explicit free_list(std::size_t capacity) {
+    reserve(capacity);
+  }
+
+  ~free_list() {
+    for (auto &s : _segments) {
+      delete s.load(std::memory_order_relaxed);
+    }
+  }
+
+  free_list(const free_list &) = delete;
+  free_list &operator=(const free_list &) = delete;
+
+  /// @brief 总容量至少为 capacity，超过段数上限时不再扩大
+  auto reserve(std::size_t capacity) -> void {
+    std::lock_guard<std::mutex> lock{_mutex};
+    auto total = this->capacity();
+    for (std::size_t i = 0; i < kSegments && total < capacity; ++i) {
+      if (_segments[i].load(std::memory_order_relaxed)) {
+        continue;
+      }
+      auto *segment = new mpmc_ring<T>(std::max(capacity - total, total));
+      total += segment->capacity();
+      _segments[i].store(segment, std::memory_order_release);
+    }
+  }
+
+  auto push(T &&v) -> bool {
+    for (auto &s : _segments) {
+      auto *segment = s.load(std::memory_order_acquire);
+      if (!segment) {
+        break;
+      }
+      if (segment->push(std::move(v))) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  auto pop(T &v) -> bool {
+    for (auto &s : _segments) {
+      auto *segment = s.load(std::memory_order_acquire);
+      if (!segment) {
+        break;
+      }
+      if (segment->pop(v)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /// @brief 近似长度，仅用于统计
+  auto size() const -> std::size_t {
+    return sum(&mpmc_ring<T>::size);
+  }
+
+  auto capacity() const -> std::size_t {
+    return sum(&mpmc_ring<T>::capacity);
+  }
+
+private:
+  static constexpr std::size_t kSegments = 16;
+
+  auto sum(std::size_t (mpmc_ring<T>::*f)() const) const -> std::size_t {
+    std::size_t n = 0;
+    for (auto &s : _segments) {
+      if (auto *segment = s.load(std::memory_order_acquire)) {
+        n += (segment->*f)();
+      }
+    }
+    return n;
+  }
+
+  std::array<std::atomic<mpmc_ring<T> *>, kSegments> _segments{};
+  std::mutex _mutex;
+};
+} // namespace dsg::utils
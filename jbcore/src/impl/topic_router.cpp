@@ -0,0 +1,111 @@
+#include "def.hpp"
+#include "topic_router.hpp"
+
+namespace dsg {
+auto TopicRouter::Add(std::string_view filter, Handler handler) -> bool {
+  if (!Valid(filter)) {
+    DSG_WARN("invalid topic filter " << filter);
+    return false;
+  }
+  std::lock_guard<std::mutex> lock{_writer};
+  auto snapshot = _snapshot.load();
+  Publish(Update(snapshot ? snapshot->_root.get() : nullptr, filter, false, &handler));
+  return true;
+}
+
+auto TopicRouter::Remove(std::string_view filter) -> void {
+  std::lock_guard<std::mutex> lock{_writer};
+  auto snapshot = _snapshot.load();
+  if (snapshot) {
+    Publish(Update(snapshot->_root.get(), filter, false, nullptr));
+  }
+}
+
+auto TopicRouter::Empty() const -> bool {
+  return !_snapshot.load();
+}
+
+auto TopicRouter::Publish(NodePtr root) -> void {
+  if (!root) {
+    _snapshot.store(nullptr);
+    return;
+  }
+  auto snapshot = make_ptr<Snapshot>();
+  snapshot->_root = std::move(root);
+  _snapshot.store(std::move(snapshot));
+}
+
+auto TopicRouter::Matches(std::string_view filter, std::string_view topic) -> bool {
+  if (!topic.empty() && topic.front() == '$' && !filter.empty() &&
+      (filter.front() == '+' || filter.front() == '#')) {
+    return false;
+  }
+  while (true) {
+    auto fs = filter.find('/');
+    auto level = filter.substr(0, fs);
+    if (level == "#") {
+      return true;
+    }
+    auto ts = topic.find('/');
+    if (level != "+" && level != topic.substr(0, ts)) {
+      return false;
+    }
+    if (fs == std::string_view::npos || ts == std::string_view::npos) {
+      // a/# 匹配 a
+      return fs == ts || (ts == std::string_view::npos && filter.substr(fs + 1) == "#");
+    }
+    filter.remove_prefix(fs + 1);
+    topic.remove_prefix(ts + 1);
+  }
+}
+
+auto TopicRouter::Valid(std::string_view filter) -> bool {
+  if (filter.empty()) {
+    return false;
+  }
+  std::size_t start = 0;
+  while (true) {
+    auto slash = filter.find('/', start);
+    auto level = filter.substr(start, slash == std::string_view::npos ? slash : slash - start);
+    if (level.find_first_of("+#") != std::string_view::npos && level.size() != 1) {
+      return false;
+    }
+    if (level == "#" && slash != std::string_view::npos) {
+      return false; // # 只能在最后一层
+    }
+    if (slash == std::string_view::npos) {
+      return true;
+    }
+    start = slash + 1;
+  }
+}
+
+auto TopicRouter::Update(const Node *node, std::string_view filter, bool done,
+                         const Handler *handler) -> NodePtr {
+  // 只复制路径上的节点，其余子树与旧快照共享
+  auto n = node ? std::make_shared<Node>(*node) : std::make_shared<Node>();
+  if (done) {
+    n->_handler = handler ? *handler : Handler{};
+  } else {
+    auto slash = filter.find('/');
+    auto level = filter.substr(0, slash);
+    auto last = slash == std::string_view::npos;
+    auto next = last ? std::string_view{} : filter.substr(slash + 1);
+
+    if (level == "+" || level == "#") {
+      auto &slot = level == "+" ? n->_plus : n->_hash;
+      slot = Update(slot.get(), next, last, handler);
+    } else {
+      auto it = n->_children.find(level);
+      auto child = Update(it != n->_children.end() ? it->second.get() : nullptr, next, last,
+                          handler);
+      if (child) {
+        n->_children.insert_or_assign(std::string(level), std::move(child));
+      } else if (it != n->_children.end()) {
+        n->_children.erase(it);
+      }
+    }
+  }
+  return n->empty() ? nullptr : n;
+}
+} // namespace dsg
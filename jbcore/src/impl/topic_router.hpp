@@ -0,0 +1,125 @@
+/**
+ * @file topic_router.hpp
+ * @brief 按订阅分发消息的 topic 树
+ *
+ * 按 topic 层级建立前缀树，支持 `+` 单层和 `#` 多层通配符。
+ * 树节点不可变，修改时只复制路径上的节点，再经 atomic_ptr 整体替换快照，
+ * 匹配只读取快照，无锁、不分配内存，代价为 O(层数)。
+ */
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "def.hpp"
+#include "mqtt.hpp"
+#include "ptr.hpp"
+
+namespace dsg {
+class TopicRouter final {
+public:
+  using Handler = Mqtt::MessageHandler;
+
+  /// @brief 注册订阅对应的处理函数，同一过滤器重复注册则替换
+  /// @param filter
+  /// @param handler
+  /// @return 过滤器不合法返回 false
+  auto Add(std::string_view filter, Handler handler) -> bool;
+
+  /// @brief 移除订阅对应的处理函数
+  /// @param filter
+  auto Remove(std::string_view filter) -> void;
+
+  auto Empty() const -> bool;
+
+  /// @brief 判断 topic 是否匹配过滤器，规则与 Match 相同
+  /// @param filter
+  /// @param topic
+  /// @return
+  static auto Matches(std::string_view filter, std::string_view topic) -> bool;
+
+  /// @brief 检查过滤器格式，通配符必须独占一层，# 只能在最后一层
+  /// @param filter
+  /// @return
+  static auto Valid(std::string_view filter) -> bool;
+
+  /// @brief 对每个匹配 topic 的处理函数调用 f，返回匹配个数
+  /// @param topic
+  /// @param f
+  /// @return
+  template <typename F> auto Match(std::string_view topic, F &&f) const -> std::size_t {
+    auto snapshot = _snapshot.load();
+    if (!snapshot) {
+      return 0;
+    }
+    std::size_t count = 0;
+    Walk(*snapshot->_root, topic, false, true, f, count);
+    return count;
+  }
+
+private:
+  struct Node;
+  using NodePtr = std::shared_ptr<const Node>;
+
+  struct Node {
+    std::unordered_map<std::string, NodePtr, StrHash, std::equal_to<>> _children;
+    NodePtr _plus;
+    NodePtr _hash;
+    Handler _handler;
+
+    auto empty() const -> bool {
+      return _children.empty() && !_plus && !_hash && !_handler;
+    }
+  };
+
+  /// @brief 发布给读者的整棵树，根节点非空
+  struct Snapshot : public ref_policy {
+    NodePtr _root;
+  };
+
+  auto Publish(NodePtr root) -> void;
+
+  static auto Update(const Node *node, std::string_view filter, bool done, const Handler *handler)
+      -> NodePtr;
+
+  template <typename F>
+  static auto Walk(const Node &node, std::string_view topic, bool done, bool first, F &f,
+                   std::size_t &count) -> void {
+    // $ 开头的系统 topic 不匹配首层通配符
+    const bool sys = first && !topic.empty() && topic.front() == '$';
+
+    // `#` 同时匹配父层级，a/# 匹配 a
+    if (node._hash && node._hash->_handler && !sys) {
+      f(node._hash->_handler);
+      ++count;
+    }
+    if (done) {
+      if (node._handler) {
+        f(node._handler);
+        ++count;
+      }
+      return;
+    }
+
+    auto slash = topic.find('/');
+    auto level = topic.substr(0, slash);
+    auto last = slash == std::string_view::npos;
+    auto next = last ? std::string_view{} : topic.substr(slash + 1);
+
+    if (auto it = node._children.find(level); it != node._children.end()) {
+      Walk(*it->second, next, last, false, f, count);
+    }
+    if (node._plus && !sys) {
+      Walk(*node._plus, next, last, false, f, count);
+    }
+  }
+
+private:
+  atomic_ptr<Snapshot> _snapshot;
+  std::mutex _writer;
+};
+} // namespace dsg